@@ -0,0 +1,62 @@
+// Times the perfect hash dispatch of ChunkCreator against the dispatch it
+// replaced, over every registered four character signature. The old one built
+// a QByteArray from the signature bytes of every chunk, then looked it up
+// twice, contains() and operator[]
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QVector>
+#include <cstdio>
+
+#include "chunk/chunkcreator.h"
+
+namespace {
+    constexpr int Rounds = 2000000;
+
+    template<typename Lookup>
+    void Time(const char* name, int count, Lookup lookup)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        quintptr sum = 0;
+        for (int i = 0; i < Rounds; i++) {
+            sum += (quintptr)lookup(i % count);
+        }
+        const qint64 ns = timer.nsecsElapsed();
+        // The sum keeps the lookups from being optimised out
+        printf("%-12s %8.2f ns per lookup (%llx)\n", name, ns / double(Rounds), (unsigned long long)sum);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    auto creator = ChunkCreator::Get();
+
+    // The old factory map, and the signatures as they sit in the file
+    QMap<QByteArray, MakeMethod> factories;
+    QByteArray fileBytes;
+    QVector<uint32_t> fourCCs;
+    foreach (const auto& signature, creator->Signatures()) {
+        factories[signature] = creator->FindMake(signature);
+        if (signature.size() == 4) {
+            fileBytes.append(signature);
+            fourCCs.append(FourCC(signature.constData()));
+        }
+    }
+    if (fourCCs.isEmpty()) {
+        fprintf(stderr, "No four character signatures registered\n");
+        return 1;
+    }
+
+    printf("%d signatures, %d lookups each way\n", (int)fourCCs.size(), Rounds);
+    Time("Old map", fourCCs.size(), [&](int i) -> MakeMethod {
+        const QByteArray signature(fileBytes.constData() + i * 4, 4);
+        if (!factories.contains(signature)) {
+            return nullptr;
+        }
+        return factories[signature];
+    });
+    Time("Perfect hash", fourCCs.size(), [&](int i) { return creator->FindMake(fourCCs[i]); });
+    return 0;
+}
@@ -4,7 +4,10 @@
 #include <QObject>
 #include <QByteArray>
 #include <QMap>
+#include <QVector>
+#include <QStringList>
 #include <stdio.h>
+#include <limits>
 #include "propertytype.h"
 #include "util/util.h"
 
@@ -12,16 +15,16 @@
     do {                                     \
         QByteArray tmp(size, 0);          \
         size_t offset = myftell64(file); \
-        fread(tmp.data(), 1, size, file);      \
-        mAdditionalProperties[name] = ChunkProperty {tmp, PropRawHex, offset};   \
+        ReadBytes(file, tmp.data(), size);      \
+        mAdditionalProperties[name] = ChunkProperty {tmp, PropRawHex, offset, (size_t)(size)};   \
     } while (0)
 
 #define CHUNK_TREADPROP(name,size,type)            \
     do {                                     \
         QByteArray tmp(size, 0);          \
         size_t offset = myftell64(file); \
-        fread(tmp.data(), 1, size, file);      \
-        mAdditionalProperties[name] = ChunkProperty {tmp, type, offset};   \
+        ReadBytes(file, tmp.data(), size);      \
+        mAdditionalProperties[name] = ChunkProperty {tmp, type, offset, (size_t)(size)};   \
     } while (0)
 
 #define STUFF_INTO(from,to,type) \
@@ -34,21 +37,55 @@
         whose->Children.append(child); \
     } while(0)
 
+class ChunkVisitor;
+class MappedFile;
+
+// The file being parsed and the first error met in it. Readers check their
+// reads and the counts and lengths they are given against it; after an
+// error every read yields zeros and every loop stops, which leaves a
+// partial tree. Only set by ChunkReadScope, readers run without it unchecked
+struct ChunkReadState {
+    QString path;
+    int64_t size;
+    QString error;
+};
+
+// Four character chunk signature as a number, first character in the low byte
+constexpr uint32_t FourCC(const char* s) {
+    return uint32_t(uint8_t(s[0])) | uint32_t(uint8_t(s[1])) << 8 |
+           uint32_t(uint8_t(s[2])) << 16 | uint32_t(uint8_t(s[3])) << 24;
+}
+
+// The four characters of a FourCC, for messages
+inline QString FourCCName(uint32_t signature) {
+    const char name[4] = { char(signature), char(signature >> 8), char(signature >> 16), char(signature >> 24) };
+    return QString::fromLatin1(name, 4);
+}
+
 struct ChunkProperty {
     QByteArray data;
     PropertyType type;
     size_t offset;
+    size_t sourceSize = 0;  // bytes it took in the file, 0 if made up by the reader
 
     operator QByteArray() { return data; } // Implicit conversion to QByteArray
     ChunkProperty operator=(QByteArray _data) { data = _data; return *this; }
 };
 
+// Bytes a chunk owns in its file, as they are to be written back
+struct ChunkSpan {
+    uint64_t offset;        // where they were read from
+    uint64_t sourceSize;    // how many were read there
+    QByteArray data;
+};
+
 class BaseChunk
 {
 public:
     explicit BaseChunk() {
         mSignature = QByteArray(4, 0);
         mSize = 0;
+        mOriginalOffset = 0;
     }
 
     explicit BaseChunk(BaseChunk& that) {
@@ -63,18 +100,29 @@ public:
         }
     }
 
-    static bool ArrayLeadingChunkName;
-    static bool HasLeadingQword;
+    // Reader state toggled by the guards in chunkreaderguards.h, per thread
+    static thread_local bool ArrayLeadingChunkName;
+    static thread_local bool HasLeadingQword;
+    // Skip sample and frame payloads, for checks that only need the structure
+    static thread_local bool HeaderOnly;
+    // Set while a DDI is read as events, array children are then freed once reported
+    static thread_local ChunkVisitor* Visitor;
+    static thread_local ChunkReadState* ReadState;
+    // The file being read, mapped: sample payloads are then left in it
+    static thread_local MappedFile* Mapping;
     static bool DevDb;
     const static int ItemChunkRole,
                      ItemPropDataRole,
                      ItemOffsetRole,
+                     ItemPropNameRole,
                      DdbSoundReferredOffsetRole;
 
     static QByteArray ClassSignature() { return "    "; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
     virtual void Read(FILE* file) { }
     virtual QString Description() { return "..."; }
+    // sizeof the object, for memory accounting. Chunks adding members override it
+    virtual size_t ObjectSize() { return sizeof(BaseChunk); }
     static BaseChunk* Make() { return nullptr; }
 
     QString GetName() { return mName; }
@@ -84,6 +132,25 @@ public:
     uint64_t GetOriginalOffset() { return mOriginalOffset; }
     uint32_t GetSize() { return mSize; }
     const QMap<QString, ChunkProperty>& GetPropertiesMap() { return mAdditionalProperties; }
+    // Properties as listed to the user, chunks holding bulk arrays expand them here
+    virtual QMap<QString, ChunkProperty> GetDisplayProperties() { return mAdditionalProperties; }
+    // Property names in file order, for chunks declaring their layout in a schema
+    virtual QStringList FieldOrder() { return QStringList(); }
+    // Spans to write over the source file, whatever no chunk claims is copied
+    // verbatim. Chunks holding data outside their properties add it here
+    virtual void WriteSpans(QVector<ChunkSpan>& spans) {
+        for(auto i = mAdditionalProperties.cbegin(); i != mAdditionalProperties.cend(); i++)
+            if(i->sourceSize) spans.append(ChunkSpan {i->offset, i->sourceSize, i->data});
+    }
+    // Keys of props with the declared fields first, the rest by name
+    QStringList OrderedKeys(const QMap<QString, ChunkProperty>& props) {
+        QStringList keys;
+        foreach(auto i, FieldOrder()) if(props.contains(i)) keys.append(i);
+        if(keys.size() == props.size()) return keys;
+        QStringList declared = keys;
+        foreach(auto i, props.keys()) if(!declared.contains(i)) keys.append(i);
+        return keys;
+    }
     QByteArray GetSignature() { return mSignature; }
     BaseChunk* GetChildByName(QString name) {
         foreach(auto i, Children) if(i->mName == name) return i; return nullptr;
@@ -107,16 +174,22 @@ protected:
         if(HasLeadingQword)
             CHUNK_READPROP("LeadingQword", 8);
         QByteArray tmp(4, 0);
-        fread(tmp.data(), 1, 4, file); mSignature = tmp;
+        ReadBytes(file, tmp.data(), 4); mSignature = tmp;
         CHUNK_TREADPROP("Chunk length", 4, PropU32Int);
         STUFF_INTO(GetProperty("Chunk length").data, mSize, uint32_t);
+        // Counted from the signature
+        if(ReadState && !ReadFailed() && mSize > Remaining(file) + 8)
+            ReadError(file, QString("chunk \"%1\" claims %2 bytes, past the end of the file")
+                                .arg(QString(mSignature)).arg(mSize));
     }
 
     void ReadStringName(FILE* file) {
-        uint32_t length;
-        fread(&length, 1, 4, file);
+        uint32_t length = 0;
+        ReadBytes(file, &length, 4);
+        if(!FitsInFile(file, length, 1, "name"))
+            return;
         QByteArray name(length, 0);
-        fread(name.data(), 1, length, file);
+        ReadBytes(file, name.data(), length);
         SetName(name);
     }
 
@@ -124,6 +197,49 @@ protected:
         mOriginalOffset = myftell64(file);
     }
 
+public:
+    static bool ReadFailed() { return ReadState && !ReadState->error.isEmpty(); }
+
+    // Keeps the first error, with the file and where in it
+    static void ReadError(FILE* file, const QString& message) {
+        if(!ReadState || !ReadState->error.isEmpty()) return;
+        ReadState->error = QString("%1 at 0x%2: %3").arg(ReadState->path)
+                               .arg(myftell64(file), 0, 16).arg(message);
+    }
+
+    static int64_t Remaining(FILE* file) {
+        return ReadState ? ReadState->size - myftell64(file) : std::numeric_limits<int64_t>::max();
+    }
+
+    // A short read is an error, the rest of data is left as it was
+    static bool ReadBytes(FILE* file, void* data, size_t size) {
+        if(ReadFailed()) return false;
+        if(fread(data, 1, size, file) == size) return true;
+        ReadError(file, QString("file ends within a %1 byte read").arg(size));
+        return false;
+    }
+
+    // Whether count elements of at least elementSize bytes can still follow,
+    // checked before anything is allocated for them
+    static bool FitsInFile(FILE* file, uint64_t count, uint64_t elementSize, const char* what) {
+        if(ReadFailed()) return false;
+        if(!ReadState || count <= (uint64_t)qMax<int64_t>(Remaining(file), 0) / qMax<uint64_t>(elementSize, 1))
+            return true;
+        ReadError(file, QString("%1 %2 of at least %3 bytes do not fit in the rest of the file")
+                            .arg(count).arg(what).arg(elementSize));
+        return false;
+    }
+
+    // Signature of the chunk starting here, 0 at the end of the file. One
+    // read and a relative seek back, which stays inside the stdio buffer
+    static uint32_t PeekSignature(FILE* file) {
+        char head[12];
+        const size_t size = HasLeadingQword ? 12 : 4;
+        const size_t got = fread(head, 1, size, file);
+        myfseek64(file, -(int64_t)got, SEEK_CUR);
+        return got == size ? FourCC(head + size - 4) : 0;
+    }
+
 };
 
 Q_DECLARE_METATYPE(BaseChunk*);
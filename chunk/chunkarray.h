@@ -2,6 +2,7 @@
 #define CHUNKARRAY_H
 
 #include "basechunk.h"
+#include "chunkschema.h"
 #include "chunkcreator.h"
 
 class ChunkChunkArray : public BaseChunk {
@@ -24,46 +25,52 @@ public:
         return "ChunkArray";
     }
 
+    virtual QStringList FieldOrder() {
+        QStringList names;
+        AppendChunkFieldNames<ArrayHead>(mAdditionalProperties, names);
+        return names;
+    }
+
     static BaseChunk* Make() {
         return new ChunkChunkArray();
     }
 
 protected:
+    static constexpr ChunkField ArrayHeadFields[] = {
+        { "ArrayFlags", PropU32Int, 4 },        // array flags
+        { "UseEmptyChunk", PropU32Int, 4 },     // use empty chunk as placeholder
+    };
+    static constexpr auto ArrayHead = MakeChunkSchema(ArrayHeadFields);
+
     void ReadArrayHead(FILE* file) {
-        CHUNK_TREADPROP("ArrayFlags", 4, PropU32Int);      // array flags
-        CHUNK_TREADPROP("UseEmptyChunk", 4, PropU32Int);   // use empty chunk as placeholder
+        ReadChunkFields<ArrayHead>(file, mAdditionalProperties);
     }
 
     void ReadArrayBody(FILE* file, uint32_t maxCount = 1) {
-        char signatureBuf[4];
         uint32_t count;
         BaseChunk::Read(file);
 
         // Read subchunk count
         CHUNK_TREADPROP("Count", 4, PropU32Int);
         STUFF_INTO(GetProperty("Count").data, count, uint32_t);
+        if (!FitsInFile(file, count, 8, "chunks"))
+            count = 0;
 
 
         //FIXME: JUST FOR TEST
-        for(uint32_t ii = 0; ii < (maxCount == 0 ? count : maxCount); ii++) {
+        for(uint32_t ii = 0; ii < (maxCount == 0 ? count : maxCount) && !ReadFailed(); ii++) {
 
             if (BaseChunk::ArrayLeadingChunkName)
                 ReadStringName(file); // HACK: Use current array's name as a temporary variable
 
-            // Read signature first
-            fpos_t pos;
-            fgetpos(file, &pos);
-            // Skip Leading QWORD if needed
-            if(HasLeadingQword) myfseek64(file, 8, SEEK_CUR);
-            fread(signatureBuf, 1, 4, file);
-            fsetpos(file, &pos);
-
-            auto sig = QByteArray(signatureBuf, 4);
-            auto chk = ChunkCreator::Get()->ReadFor(sig, file);
+            auto chk = ChunkCreator::Get()->ReadFor(PeekSignature(file), file);
             if(chk) {
                 if (BaseChunk::ArrayLeadingChunkName)
                     chk->SetName(GetName());
-                Children.append(chk);
+                if (BaseChunk::Visitor)
+                    delete chk;     // Already reported by ReadFor
+                else
+                    Children.append(chk);
             } else
                 break;
         }
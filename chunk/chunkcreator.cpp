@@ -1,4 +1,6 @@
 #include "chunkcreator.h"
+#include "chunkvisitor.h"
+#include "util/perftrace.h"
 
 // Chunks
 #include "chunkarray.h"
@@ -36,15 +38,22 @@
 #include "skipchunk.h"
 
 #include <QDebug>
+#include <algorithm>
+#include <iterator>
 
 ChunkCreator *ChunkCreator::mInstance = nullptr;
-bool BaseChunk::HasLeadingQword = true;
+thread_local bool BaseChunk::HasLeadingQword = true;
 bool BaseChunk::DevDb = false;
-bool BaseChunk::ArrayLeadingChunkName = false;
+thread_local bool BaseChunk::ArrayLeadingChunkName = false;
+thread_local bool BaseChunk::HeaderOnly = false;
+thread_local ChunkVisitor* BaseChunk::Visitor = nullptr;
+thread_local ChunkReadState* BaseChunk::ReadState = nullptr;
+thread_local MappedFile* BaseChunk::Mapping = nullptr;
 const int BaseChunk::ItemChunkRole = Qt::UserRole + 1;
 const int BaseChunk::ItemPropDataRole = Qt::UserRole + 2;
 const int BaseChunk::ItemOffsetRole = Qt::UserRole + 2;
 const int BaseChunk::DdbSoundReferredOffsetRole = Qt::UserRole + 3;
+const int BaseChunk::ItemPropNameRole = Qt::UserRole + 4;
 
 ChunkCreator::ChunkCreator(QObject *parent)
     : QObject{parent}
@@ -87,9 +96,51 @@ ChunkCreator::ChunkCreator(QObject *parent)
     for(auto i : FactoryMethods.keys())
         qDebug() << i << FactoryMethods[i];
 
+    BuildHash();
     mProgressDlg = nullptr;
 }
 
+void ChunkCreator::BuildHash()
+{
+    QVector<FactorySlot> fourCCs;
+    for(auto i = FactoryMethods.cbegin(); i != FactoryMethods.cend(); i++)
+        if(i.key().size() == 4)
+            fourCCs.append(FactorySlot { FourCC(i.key().constData()), i.value() });
+    Q_ASSERT(fourCCs.size() <= (1 << HashBits) / 2);
+
+    mHashed = false;
+    // Odd multipliers from a fixed sequence, the first without collisions wins
+    uint32_t candidate = 0x9E3779B9u;
+    for(int attempt = 0; attempt < (1 << 20); attempt++, candidate = candidate * 1664525u + 1013904223u) {
+        mHashMultiplier = candidate | 1;
+        std::fill(std::begin(mSlots), std::end(mSlots), FactorySlot { 0, nullptr });
+        bool unique = true;
+        foreach(auto i, fourCCs) {
+            auto& slot = mSlots[HashSlot(i.signature)];
+            if(slot.make) {
+                unique = false;
+                break;
+            }
+            slot = i;
+        }
+        if(unique) {
+            mHashed = true;
+            return;
+        }
+    }
+    qWarning("No perfect hash for %d chunk signatures, using the map", (int)fourCCs.size());
+}
+
+MakeMethod ChunkCreator::FindMake(uint32_t signature) const
+{
+    if(!mHashed) {
+        const char bytes[4] = { char(signature), char(signature >> 8), char(signature >> 16), char(signature >> 24) };
+        return FindMake(QByteArray(bytes, 4));
+    }
+    const auto& slot = mSlots[HashSlot(signature)];
+    return slot.signature == signature ? slot.make : nullptr;
+}
+
 ChunkCreator *ChunkCreator::Get()
 {
     if (mInstance == nullptr)
@@ -98,12 +149,39 @@ ChunkCreator *ChunkCreator::Get()
 }
 
 BaseChunk *ChunkCreator::ReadFor(QByteArray signature, FILE *file)
+{
+    if(signature.size() == 4)
+        return ReadFor(FourCC(signature.constData()), file);
+
+    if(mProgressDlg) mProgressDlg->setValue(myftell64(file));
+    // Const lookup only, part files are parsed from worker threads when packing
+    auto make = FindMake(signature);
+    if(!make)
+        return nullptr;
+    PERF_SCOPE_TAGGED(perf, "Read by key", 0);
+    auto ret = make();
+    auto visitor = BaseChunk::Visitor;
+    if(visitor) visitor->onEnterChunk(signature, myftell64(file));
+    ret->Read(file);
+    PERF_BYTES(perf, myftell64(file) - ret->GetOriginalOffset());
+    if(visitor) visitor->Finish(ret);
+    return ret;
+}
+
+BaseChunk *ChunkCreator::ReadFor(uint32_t signature, FILE *file)
 {
     if(mProgressDlg) mProgressDlg->setValue(myftell64(file));
-    if(!FactoryMethods.contains(signature))
+    auto make = FindMake(signature);
+    if(!make)
         return nullptr;
-    auto ret = FactoryMethods[signature]();
+    // Per signature, nested chunks are left out of the self time
+    PERF_SCOPE_TAGGED(perf, "Read", signature);
+    auto ret = make();
+    auto visitor = BaseChunk::Visitor;
+    if(visitor) visitor->onEnterChunk(ret->ObjectSignature(), myftell64(file));
     ret->Read(file);
+    PERF_BYTES(perf, myftell64(file) - ret->GetOriginalOffset());
+    if(visitor) visitor->Finish(ret);
     return ret;
 }
 
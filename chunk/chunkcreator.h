@@ -16,6 +16,13 @@ public:
     static ChunkCreator* Get();
 
     BaseChunk *ReadFor(QByteArray signature, FILE* file);
+    // For signatures as read from the file, see BaseChunk::PeekSignature
+    BaseChunk *ReadFor(uint32_t signature, FILE* file);
+
+    // Factory of a signature, nullptr if there is none
+    MakeMethod FindMake(uint32_t signature) const;
+    MakeMethod FindMake(const QByteArray& signature) const { return FactoryMethods.value(signature); }
+    QList<QByteArray> Signatures() const { return FactoryMethods.keys(); }
 
     void SetProgressDialog(QProgressDialog *dlg) { mProgressDlg = dlg; }
 
@@ -27,6 +34,21 @@ private:
     QMap<QByteArray, MakeMethod> FactoryMethods;
     template <typename T> void AddToFactory();
 
+    // Four character signatures are found through a perfect hash: a
+    // multiplier is picked up front so that each gets a slot of its own,
+    // a lookup is then one multiply and one compare. Without such a
+    // multiplier lookups go through FactoryMethods instead
+    static constexpr int HashBits = 6;
+    struct FactorySlot {
+        uint32_t signature;
+        MakeMethod make;
+    };
+    FactorySlot mSlots[1 << HashBits];
+    uint32_t mHashMultiplier;
+    bool mHashed;
+    int HashSlot(uint32_t signature) const { return (signature * mHashMultiplier) >> (32 - HashBits); }
+    void BuildHash();
+
 signals:
 
 };
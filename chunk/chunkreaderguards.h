@@ -33,4 +33,74 @@ private:
     bool prev;
 };
 
+class HeaderOnlyGuard {
+public:
+    HeaderOnlyGuard() = delete;
+    HeaderOnlyGuard(bool enable) {
+        prev = BaseChunk::HeaderOnly;
+        BaseChunk::HeaderOnly = enable;
+    }
+    ~HeaderOnlyGuard() {
+        BaseChunk::HeaderOnly = prev;
+    }
+
+private:
+    bool prev;
+};
+
+class VisitorGuard {
+public:
+    VisitorGuard() = delete;
+    VisitorGuard(ChunkVisitor* visitor) {
+        prev = BaseChunk::Visitor;
+        BaseChunk::Visitor = visitor;
+    }
+    ~VisitorGuard() {
+        BaseChunk::Visitor = prev;
+    }
+
+private:
+    ChunkVisitor* prev;
+};
+
+// mapping must be the file being read, chunks keep it as long as they point into it
+class MappingGuard {
+public:
+    MappingGuard() = delete;
+    MappingGuard(MappedFile* mapping) {
+        prev = BaseChunk::Mapping;
+        BaseChunk::Mapping = mapping;
+    }
+    ~MappingGuard() {
+        BaseChunk::Mapping = prev;
+    }
+
+private:
+    MappedFile* prev;
+};
+
+// Checks reads against file, which is read from its current position
+class ChunkReadScope {
+public:
+    ChunkReadScope() = delete;
+    ChunkReadScope(FILE* file, const QString& path) {
+        const int64_t start = myftell64(file);
+        myfseek64(file, 0, SEEK_END);
+        state.size = myftell64(file);
+        myfseek64(file, start, SEEK_SET);
+        state.path = path;
+        prev = BaseChunk::ReadState;
+        BaseChunk::ReadState = &state;
+    }
+    ~ChunkReadScope() {
+        BaseChunk::ReadState = prev;
+    }
+
+    QString Error() const { return state.error; }
+
+private:
+    ChunkReadState state;
+    ChunkReadState* prev;
+};
+
 #endif // CHUNKREADERGUARDS_H
@@ -0,0 +1,175 @@
+#ifndef CHUNKSCHEMA_H
+#define CHUNKSCHEMA_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <array>
+#include <cstring>
+#include <stdio.h>
+#include <type_traits>
+#include "basechunk.h"
+
+// One field of a chunk layout. A gated field is only there when the gate
+// field ANDed with mask is non-zero, a counted one holds size bytes per
+// element and takes its element count from an earlier field
+struct ChunkField {
+    const char* name;
+    PropertyType type;
+    uint32_t size;
+    const char* gate = nullptr;
+    uint32_t mask = 0;
+    const char* count = nullptr;
+};
+
+namespace ChunkSchemaDetail {
+    constexpr bool NameEquals(const char* a, const char* b)
+    {
+        while (*a && *a == *b) {
+            a++;
+            b++;
+        }
+        return *a == *b;
+    }
+
+    // Not constexpr on purpose, reaching it at compile time is the error
+    inline int UnknownField() { return -1; }
+
+    constexpr int IndexOf(const ChunkField* fields, int count, const char* name)
+    {
+        for (int i = 0; i < count; i++) {
+            if (NameEquals(fields[i].name, name)) {
+                return i;
+            }
+        }
+        return UnknownField();
+    }
+}
+
+// A field list resolved at compile time: gate and count names become
+// indexes, and neighbouring fixed size fields sharing a gate are merged
+// into runs read with a single fread
+template<size_t N> struct ChunkSchema {
+    static constexpr size_t Size = N;
+
+    ChunkField fields[N] = {};
+    int gate[N] = {};             // gate field index, -1 if always present
+    int count[N] = {};            // count field index, -1 for a fixed size
+    int run[N] = {};              // fields in the run starting here
+    uint32_t runBytes[N] = {};
+
+    constexpr int indexOf(const char* name) const { return ChunkSchemaDetail::IndexOf(fields, N, name); }
+};
+
+template<size_t N> constexpr ChunkSchema<N> MakeChunkSchema(const ChunkField (&fields)[N])
+{
+    ChunkSchema<N> schema;
+    for (size_t i = 0; i < N; i++) {
+        schema.fields[i] = fields[i];
+        // Only earlier fields can gate or count, they have to be read first
+        schema.gate[i] = fields[i].gate ? ChunkSchemaDetail::IndexOf(fields, i, fields[i].gate) : -1;
+        schema.count[i] = fields[i].count ? ChunkSchemaDetail::IndexOf(fields, i, fields[i].count) : -1;
+    }
+    for (size_t i = N; i-- > 0; ) {
+        schema.run[i] = 1;
+        schema.runBytes[i] = schema.count[i] >= 0 ? 0 : fields[i].size;
+        const size_t next = i + 1;
+        if (next < N && schema.count[i] < 0 && schema.count[next] < 0 &&
+            schema.gate[next] == schema.gate[i] && fields[next].mask == fields[i].mask) {
+            schema.run[i] += schema.run[next];
+            schema.runBytes[i] += schema.runBytes[next];
+        }
+    }
+    return schema;
+}
+
+// Values of the fixed size fields of up to 8 bytes, indexed like the schema
+template<const auto& Schema> using ChunkFieldValues =
+    std::array<uint64_t, std::decay_t<decltype(Schema)>::Size>;
+
+namespace ChunkSchemaDetail {
+    inline uint64_t ValueOf(const char* data, uint32_t size)
+    {
+        uint64_t value = 0;
+        memcpy(&value, data, size < sizeof(value) ? size : sizeof(value));
+        return value;
+    }
+
+    template<const auto& Schema> const QVector<QString>& Keys()
+    {
+        static const QVector<QString> keys = [] {
+            QVector<QString> names;
+            for (const auto& field : Schema.fields) {
+                names.append(QString::fromLatin1(field.name));
+            }
+            return names;
+        }();
+        return keys;
+    }
+
+    template<const auto& Schema> bool Present(int i, const ChunkFieldValues<Schema>& values)
+    {
+        return Schema.gate[i] < 0 || (values[Schema.gate[i]] & Schema.fields[i].mask);
+    }
+}
+
+// Reads the fields into props, one checked fread and no ftell per run of
+// fixed size fields. Returns the field values for the chunk to act upon,
+// counted fields that cannot fit in the file are left empty
+template<const auto& Schema>
+ChunkFieldValues<Schema> ReadChunkFields(FILE* file, QMap<QString, ChunkProperty>& props)
+{
+    constexpr int N = std::decay_t<decltype(Schema)>::Size;
+    const auto& keys = ChunkSchemaDetail::Keys<Schema>();
+    ChunkFieldValues<Schema> values = {};
+    size_t offset = myftell64(file);
+    for (int i = 0; i < N; ) {
+        if (!ChunkSchemaDetail::Present<Schema>(i, values)) {
+            i += Schema.run[i];
+            continue;
+        }
+
+        const auto& field = Schema.fields[i];
+        if (Schema.count[i] >= 0) {
+            if (!BaseChunk::FitsInFile(file, values[Schema.count[i]], field.size, field.name)) {
+                values[Schema.count[i]] = 0;
+            }
+            QByteArray data(field.size * values[Schema.count[i]], 0);
+            BaseChunk::ReadBytes(file, data.data(), data.size());
+            props[keys[i]] = ChunkProperty { data, field.type, offset, (size_t)data.size() };
+            offset += data.size();
+            i++;
+            continue;
+        }
+
+        QByteArray block(Schema.runBytes[i], 0);
+        BaseChunk::ReadBytes(file, block.data(), block.size());
+        const bool single = Schema.run[i] == 1;
+        const int end = i + Schema.run[i];
+        for (int pos = 0; i < end; i++) {
+            const uint32_t size = Schema.fields[i].size;
+            values[i] = ChunkSchemaDetail::ValueOf(block.constData() + pos, size);
+            props[keys[i]] = ChunkProperty {
+                single ? block : block.mid(pos, size), Schema.fields[i].type, offset + pos, size
+            };
+            pos += size;
+        }
+        offset += block.size();
+    }
+    return values;
+}
+
+// Names of the fields props holds, in file order
+template<const auto& Schema>
+void AppendChunkFieldNames(const QMap<QString, ChunkProperty>& props, QStringList& names)
+{
+    foreach (const auto& key, ChunkSchemaDetail::Keys<Schema>()) {
+        if (props.contains(key)) {
+            names.append(key);
+        }
+    }
+}
+
+#endif // CHUNKSCHEMA_H
@@ -0,0 +1,34 @@
+#ifndef CHUNKVISITOR_H
+#define CHUNKVISITOR_H
+
+#include "basechunk.h"
+
+// Receives a DDI as it is read, instead of the tree. Array children are
+// reported and freed one by one, so only the chunks on the path being read
+// are ever held. Arrays carry their name after their children: a chunk's
+// name, its fields and the items its reader builds itself (frame refs,
+// sections, phoneme entries) are reported when it is left
+class ChunkVisitor {
+public:
+    virtual ~ChunkVisitor() { }
+
+    virtual void onEnterChunk(const QByteArray& signature, uint64_t offset) { }
+    virtual void onField(const QString& name, const ChunkProperty& prop) { }
+    // chunk is complete but for the array children reported before, and freed afterwards
+    virtual void onLeave(BaseChunk* chunk) { }
+
+    // Reports what is left of a chunk once its reader is done
+    void Finish(BaseChunk* chunk) {
+        foreach(auto i, chunk->Children) {
+            if(!i) continue;
+            onEnterChunk(i->ObjectSignature(), i->GetOriginalOffset());
+            Finish(i);
+        }
+        const auto& props = chunk->GetPropertiesMap();
+        foreach(auto key, chunk->OrderedKeys(props))
+            onField(key, props[key]);
+        onLeave(chunk);
+    }
+};
+
+#endif // CHUNKVISITOR_H
@@ -25,22 +25,13 @@ public:
 
 //        ReadArrayBody(file, 0);
         // Read subchunk count
-        char signatureBuf[4];
         uint32_t count;
         CHUNK_TREADPROP("Count", 4, PropU32Int);
         STUFF_INTO(GetProperty("Count").data, count, uint32_t);
         for(uint32_t ii = 0; ii < count; ii++) {
             ReadStringName(file); // HACK: Use current array's name as a temporary variable
 
-            // Read signature first
-            fpos_t pos;
-            fgetpos(file, &pos);
-            // Skip Leading QWORD if needed
-            if(HasLeadingQword) myfseek64(file, 8, SEEK_CUR);
-            fread(signatureBuf, 1, 4, file);
-            fsetpos(file, &pos);
-
-            auto sig = QByteArray(signatureBuf, 4);
+            // Parts are the only children here, no need to peek at the signature
             auto chk = new ChunkDBVArticulationPhUPart_DevDB;
             chk->Read(file);
 
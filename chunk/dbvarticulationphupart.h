@@ -15,42 +15,58 @@ public:
     static QByteArray ClassSignature() { return "ARTp"; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
 
+    static constexpr ChunkField PartFields[] = {
+        { "TimeInfo", PropHex64, 8 },           // time info
+        { "Flags", PropU16Int, 2 },             // flags
+        { "mPitch", PropF32, 4 },               // relative pitch
+        { "Average pitch", PropF32, 4 },        // average pitch
+        { "PitchDeviation", PropF32, 4 },       // pitch deviation
+        { "Dynamic", PropF32, 4 },              // dynamics/velocity
+        { "Tempo", PropF32, 4 },                // tempo
+    };
+    static constexpr ChunkField FrameFields[] = {
+        { "Frame count", PropU32Int, 4 },
+    };
+    static constexpr ChunkField SoundFields[] = {
+        { "SND Sample rate", PropU32Int, 4 },
+        { "SND Channel count", PropU16Int, 2 },
+        { "SND Sample count", PropU32Int, 4 },
+        { "SND Sample offset", PropHex64, 8 },
+        { "SND Sample offset+800", PropHex64, 8 },
+        { "Section count", PropU32Int, 4 },     // half-phone section count
+    };
+    static constexpr auto Part = MakeChunkSchema(PartFields);
+    static constexpr auto Frames = MakeChunkSchema(FrameFields);
+    static constexpr auto Sound = MakeChunkSchema(SoundFields);
+    static constexpr int FrameCountField = Frames.indexOf("Frame count");
+    static constexpr int SectionCountField = Sound.indexOf("Section count");
+    static_assert(FrameCountField >= 0 && SectionCountField >= 0, "ARTp field renamed");
+
     virtual void Read(FILE *file) {
-        uint32_t frameCount, sectionCount;
         ItemDirectory* sectionDir = nullptr;
         ReadBlockSignature(file);
         ReadArrayHead(file);
-        CHUNK_TREADPROP("TimeInfo", 8, PropHex64);         // time info
-        CHUNK_TREADPROP("Flags", 2, PropU16Int);           // flags
-        CHUNK_TREADPROP("mPitch", 4, PropF32);             // relative pitch
-        CHUNK_TREADPROP("Average pitch", 4, PropF32);      // average pitch
-        CHUNK_TREADPROP("PitchDeviation", 4, PropF32);     // pitch deviation
-        CHUNK_TREADPROP("Dynamic", 4, PropF32);            // dynamics/velocity
-        CHUNK_TREADPROP("Tempo", 4, PropF32);              // tempo
+        ReadChunkFields<Part>(file, mAdditionalProperties);
         ReadArrayBody(file, 0);
 
-        CHUNK_TREADPROP("Frame count", 4, PropU32Int);
-        STUFF_INTO(GetProperty("Frame count").data, frameCount, uint32_t);
+        auto frames = ReadChunkFields<Frames>(file, mAdditionalProperties);
         {
-            auto frameDir = new ItemAudioFrameRefs(frameCount);
+            auto frameDir = new ItemAudioFrameRefs(frames[FrameCountField]);
             frameDir->SetName("<Frames>");
             frameDir->Read(file);
             Children.append(frameDir);
         }
 
-        CHUNK_TREADPROP("SND Sample rate", 4, PropU32Int);
-        CHUNK_TREADPROP("SND Channel count", 2, PropU16Int);
-        CHUNK_TREADPROP("SND Sample count", 4, PropU32Int);
-        CHUNK_TREADPROP("SND Sample offset", 8, PropHex64);
-        CHUNK_TREADPROP("SND Sample offset+800", 8, PropHex64);
-        CHUNK_TREADPROP("Section count", 4, PropU32Int);   // half-phone section count
-        STUFF_INTO(GetProperty("Section count").data, sectionCount, uint32_t);
+        auto sound = ReadChunkFields<Sound>(file, mAdditionalProperties);
+        uint32_t sectionCount = sound[SectionCountField];
+        if(!FitsInFile(file, sectionCount, 16, "sections"))
+            sectionCount = 0;
         if(sectionCount) {
             sectionDir = new ItemDirectory;
             sectionDir->SetName("<sections>");
             Children.append(sectionDir);
         }
-        for(int i = 0; i < sectionCount; i++) {
+        for(uint32_t i = 0; i < sectionCount && !ReadFailed(); i++) {
             auto artSec = new ItemArticulationSection;
             artSec->Read(file);
             artSec->SetName(QString("<section %1>").arg(i));
@@ -63,6 +79,14 @@ public:
         return "DBVArticulationPhUPart";
     }
 
+    virtual QStringList FieldOrder() {
+        auto names = ChunkChunkArray::FieldOrder();
+        AppendChunkFieldNames<Part>(mAdditionalProperties, names);
+        AppendChunkFieldNames<Frames>(mAdditionalProperties, names);
+        AppendChunkFieldNames<Sound>(mAdditionalProperties, names);
+        return names;
+    }
+
     static BaseChunk* Make() { return new ChunkDBVArticulationPhUPart; }
 };
 
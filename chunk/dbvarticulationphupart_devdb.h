@@ -14,6 +14,7 @@ public:
 
     static QByteArray ClassSignature() { return "ARTp"; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
+    virtual size_t ObjectSize() { return sizeof(*this); }
 
     virtual void Read(FILE *file) {
         uint32_t frameCount = 0;
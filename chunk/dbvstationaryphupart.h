@@ -13,38 +13,51 @@ public:
     static QByteArray ClassSignature() { return "STAp"; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
 
+    static constexpr ChunkField PartFields[] = {
+        { "TimeInfo", PropHex64, 8 },           // time info
+        { "Flags", PropU16Int, 2 },             // flags
+        { "mPitch", PropF32, 4 },               // relative pitch
+        { "Average pitch", PropF32, 4 },        // average pitch
+        { "PitchDeviation", PropF32, 4 },       // pitch deviation
+        { "Dynamic", PropF32, 4 },              // dynamics/velocity
+        { "Tempo", PropF32, 4 },                // tempo
+        { "LoopInfo", PropU32Int, 4 },          // loop info
+    };
+    static constexpr ChunkField FrameFields[] = {
+        { "FrameDataSize", PropU32Int, 4 },     // frame data size
+        { "Frame count", PropU32Int, 4 },
+    };
+    static constexpr ChunkField SoundFields[] = {
+        { "SND Sample rate", PropU32Int, 4 },
+        { "SND Channel count", PropU16Int, 2 },
+        { "SND Sample count", PropU32Int, 4 },
+        { "SND Sample offset", PropHex64, 8 },
+        { "EpRTrackIndex", PropS32Int, 4 },     // EpR track index (-1=none)
+        { "ResTrackIndex", PropS32Int, 4 },     // residual track index (-1=none)
+        { "OptionalIndex3", PropS32Int, 4 },    // optional index 3 (-1=none)
+        { "OptionalIndex4", PropS32Int, 4 },    // optional index 4 (-1=none)
+    };
+    static constexpr auto Part = MakeChunkSchema(PartFields);
+    static constexpr auto Frames = MakeChunkSchema(FrameFields);
+    static constexpr auto Sound = MakeChunkSchema(SoundFields);
+    static constexpr int FrameCountField = Frames.indexOf("Frame count");
+    static_assert(FrameCountField >= 0, "STAp field renamed");
+
     virtual void Read(FILE *file) {
-        uint32_t frameCount;
         ReadBlockSignature(file);
         ReadArrayHead(file);
-        CHUNK_TREADPROP("TimeInfo", 8, PropHex64);         // time info
-        CHUNK_TREADPROP("Flags", 2, PropU16Int);           // flags
-        CHUNK_TREADPROP("mPitch", 4, PropF32);             // relative pitch
-        CHUNK_TREADPROP("Average pitch", 4, PropF32);      // average pitch
-        CHUNK_TREADPROP("PitchDeviation", 4, PropF32);     // pitch deviation
-        CHUNK_TREADPROP("Dynamic", 4, PropF32);            // dynamics/velocity
-        CHUNK_TREADPROP("Tempo", 4, PropF32);              // tempo
-        CHUNK_TREADPROP("LoopInfo", 4, PropU32Int);        // loop info
+        ReadChunkFields<Part>(file, mAdditionalProperties);
         ReadArrayBody(file, 0);
-        CHUNK_TREADPROP("FrameDataSize", 4, PropU32Int);   // frame data size
 
-        CHUNK_TREADPROP("Frame count", 4, PropU32Int);
-        STUFF_INTO(GetProperty("Frame count").data, frameCount, uint32_t);
+        auto frames = ReadChunkFields<Frames>(file, mAdditionalProperties);
         {
-            auto frameDir = new ItemAudioFrameRefs(frameCount);
+            auto frameDir = new ItemAudioFrameRefs(frames[FrameCountField]);
             frameDir->SetName("<Frames>");
             frameDir->Read(file);
             Children.append(frameDir);
         }
 
-        CHUNK_TREADPROP("SND Sample rate", 4, PropU32Int);
-        CHUNK_TREADPROP("SND Channel count", 2, PropU16Int);
-        CHUNK_TREADPROP("SND Sample count", 4, PropU32Int);
-        CHUNK_TREADPROP("SND Sample offset", 8, PropHex64);
-        CHUNK_TREADPROP("EpRTrackIndex", 4, PropS32Int);   // EpR track index (-1=none)
-        CHUNK_TREADPROP("ResTrackIndex", 4, PropS32Int);   // residual track index (-1=none)
-        CHUNK_TREADPROP("OptionalIndex3", 4, PropS32Int);  // optional index 3 (-1=none)
-        CHUNK_TREADPROP("OptionalIndex4", 4, PropS32Int);  // optional index 4 (-1=none)
+        ReadChunkFields<Sound>(file, mAdditionalProperties);
         ReadStringName(file);
     }
 
@@ -52,6 +65,14 @@ public:
         return "DBVStationaryPhUPart";
     }
 
+    virtual QStringList FieldOrder() {
+        auto names = ChunkChunkArray::FieldOrder();
+        AppendChunkFieldNames<Part>(mAdditionalProperties, names);
+        AppendChunkFieldNames<Frames>(mAdditionalProperties, names);
+        AppendChunkFieldNames<Sound>(mAdditionalProperties, names);
+        return names;
+    }
+
     static BaseChunk* Make() { return new ChunkDBVStationaryPhUPart; }
 };
 
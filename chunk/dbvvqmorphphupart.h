@@ -12,30 +12,37 @@ public:
     static QByteArray ClassSignature() { return "VQMp"; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
 
+    static constexpr ChunkField PartFields[] = {
+        { "TimeInfo", PropHex64, 8 },           // time info
+        { "Flags", PropU16Int, 2 },             // flags
+        { "mPitch", PropF32, 4 },               // relative pitch
+        { "Average pitch", PropF32, 4 },        // average pitch
+        { "PitchDeviation", PropF32, 4 },       // pitch deviation
+        { "Dynamic", PropF32, 4 },              // dynamics/velocity
+        { "Tempo", PropF32, 4 },                // tempo
+    };
+    static constexpr ChunkField BodyFields[] = {
+        { "FrameDataSize", PropU32Int, 4 },     // frame data size
+        { "Frame count", PropU32Int, 4 },
+        { "FrameRefs", PropRawHex, 8, nullptr, 0, "Frame count" },  // frame references array
+        { "SND Sample rate", PropU32Int, 4 },
+        { "SND Channel count", PropU16Int, 2 },
+        { "SND Sample count", PropU32Int, 4 },
+        { "SND Sample offset", PropHex64, 8 },
+        { "EpRTrackIndex", PropS32Int, 4 },     // EpR track index (-1=none)
+        { "ResTrackIndex", PropS32Int, 4 },     // residual track index (-1=none)
+        { "OptionalIndex3", PropS32Int, 4 },    // optional index 3 (-1=none)
+        { "OptionalIndex4", PropS32Int, 4 },    // optional index 4 (-1=none)
+    };
+    static constexpr auto Part = MakeChunkSchema(PartFields);
+    static constexpr auto Body = MakeChunkSchema(BodyFields);
+
     virtual void Read(FILE *file) {
-        uint32_t dataCount;
         ReadBlockSignature(file);
         ReadArrayHead(file);
-        CHUNK_TREADPROP("TimeInfo", 8, PropHex64);         // time info
-        CHUNK_TREADPROP("Flags", 2, PropU16Int);           // flags
-        CHUNK_TREADPROP("mPitch", 4, PropF32);             // relative pitch
-        CHUNK_TREADPROP("Average pitch", 4, PropF32);      // average pitch
-        CHUNK_TREADPROP("PitchDeviation", 4, PropF32);     // pitch deviation
-        CHUNK_TREADPROP("Dynamic", 4, PropF32);            // dynamics/velocity
-        CHUNK_TREADPROP("Tempo", 4, PropF32);              // tempo
+        ReadChunkFields<Part>(file, mAdditionalProperties);
         ReadArrayBody(file, 0);
-        CHUNK_TREADPROP("FrameDataSize", 4, PropU32Int);   // frame data size
-        CHUNK_TREADPROP("Frame count", 4, PropU32Int);
-        STUFF_INTO(GetProperty("Frame count").data, dataCount, uint32_t);
-        CHUNK_READPROP("FrameRefs", 8 * dataCount);        // frame references array
-        CHUNK_TREADPROP("SND Sample rate", 4, PropU32Int);
-        CHUNK_TREADPROP("SND Channel count", 2, PropU16Int);
-        CHUNK_TREADPROP("SND Sample count", 4, PropU32Int);
-        CHUNK_TREADPROP("SND Sample offset", 8, PropHex64);
-        CHUNK_TREADPROP("EpRTrackIndex", 4, PropS32Int);   // EpR track index (-1=none)
-        CHUNK_TREADPROP("ResTrackIndex", 4, PropS32Int);   // residual track index (-1=none)
-        CHUNK_TREADPROP("OptionalIndex3", 4, PropS32Int);  // optional index 3 (-1=none)
-        CHUNK_TREADPROP("OptionalIndex4", 4, PropS32Int);  // optional index 4 (-1=none)
+        ReadChunkFields<Body>(file, mAdditionalProperties);
         ReadStringName(file);
     }
 
@@ -43,6 +50,13 @@ public:
         return "DBVVQMorphPhUPart";
     }
 
+    virtual QStringList FieldOrder() {
+        auto names = ChunkChunkArray::FieldOrder();
+        AppendChunkFieldNames<Part>(mAdditionalProperties, names);
+        AppendChunkFieldNames<Body>(mAdditionalProperties, names);
+        return names;
+    }
+
     static BaseChunk* Make() { return new ChunkDBVVQMorphPhUPart; }
 };
 
@@ -3,6 +3,8 @@
 
 #include "basechunk.h"
 
+// The FRM2 offsets of a unit part, kept as one array instead of a property
+// per frame. The "Frame 00000".. rows are only made up for display.
 class ItemAudioFrameRefs : public BaseChunk {
 public:
     explicit ItemAudioFrameRefs(uint32_t count) : BaseChunk(), m_count(count) {
@@ -14,22 +16,44 @@ public:
 
     static QByteArray ClassSignature() { return "____AudioFrameRefs"; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
+    virtual size_t ObjectSize() { return sizeof(*this); }
 
     virtual void Read(FILE *file) {
         ReadOriginalOffset(file);
-        for (uint32_t i = 0; i < m_count; i++) {
-            CHUNK_TREADPROP(QString("Frame %1").arg(i, 5, 10, QChar('0')), 8, PropHex64);
-        }
+        if(!FitsInFile(file, m_count, sizeof(quint64), "frame references"))
+            m_count = 0;
+        m_offsets.resize(m_count);
+        m_offsets.resize(fread(m_offsets.data(), sizeof(quint64), m_count, file));
     }
 
     virtual QString Description() {
         return "<Audio frame references>";
     }
 
+    virtual QMap<QString, ChunkProperty> GetDisplayProperties() {
+        auto props = mAdditionalProperties;
+        for (int i = 0; i < m_offsets.size(); i++) {
+            props[QString("Frame %1").arg(i, 5, 10, QChar('0'))] = ChunkProperty {
+                QByteArray((const char *)&m_offsets[i], sizeof(quint64)), PropHex64, (size_t)FieldOffset(i)
+            };
+        }
+        return props;
+    }
+
+    virtual void WriteSpans(QVector<ChunkSpan>& spans) {
+        QByteArray data((const char *)m_offsets.constData(), m_offsets.size() * sizeof(quint64));
+        spans.append(ChunkSpan {mOriginalOffset, (uint64_t)data.size(), data});
+    }
+
+    const QVector<quint64>& Offsets() const { return m_offsets; }
+    // DDI offset of the field holding frame i
+    quint64 FieldOffset(int i) const { return mOriginalOffset + (quint64)i * sizeof(quint64); }
+
     static BaseChunk* Make() { return new ItemAudioFrameRefs(0); }
 
 protected:
     uint32_t m_count = 0;
+    QVector<quint64> m_offsets;
 };
 
 #endif // ITEM_AUDIOFRAMEREFS_H
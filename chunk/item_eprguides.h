@@ -19,7 +19,9 @@ public:
         CHUNK_READPROP("Name", 32);
         CHUNK_READPROP("Parameter count", 4);
         STUFF_INTO(GetProperty("Parameter count").data, paramCount, uint32_t);
-        for(uint32_t i = 0; i < paramCount; i++) {
+        if(!FitsInFile(file, paramCount, 16, "parameters"))
+            paramCount = 0;
+        for(uint32_t i = 0; i < paramCount && !ReadFailed(); i++) {
             CHUNK_READPROP(QString("Offset %1 A").arg(i, 4, 10, QChar('0')), 8);
             CHUNK_READPROP(QString("Offset %1 B").arg(i, 4, 10, QChar('0')), 8);
         }
@@ -47,7 +49,9 @@ public:
         BaseChunk::Read(file);
         CHUNK_READPROP("Count", 4);
         STUFF_INTO(GetProperty("Count").data, groupCount, uint32_t);
-        for(uint32_t i = 0; i < groupCount; i++) {
+        if(!FitsInFile(file, groupCount, 36, "EpR guides"))
+            groupCount = 0;
+        for(uint32_t i = 0; i < groupCount && !ReadFailed(); i++) {
             CHUNK_READCHILD(ItemEprGuide, this);
         }
 
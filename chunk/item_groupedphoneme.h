@@ -17,8 +17,10 @@ public:
         // Read phoneme name
         CHUNK_READPROP("Length", 4);
         uint32_t length; STUFF_INTO(GetProperty("Length").data, length, uint32_t);
+        if(!FitsInFile(file, length, 1, "name bytes"))
+            return;
         QByteArray tmp(length, 0);
-        fread(tmp.data(), 1, length, file);
+        ReadBytes(file, tmp.data(), length);
         mName = tmp;
 
         CHUNK_READPROP("Phoneme No", 4);
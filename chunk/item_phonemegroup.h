@@ -13,13 +13,18 @@ public:
     static QByteArray ClassSignature() { return "____PhonemeGroup"; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
 
+    // Name length, phoneme count and group type, with an empty name and no phonemes
+    static constexpr uint64_t MinSize = 4 + 4 + 4;
+
     virtual void Read(FILE *file) {
         BaseChunk::Read(file);
         // Read group name
         CHUNK_READPROP("Name length", 4);
         uint32_t length; STUFF_INTO(GetProperty("Name length").data, length, uint32_t);
+        if(!FitsInFile(file, length, 1, "name bytes"))
+            return;
         QByteArray tmp(length, 0);
-        fread(tmp.data(), 1, length, file);
+        ReadBytes(file, tmp.data(), length);
         mName = tmp;
 
         CHUNK_TREADPROP("Phoneme count", 4, PropU32Int);
@@ -27,7 +32,9 @@ public:
 
         // Read phoneme items
         uint32_t count; STUFF_INTO(GetProperty("Phoneme count").data, count, uint32_t);
-        for(uint32_t ii = 0; ii < count; ii++) {
+        if(!FitsInFile(file, count, 8, "phonemes"))
+            return;
+        for(uint32_t ii = 0; ii < count && !ReadFailed(); ii++) {
             CHUNK_READCHILD(ItemGroupedPhoneme, this);
         }
     }
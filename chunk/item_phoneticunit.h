@@ -15,7 +15,7 @@ public:
     virtual void Read(FILE *file) {
         BaseChunk::Read(file);
         QByteArray tmp(18, 0);
-        fread(tmp.data(), 1, 18, file);
+        ReadBytes(file, tmp.data(), 18);
         // Trim at first null byte
         int nullPos = tmp.indexOf('\0');
         if (nullPos >= 0) {
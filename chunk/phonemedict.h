@@ -26,7 +26,9 @@ public:
         Children.append(PhonemeDir);
         uint32_t PhonemeCount;
         STUFF_INTO(GetProperty("Phoneme count").data, PhonemeCount, uint32_t);
-        for(uint32_t ii = 0; ii < PhonemeCount; ii++) {
+        if(!FitsInFile(file, PhonemeCount, 31, "phonemes"))
+            PhonemeCount = 0;
+        for(uint32_t ii = 0; ii < PhonemeCount && !ReadFailed(); ii++) {
             CHUNK_READCHILD(ItemPhoneticUnit, PhonemeDir);
         }
         PhonemeDir->SetName("<Phonemes>");
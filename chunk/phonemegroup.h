@@ -21,7 +21,9 @@ public:
         // Groups
         uint32_t GroupCount;
         STUFF_INTO(GetProperty("Group count").data, GroupCount, uint32_t);
-        for(uint32_t ii = 0; ii < GroupCount; ii++) {
+        if(!FitsInFile(file, GroupCount, ItemPhonemeGroup::MinSize, "phoneme groups"))
+            GroupCount = 0;
+        for(uint32_t ii = 0; ii < GroupCount && !ReadFailed(); ii++) {
             CHUNK_READCHILD(ItemPhonemeGroup, this);
         }
 
@@ -13,6 +13,7 @@ public:
     static QByteArray ClassSignature() { return "____RefSND "; }
     // ObjectSignature returns the actual file signature, not the class signature
     virtual QByteArray ObjectSignature() { return "SND "; }
+    virtual size_t ObjectSize() { return sizeof(*this); }
 
     virtual void Read(FILE *file) {
         ReadBlockSignature(file);
@@ -23,6 +24,11 @@ public:
         STUFF_INTO(GetProperty("Sample count").data, sampleCount, uint32_t);
 
         sampleOffset = myftell64(file);
+        if (mSize < 0x12) {
+            // Taken as an empty sound, so that walks over the DDB keep moving
+            ReadError(file, QString("SND is %1 bytes long").arg(mSize));
+            mSize = 0x12;
+        }
         sampleBytes = mSize - 0x12;
         myfseek64(file, sampleBytes, SEEK_CUR); // Skip sample data
     }
@@ -17,6 +17,12 @@ public:
         ReadBlockSignature(file);
         mName = QString("<Skipped %1>").arg(QString(mSignature));
 
+        if(mSize < 8) {
+            // Nothing after it can be found, and walks over the DDB have to end
+            ReadError(file, QString("chunk \"%1\" is %2 bytes long").arg(QString(mSignature)).arg(mSize));
+            myfseek64(file, 0, SEEK_END);
+            return;
+        }
         myfseek64(file, mSize - 8, SEEK_CUR);
     }
 
@@ -3,8 +3,8 @@
 
 #include "basechunk.h"
 #include "util/util.h"
+#include "util/smsframeview.h"
 #include <QByteArray>
-#include <QFile>
 
 class ChunkSMSFrameChunk : public BaseChunk {
 public:
@@ -14,26 +14,41 @@ public:
 
     static QByteArray ClassSignature() { return "FRM2"; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
+    virtual size_t ObjectSize() { return sizeof(*this); }
 
     virtual void Read(FILE *file) {
         auto originalOffset = myftell64(file);
 
         ReadBlockSignature(file);
-
-        // Read the entire frame data for later writing
-        QFile f;
-        if (f.open(file, QFile::ReadOnly)) {
-            f.seek(originalOffset);
-            rawData = f.read(mSize);
+        if (mSize < 8) {
+            ReadError(file, QString("frame is %1 bytes long").arg(mSize));
+            return;
+        }
+        if (HeaderOnly) {
             myfseek64(file, originalOffset + mSize, SEEK_SET);
-            f.close();
+            return;
         }
+
+        // Read the entire frame data for later writing
+        rawData.resize(mSize);
+        myfseek64(file, originalOffset, SEEK_SET);
+        rawData.resize(fread(rawData.data(), 1, mSize, file));
+        myfseek64(file, originalOffset + mSize, SEEK_SET);
     }
 
     virtual QString Description() {
         return "SMSFrame";
     }
 
+    // rawData already holds the header, the properties would only overlap it
+    virtual void WriteSpans(QVector<ChunkSpan>& spans) {
+        if (!rawData.isEmpty())
+            spans.append(ChunkSpan {mOriginalOffset, (uint64_t)rawData.size(), rawData});
+    }
+
+    // Typed access to the frame, valid as long as rawData is untouched
+    SmsFrameView View() const { return SmsFrameView(rawData.constData(), rawData.size()); }
+
     QByteArray rawData;
 
     static BaseChunk* Make() { return new ChunkSMSFrameChunk; }
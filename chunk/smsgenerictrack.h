@@ -25,7 +25,9 @@ public:
         CHUNK_TREADPROP("Region count", 4, PropU32Int);
 
         uint32_t rgnCount; STUFF_INTO(GetProperty("Region count").data, rgnCount, uint32_t);
-        for (size_t ii = 0; ii < rgnCount; ii++) {
+        if (!FitsInFile(file, rgnCount, 8, "regions"))
+            rgnCount = 0;
+        for (size_t ii = 0; ii < rgnCount && !ReadFailed(); ii++) {
             auto rgn = new ChunkSMSRegionChunk;
             rgn->Read(file);
             rgn->SetName(QString("Region %1").arg(ii));
@@ -2,6 +2,7 @@
 #define SMSREGION_H
 
 #include "basechunk.h"
+#include "chunkschema.h"
 #include "smsframe.h"
 #include "skipchunk.h"
 
@@ -14,54 +15,56 @@ public:
     static QByteArray ClassSignature() { return "RGN "; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
 
+    static constexpr ChunkField RegionFields[] = {
+        { "TimeOffset", PropF64, 8 },                           // time offset
+        { "RegionType", PropU8Int, 1 },                         // region type
+        { "Flags1", PropU8Int, 1 },
+        { "ExtFlags", PropU32Int, 4, "Flags1", 0x01 },          // extended flags
+        { "AttackTime", PropF32, 4, "Flags1", 0x01 },           // attack time
+        { "ReleaseTime", PropF32, 4, "Flags1", 0x01 },          // release time
+        { "SustainLevel", PropF32, 4, "Flags1", 0x01 },         // sustain level
+        { "DecayTime", PropF32, 4, "Flags1", 0x01 },            // decay time
+        { "PeakLevel", PropF32, 4, "Flags1", 0x01 },            // peak level
+        { "InitialLevel", PropF32, 4, "Flags1", 0x01 },         // initial level
+        { "FinalLevel", PropF32, 4, "Flags1", 0x01 },           // final level
+        { "VibratoDepth", PropF32, 4, "Flags1", 0x01 },         // vibrato depth
+        { "VibratoRate", PropF64, 8, "Flags1", 0x01 },          // vibrato rate
+        { "VibratoDelay", PropF64, 8, "Flags1", 0x01 },         // vibrato delay
+        { "PitchBendData", PropRawHex, 80, "Flags1", 0x01 },    // pitch bend data
+        { "DynamicsData", PropRawHex, 160, "Flags1", 0x01 },    // dynamics data
+        { "ExpressionData", PropRawHex, 28, "Flags1", 0x01 },   // expression data
+        { "VoiceType", PropU8Int, 1, "Flags1", 0x02 },          // voice type
+        { "ScoringNoteIndex", PropU32Int, 4, "Flags1", 0x04 },  // scoring note index
+        { "SegmentCount", PropU32Int, 4, "Flags1", 0x08 },
+        { "SegmentData", PropRawHex, 16, "Flags1", 0x08, "SegmentCount" },     // segment data
+        { "PitchPointCount", PropU32Int, 4, "Flags1", 0x10 },
+        { "PitchContour", PropRawHex, 8, "Flags1", 0x10, "PitchPointCount" },  // pitch contour
+        { "TimbreParams", PropRawHex, 24, "Flags1", 0x20 },     // timbre parameters
+        { "StableBegin", PropU32Int, 4, "Flags1", 0x20 },       // stable region begin
+        { "StableEnd", PropU32Int, 4, "Flags1", 0x20 },         // stable region end
+        { "ExtraParams", PropRawHex, 48, "Flags1", 0x40 },      // extra parameters
+        { "Flags2", PropU8Int, 1 },
+    };
+    // Follows the envelopes, only when Flags2 has 0x40
+    static constexpr ChunkField StableRegionFields[] = {
+        { "Stable region begin", PropU32Int, 4 },
+        { "Stable region end", PropU32Int, 4 },
+    };
+    static constexpr ChunkField FrameFields[] = {
+        { "Frame count", PropU32Int, 4 },
+    };
+    static constexpr auto Region = MakeChunkSchema(RegionFields);
+    static constexpr auto StableRegion = MakeChunkSchema(StableRegionFields);
+    static constexpr auto Frames = MakeChunkSchema(FrameFields);
+    static constexpr int Flags2Field = Region.indexOf("Flags2");
+    static constexpr int FrameCountField = Frames.indexOf("Frame count");
+    static_assert(Flags2Field >= 0 && FrameCountField >= 0, "RGN field renamed");
+
     virtual void Read(FILE *file) {
         ReadBlockSignature(file);
 
-        CHUNK_TREADPROP("TimeOffset", 8, PropF64);         // time offset
-        CHUNK_TREADPROP("RegionType", 1, PropU8Int);       // region type
-
-        uint8_t flags1, flags2;
-        CHUNK_TREADPROP("Flags1", 1, PropU8Int); STUFF_INTO(GetProperty("Flags1").data, flags1, uint8_t);
-        if (flags1 & 0x01) {
-            CHUNK_TREADPROP("ExtFlags", 4, PropU32Int);           // extended flags
-            CHUNK_TREADPROP("AttackTime", 4, PropF32);            // attack time
-            CHUNK_TREADPROP("ReleaseTime", 4, PropF32);           // release time
-            CHUNK_TREADPROP("SustainLevel", 4, PropF32);          // sustain level
-            CHUNK_TREADPROP("DecayTime", 4, PropF32);             // decay time
-            CHUNK_TREADPROP("PeakLevel", 4, PropF32);             // peak level
-            CHUNK_TREADPROP("InitialLevel", 4, PropF32);          // initial level
-            CHUNK_TREADPROP("FinalLevel", 4, PropF32);            // final level
-            CHUNK_TREADPROP("VibratoDepth", 4, PropF32);          // vibrato depth
-            CHUNK_TREADPROP("VibratoRate", 8, PropF64);           // vibrato rate
-            CHUNK_TREADPROP("VibratoDelay", 8, PropF64);          // vibrato delay
-            CHUNK_READPROP("PitchBendData", 80);                  // pitch bend data
-            CHUNK_READPROP("DynamicsData", 160);                  // dynamics data
-            CHUNK_READPROP("ExpressionData", 28);                 // expression data
-        }
-        if (flags1 & 0x02)
-            CHUNK_TREADPROP("VoiceType", 1, PropU8Int);           // voice type
-        if (flags1 & 0x04)
-            CHUNK_TREADPROP("ScoringNoteIndex", 4, PropU32Int);   // scoring note index
-        if (flags1 & 0x08) {
-            uint32_t segCount;
-            CHUNK_TREADPROP("SegmentCount", 4, PropU32Int); STUFF_INTO(GetProperty("SegmentCount").data, segCount, uint32_t);
-            CHUNK_READPROP("SegmentData", segCount * 16);         // segment data
-        }
-        if (flags1 & 0x10) {
-            uint32_t pitchCount;
-            CHUNK_TREADPROP("PitchPointCount", 4, PropU32Int); STUFF_INTO(GetProperty("PitchPointCount").data, pitchCount, uint32_t);
-            CHUNK_READPROP("PitchContour", pitchCount * 8);       // pitch contour
-        }
-        if (flags1 & 0x20) {
-            CHUNK_READPROP("TimbreParams", 24);                   // timbre parameters
-            CHUNK_TREADPROP("StableBegin", 4, PropU32Int);        // stable region begin
-            CHUNK_TREADPROP("StableEnd", 4, PropU32Int);          // stable region end
-        }
-        if (flags1 & 0x40) {
-            CHUNK_READPROP("ExtraParams", 48);                    // extra parameters
-        }
-
-        CHUNK_TREADPROP("Flags2", 1, PropU8Int); STUFF_INTO(GetProperty("Flags2").data, flags2, uint8_t);
+        auto region = ReadChunkFields<Region>(file, mAdditionalProperties);
+        uint8_t flags2 = region[Flags2Field];
         if (flags2 & 0x01) CHUNK_READCHILD(ChunkSkipChunk, this); // Envelope 1
         if (flags2 & 0x02) CHUNK_READCHILD(ChunkSkipChunk, this); // Envelope 2
         if (flags2 & 0x04) CHUNK_READCHILD(ChunkSkipChunk, this); // Envelope 3
@@ -69,13 +72,14 @@ public:
         if (flags2 & 0x10) CHUNK_READCHILD(ChunkSkipChunk, this); // Envelope 5
         if (flags2 & 0x20) CHUNK_READCHILD(ChunkSkipChunk, this); // ThinEnvelope
         if (flags2 & 0x40) {
-            CHUNK_TREADPROP("Stable region begin", 4, PropU32Int);
-            CHUNK_TREADPROP("Stable region end", 4, PropU32Int);
+            ReadChunkFields<StableRegion>(file, mAdditionalProperties);
         }
 
-        uint32_t frameCount;
-        CHUNK_TREADPROP("Frame count", 4, PropU32Int); STUFF_INTO(GetProperty("Frame count").data, frameCount, uint32_t);
-        for (size_t ii = 0; ii < frameCount; ii++) {
+        auto frames = ReadChunkFields<Frames>(file, mAdditionalProperties);
+        uint32_t frameCount = frames[FrameCountField];
+        if (!FitsInFile(file, frameCount, 8, "frames"))
+            frameCount = 0;
+        for (size_t ii = 0; ii < frameCount && !ReadFailed(); ii++) {
             auto frame = new ChunkSMSFrameChunk;
             frame->Read(file);
             frame->SetName(
@@ -91,6 +95,14 @@ public:
         return "SMSRegion";
     }
 
+    virtual QStringList FieldOrder() {
+        QStringList names;
+        AppendChunkFieldNames<Region>(mAdditionalProperties, names);
+        AppendChunkFieldNames<StableRegion>(mAdditionalProperties, names);
+        AppendChunkFieldNames<Frames>(mAdditionalProperties, names);
+        return names;
+    }
+
     static BaseChunk* Make() { return new ChunkSMSRegionChunk; }
 };
 
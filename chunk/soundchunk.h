@@ -3,10 +3,12 @@
 
 #include <QFile>
 #include <QDebug>
+#include <QSharedPointer>
 #include "basechunk.h"
 #include "propertytype.h"
 #include "common.h"
 #include "util/util.h"
+#include "util/mappedfile.h"
 
 class ChunkSoundChunk : public BaseChunk {
 public:
@@ -16,6 +18,7 @@ public:
 
     static QByteArray ClassSignature() { return "SND "; }
     virtual QByteArray ObjectSignature() { return ClassSignature(); }
+    virtual size_t ObjectSize() { return sizeof(*this); }
 
     virtual void Read(FILE *file) {
         ReadBlockSignature(file);
@@ -24,61 +27,93 @@ public:
         CHUNK_TREADPROP("Sample count", 4, PropU32Int);
 
         STUFF_INTO(GetProperty("Sample count").data, sampleCount, uint32_t);
+        if (!FitsInFile(file, sampleCount, 2, "samples"))
+            sampleCount = 0;
+        sampleOffset = myftell64(file);
+        const uint64_t bytes = (uint64_t)sampleCount * 2;
+        if (HeaderOnly || (Mapping && Mapping->contains(sampleOffset, bytes))) {
+            // Samples stay in the mapped file, only their place is kept
+            if (!HeaderOnly)
+                mapping = Mapping->sharedFromThis();
+            myfseek64(file, bytes, SEEK_CUR);
+            return;
+        }
 
         // Read sample data directly
-        sampleData.resize(sampleCount * 2); // 16bit samples
-        fread(sampleData.data(), 1, sampleCount * 2, file);
+        sampleData.resize(bytes); // 16bit samples
+        ReadBytes(file, sampleData.data(), bytes);
     }
 
     virtual QString Description() {
         return "Sound chunk";
     }
 
-    // [from, to) samples
-    // Returns a complete SND chunk with header: "SND " + size(4) + sampleRate(4) + channelCount(2) + sampleCount(4) + data
-    QByteArray GetTruncatedChunk(int64_t from, int64_t to) {
-        // Clamp to valid range
+    virtual void WriteSpans(QVector<ChunkSpan>& spans) {
+        BaseChunk::WriteSpans(spans);
+        // Samples follow the count, unless only the header was read
+        if (GetProperty("Sample count").sourceSize && HasSamples())
+            spans.append(ChunkSpan {sampleOffset, (uint64_t)sampleCount * 2, Samples()});
+    }
+
+    // Whether the samples were kept, they are not after a header only read
+    bool HasSamples() const {
+        return mapping || sampleData.size() == (int64_t)sampleCount * 2;
+    }
+
+    // Sample bytes, pointing into the mapping when there is one
+    QByteArray Samples() const {
+        if (!mapping)
+            return sampleData;
+        return QByteArray::fromRawData((const char*)mapping->data() + sampleOffset, sampleCount * 2);
+    }
+
+    // Puts [from, to) within the samples, all of them if it is empty
+    void ClampRange(int64_t& from, int64_t& to) const {
         if (from < 0) from = 0;
         if (to > (int64_t)sampleCount) to = sampleCount;
         if (from >= to) {
-            qWarning() << "GetTruncatedChunk: invalid range from:" << from << "to:" << to << "sampleCount:" << sampleCount;
+            qWarning() << "ClampRange: invalid range from:" << from << "to:" << to << "sampleCount:" << sampleCount;
             from = 0;
             to = sampleCount;
         }
+    }
 
+    // [from, to) samples, clamped
+    // Returns the header of a SND holding them: "SND " + size(4) + sampleRate(4) + channelCount(2) + sampleCount(4).
+    // The samples themselves are SampleBytes(from, to) of the source, copied after it
+    QByteArray GetTruncatedHeader(int64_t from, int64_t to) const {
+        ClampRange(from, to);
         uint32_t truncatedSampleCount = to - from;
 
-        // Build chunk: signature(4) + chunkSize(4) + sampleRate(4) + channelCount(2) + sampleCount(4) + data
         QByteArray chunk;
         chunk.append("SND ", 4);                                    // signature
         uint32_t chunkSize = 4 + 2 + 4 + truncatedSampleCount * 2;  // size excludes signature and size field
         chunk.append((const char*)&chunkSize, 4);                   // chunk size
-        chunk.append(GetProperty("Sample rate").data);              // 4 bytes
-        chunk.append(GetProperty("Channel count").data);            // 2 bytes
+        chunk.append(mAdditionalProperties.value("Sample rate").data);     // 4 bytes
+        chunk.append(mAdditionalProperties.value("Channel count").data);   // 2 bytes
         chunk.append((const char*)&truncatedSampleCount, 4);        // 4 bytes
-        chunk.append(sampleData.mid(from * 2, truncatedSampleCount * 2));  // sample data
-
-        // Verify size
-        int expectedTotalSize = 4 + 4 + 4 + 2 + 4 + truncatedSampleCount * 2;
-        if (chunk.size() != expectedTotalSize) {
-            qWarning() << "GetTruncatedChunk: size mismatch! expected:" << expectedTotalSize
-                       << "actual:" << chunk.size()
-                       << "from:" << from << "to:" << to
-                       << "truncatedSampleCount:" << truncatedSampleCount
-                       << "sampleCount:" << sampleCount
-                       << "sampleData.size:" << sampleData.size();
-        }
-
         return chunk;
     }
 
-    int16_t* begin() { return (int16_t*)(sampleData.data()); }
-    int16_t* end() { return (int16_t*)(sampleData.data() + sampleData.length()); }
+    // File offset and length of [from, to) samples, clamped
+    QPair<uint64_t, uint64_t> SampleBytes(int64_t from, int64_t to) const {
+        ClampRange(from, to);
+        return qMakePair(sampleOffset + from * 2, (uint64_t)(to - from) * 2);
+    }
+
+    // [from, to) samples
+    // Returns a complete SND chunk with header, samples included
+    QByteArray GetTruncatedChunk(int64_t from, int64_t to) const {
+        ClampRange(from, to);
+        return GetTruncatedHeader(from, to) + Samples().mid(from * 2, (to - from) * 2);
+    }
 
     static BaseChunk* Make() { return new ChunkSoundChunk; }
 
-    QByteArray sampleData;
-    uint32_t sampleCount;
+    QByteArray sampleData;                  // Empty when the samples are in mapping
+    QSharedPointer<MappedFile> mapping;
+    uint64_t sampleOffset = 0;              // File offset of the first sample
+    uint32_t sampleCount = 0;
 };
 
 #endif // SOUNDCHUNK_H
@@ -0,0 +1,98 @@
+#include "commandline.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <cstring>
+#include <cstdio>
+
+#include "util/ddblayoutexport.h"
+#include "util/memoryreport.h"
+#include "parser/ddi.h"
+
+namespace {
+    const char* const BatchOptions[] = { "--export-layout", "--memory-report" };
+
+    int Fail(const QString &message)
+    {
+        fprintf(stderr, "%s\n", qPrintable(message));
+        return 1;
+    }
+
+    int ExportLayout(const QString &ddiPath, const QString &outputPath)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        DdbLayoutExport layout;
+        if (!layout.collect(ddiPath)) {
+            return Fail(layout.getError());
+        }
+        layout.sort();
+        bool written = outputPath.endsWith(".ddbl") ? layout.writeBinary(outputPath) : layout.writeCsv(outputPath);
+        if (!written) {
+            return Fail(layout.getError());
+        }
+        printf("%d units, %d records written to %s in %lld ms\n", (int)layout.units().size(), (int)layout.records().size(),
+               qPrintable(outputPath), (long long)timer.elapsed());
+        return 0;
+    }
+
+    // Of the DDI tree alone, the DDB tree and view caches only exist in the viewer
+    int ReportMemory(const QString &ddiPath)
+    {
+        QString error;
+        BaseChunk* root = ParseDdi(ddiPath, error);
+        if (!root) {
+            return Fail(error);
+        }
+        if (!error.isEmpty()) {
+            fprintf(stderr, "Partial tree, %s\n", qPrintable(error));
+        }
+
+        MemoryReport report;
+        report.addTree(root);
+        printf("%s", qPrintable(report.text()));
+        delete root;
+        return 0;
+    }
+}
+
+bool CommandLine::IsBatch(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        for (auto option : BatchOptions) {
+            if (!strncmp(argv[i], option, strlen(option))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int CommandLine::Run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Vocaloid DDI/DDB viewer, batch mode");
+    parser.addHelpOption();
+    parser.addPositionalArgument("ddi", "DDI file to read");
+    QCommandLineOption exportLayout("export-layout",
+                                    "Write the DDB layout referenced by the DDI to <file>, binary if it ends in .ddbl, CSV otherwise",
+                                    "file");
+    parser.addOption(exportLayout);
+    QCommandLineOption memoryReport("memory-report", "Print the bytes the DDI tree takes in memory, by category");
+    parser.addOption(memoryReport);
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() != 1) {
+        return Fail("Expected exactly one DDI\n\n" + parser.helpText());
+    }
+
+    if (parser.isSet(exportLayout)) {
+        return ExportLayout(positional.first(), parser.value(exportLayout));
+    }
+    if (parser.isSet(memoryReport)) {
+        return ReportMemory(positional.first());
+    }
+    return Fail(parser.helpText());
+}
@@ -0,0 +1,15 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QStringList>
+
+// Batch jobs run without a window, reading the DDI as events rather than
+// building its tree where they can
+namespace CommandLine {
+    // Whether the arguments ask for a batch job instead of the viewer
+    bool IsBatch(int argc, char *argv[]);
+    // Runs it, returns the process exit code
+    int Run(const QStringList &arguments);
+}
+
+#endif // COMMANDLINE_H
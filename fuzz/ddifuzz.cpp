@@ -0,0 +1,30 @@
+// libFuzzer entry point: arbitrary bytes read as a DDI inside a ChunkReadScope,
+// the way ParseDdi reads a file
+#include <cstdint>
+#include <cstdio>
+
+#include "chunk/chunkcreator.h"
+#include "chunk/chunkreaderguards.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    FILE* file = tmpfile();
+    if (!file) {
+        return 0;
+    }
+    if (fwrite(data, 1, size, file) != size) {
+        fclose(file);
+        return 0;
+    }
+    rewind(file);
+
+    BaseChunk::DevDb = false;
+    BaseChunk* chunk;
+    {
+        ChunkReadScope scope(file, "fuzz input");
+        chunk = ChunkCreator::Get()->ReadFor("DBSe", file);
+    }
+    fclose(file);
+    delete chunk;
+    return 0;
+}
@@ -2,9 +2,16 @@
 
 #include <QApplication>
 #include "chunk/basechunk.h"
+#include "commandline.h"
 
 int main(int argc, char *argv[])
 {
+    // Batch jobs need no display, so no QApplication either
+    if (CommandLine::IsBatch(argc, argv)) {
+        QCoreApplication a(argc, argv);
+        return CommandLine::Run(a.arguments());
+    }
+
     QApplication a(argc, argv);
 
     MainWindow w;
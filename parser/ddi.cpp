@@ -1,32 +1,78 @@
 #include "ddi.h"
 #include "chunk/chunkcreator.h"
+#include "chunk/chunkreaderguards.h"
+#include "util/perftrace.h"
 #include <stdio.h>
 #include <QMessageBox>
 
 BaseChunk* ParseDdi(QString path)
 {
+    QString error;
+    BaseChunk* chunk = ParseDdi(path, error);
+    if(!chunk) {
+        QMessageBox::critical(nullptr, "error opening file", "DDI parser failed to open file");
+        return nullptr;
+    }
+
+    // What was read up to the error is still worth looking at
+    if(!error.isEmpty())
+        QMessageBox::warning(nullptr, "DDI is damaged",
+                             "Reading stopped early, the tree shows what could be read.\n\n" + error);
+
+    return chunk;
+}
+
+BaseChunk* ParseDdi(QString path, QString& error)
+{
+    PERF_SCOPE("Parse DDI");
     FILE *file = fopen(path.toLocal8Bit(), "rb");
     if(!file) {
-        QMessageBox::critical(nullptr, "error opening file", "DDI parser failed to open file");
+        error = "Cannot open " + path;
         return nullptr;
     }
 
     // Detect Development DB tree file
     BaseChunk::DevDb = path.endsWith(".tree");
 
-    // Read signature first
-    fpos_t pos;
-    char signatureBuf[4];
-    fgetpos(file, &pos);
-    // Skip Leading QWORD if needed
-    if(BaseChunk::HasLeadingQword) myfseek64(file, 8, SEEK_CUR);
-    fread(signatureBuf, 1, 4, file);
-    fsetpos(file, &pos);
+    BaseChunk* chunk;
+    {
+        ChunkReadScope scope(file, path);
+        chunk = ChunkCreator::Get()->ReadFor("DBSe", file);
+        error = scope.Error();
+    }
+    fclose(file);
+    return chunk;
+}
 
-    auto sig = QByteArray(signatureBuf, 4);
-    auto chunk = ChunkCreator::Get()->ReadFor("DBSe", file);
+bool ParseDdiEvents(QString path, ChunkVisitor* visitor, QString& error)
+{
+    PERF_SCOPE("Parse DDI events");
+    // Development part readers look back at their children, they need the tree
+    if(path.endsWith(".tree")) {
+        error = "Development trees can only be read as a whole";
+        return false;
+    }
+    FILE *file = fopen(path.toLocal8Bit(), "rb");
+    if(!file) {
+        error = "Cannot open " + path;
+        return false;
+    }
+    BaseChunk::DevDb = false;
 
+    BaseChunk* chunk;
+    {
+        VisitorGuard vg(visitor);
+        ChunkReadScope scope(file, path);
+        chunk = ChunkCreator::Get()->ReadFor("DBSe", file);
+        error = scope.Error();
+    }
     fclose(file);
 
-    return chunk;
+    if(!chunk) {
+        if(error.isEmpty())
+            error = path + " is not a DDI";
+        return false;
+    }
+    delete chunk;
+    return error.isEmpty();
 }
@@ -4,6 +4,13 @@
 #include <QTreeWidget>
 #include "chunk/basechunk.h"
 
+class ChunkVisitor;
+
 BaseChunk* ParseDdi(QString path);
+// Without message boxes: nullptr if the file cannot be opened, the tree read
+// up to the first damage otherwise, with error set
+BaseChunk* ParseDdi(QString path, QString& error);
+// Reads the DDI into visitor without building its tree
+bool ParseDdiEvents(QString path, ChunkVisitor* visitor, QString& error);
 
 #endif // DDI_H
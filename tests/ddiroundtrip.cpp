@@ -0,0 +1,239 @@
+// Round trips DDIs through DdiWriter. A synthetic bank is always checked:
+// written back unedited it has to come out identical, and with one field
+// grown the field and every chunk length around it have to match a bank
+// generated that way. A real DDI given on the command line is checked
+// unedited as well
+#include <QCoreApplication>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <cstdio>
+
+#include "parser/ddi.h"
+#include "util/ddiwriter.h"
+
+namespace {
+    int Fail(const QString &message)
+    {
+        fprintf(stderr, "%s\n", qPrintable(message));
+        return 1;
+    }
+
+    // Builds chunks front to back, a chunk's length is filled in when it ends
+    class FixtureWriter
+    {
+    public:
+        void u32(quint32 value) {
+            char bytes[4];
+            qToLittleEndian<quint32>(value, bytes);
+            mBytes.append(bytes, 4);
+        }
+        void raw(const QByteArray &data) { mBytes.append(data); }
+        void name(const QByteArray &name) { u32(name.size()); raw(name); }
+
+        void begin(const char *signature, bool leadingQword = true) {
+            if (leadingQword) {
+                raw(QByteArray(8, 0));
+            }
+            raw(QByteArray(signature, 4));
+            mOpen.append(mBytes.size());
+            u32(0);
+        }
+        // The length counts from the signature
+        void end() {
+            const int at = mOpen.takeLast();
+            qToLittleEndian<quint32>(mBytes.size() - (at - 4), mBytes.data() + at);
+            mLengths.append(at);
+        }
+
+        int size() const { return mBytes.size(); }
+        const QByteArray &bytes() const { return mBytes; }
+        const QVector<int> &lengths() const { return mLengths; }
+
+    private:
+        QByteArray mBytes;
+        QVector<int> mOpen;
+        QVector<int> mLengths;
+    };
+
+    struct Fixture {
+        QByteArray bytes;
+        QVector<int> lengths;   // Offsets of every chunk length field
+        int innerFlags;         // Offset of ArrayFlags of the inner array
+    };
+
+    // DBSe holding an empty phoneme dictionary, an array nested in an array
+    // and a chunk no reader knows, which ends the array and is only copied
+    Fixture MakeFixture(const QByteArray &innerFlags)
+    {
+        Fixture fixture;
+        FixtureWriter w;
+        w.begin("DBSe");
+        w.u32(0);                       // ArrayFlags
+        w.u32(0);                       // UseEmptyChunk
+        w.u32(2);                       // Version
+
+        w.begin("PHDC", false);
+        w.u32(0);                       // Flags, no phoneme groups
+        w.u32(0);                       // Phoneme count
+        w.u32(0);                       // EpR guide count
+        w.end();
+        w.raw(QByteArray(260, 0x5A));   // HashStore
+
+        w.u32(2);                       // Count
+        w.begin("ARR ");
+        w.u32(0);
+        w.u32(0);
+        w.u32(1);
+        w.begin("ARR ");
+        fixture.innerFlags = w.size();
+        w.raw(innerFlags);
+        w.u32(0);
+        w.u32(1);
+        w.begin("EMPT");
+        w.name("leaf");
+        w.end();
+        w.name("inner");
+        w.end();
+        w.name("outer");
+        w.end();
+
+        w.begin("XXXX");
+        w.raw("unknown payload!");
+        w.end();
+        w.end();
+
+        fixture.bytes = w.bytes();
+        fixture.lengths = w.lengths();
+        return fixture;
+    }
+
+    bool WriteFile(const QString &path, const QByteArray &bytes)
+    {
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly) && file.write(bytes) == bytes.size();
+    }
+
+    QByteArray ReadFile(const QString &path)
+    {
+        QFile file(path);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+    // Written back unedited, the file has to come out byte for byte
+    int CheckUnedited(BaseChunk *root, const QString &path, const QString &target)
+    {
+        DdiWriter writer(root);
+        if (!writer.write(path, target)) {
+            return Fail(writer.getError());
+        }
+        qint64 difference;
+        QString error;
+        if (!DdiWriter::Compare(path, target, difference, error)) {
+            return Fail(error);
+        }
+        if (difference >= 0) {
+            return Fail(QString("Written DDI first differs from %1 at 0x%2").arg(path).arg(difference, 0, 16));
+        }
+        printf("%s: %d spans, %llu bytes identical\n", qPrintable(path), writer.spanCount(),
+               (unsigned long long)writer.outputSize());
+        return 0;
+    }
+
+    int CheckSynthetic(const QString &directory)
+    {
+        const QByteArray flags("\x01\x00\x00\x00", 4);
+        const QByteArray grownFlags("\x01\x00\x00\x00\xEE\xEE\xEE\xEE", 8);
+        const Fixture source = MakeFixture(flags);
+        const Fixture expected = MakeFixture(grownFlags);
+
+        const QString path = directory + "/synthetic.ddi";
+        const QString target = directory + "/synthetic_out.ddi";
+        if (!WriteFile(path, source.bytes)) {
+            return Fail("Cannot write " + path);
+        }
+
+        QString error;
+        BaseChunk *root = ParseDdi(path, error);
+        if (!root || !error.isEmpty()) {
+            delete root;
+            return Fail("Synthetic DDI does not parse: " + error);
+        }
+        BaseChunk *outer = root->GetChildBySignature("ARR ");
+        BaseChunk *inner = outer ? outer->GetChildBySignature("ARR ") : nullptr;
+        if (!inner || inner->GetName() != "inner" || !inner->GetChildBySignature("EMPT")) {
+            delete root;
+            return Fail("Synthetic DDI parsed into the wrong tree");
+        }
+
+        int result = CheckUnedited(root, path, target);
+        if (result) {
+            delete root;
+            return result;
+        }
+
+        // Grow a field of the inner array, its length and those of the outer
+        // array and DBSe have to follow
+        ChunkProperty prop = inner->GetProperty("ArrayFlags");
+        prop.data = grownFlags;
+        inner->SetProperty("ArrayFlags", prop);
+        DdiWriter writer(root);
+        const bool written = writer.write(path, target);
+        delete root;
+        if (!written) {
+            return Fail(writer.getError());
+        }
+
+        const QByteArray out = ReadFile(target);
+        if (out.mid(expected.innerFlags, grownFlags.size()) != grownFlags) {
+            return Fail(QString("Edited field at 0x%1 was not written").arg(expected.innerFlags, 0, 16));
+        }
+        foreach (int at, expected.lengths) {
+            const quint32 want = qFromLittleEndian<quint32>(expected.bytes.constData() + at);
+            const quint32 got = at + 4 <= out.size() ? qFromLittleEndian<quint32>(out.constData() + at) : 0;
+            if (got != want) {
+                return Fail(QString("Chunk length at 0x%1 is %2, expected %3").arg(at, 0, 16).arg(got).arg(want));
+            }
+        }
+        if (writer.resizedChunks() != 3) {
+            return Fail(QString("%1 chunk lengths updated, expected 3").arg(writer.resizedChunks()));
+        }
+        if (out != expected.bytes) {
+            return Fail("Edited synthetic DDI differs from the expected bytes");
+        }
+        printf("Synthetic DDI: edit grew %d enclosing chunks\n", writer.resizedChunks());
+        return 0;
+    }
+
+    int CheckExternal(const QString &path, const QString &directory)
+    {
+        QString error;
+        BaseChunk *root = ParseDdi(path, error);
+        if (!root) {
+            return Fail(error);
+        }
+        if (!error.isEmpty()) {
+            delete root;
+            return Fail("Partial tree, " + error);
+        }
+        const int result = CheckUnedited(root, path, directory + "/external_out.ddi");
+        delete root;
+        return result;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTemporaryDir directory;
+    if (!directory.isValid()) {
+        return Fail("Cannot create a temporary directory");
+    }
+
+    int result = CheckSynthetic(directory.path());
+    // DDIVIEW_TEST_DDI, empty unless a real bank is configured
+    if (!result && argc > 1 && argv[1][0]) {
+        result = CheckExternal(QString::fromLocal8Bit(argv[1]), directory.path());
+    }
+    return result;
+}
@@ -0,0 +1,343 @@
+#include "ddbmapview.h"
+#include "util/ddbmap.h"
+#include "uicommon.h"
+
+#include <QPainter>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QToolTip>
+#include <QtConcurrent>
+#include <cmath>
+
+namespace {
+    // Inside the map but past the end of the file
+    const QRgb PastEnd = qRgb(24, 24, 24);
+
+    QRgb KindColor(DdbMapSpan::Kind kind)
+    {
+        switch (kind) {
+        case DdbMapSpan::Sound: return qRgb(70, 130, 230);
+        case DdbMapSpan::Frame: return qRgb(80, 190, 100);
+        case DdbMapSpan::OtherChunk: return qRgb(230, 200, 60);
+        case DdbMapSpan::Orphan: return qRgb(220, 60, 60);
+        case DdbMapSpan::Gap: return qRgb(110, 110, 110);
+        }
+        return PastEnd;
+    }
+
+    // Distance along the Hilbert curve filling an n * n square, n a power of two
+    quint64 HilbertIndex(quint32 n, quint32 x, quint32 y)
+    {
+        quint64 d = 0;
+        for (quint32 s = n / 2; s > 0; s /= 2) {
+            quint32 rx = (x & s) ? 1 : 0;
+            quint32 ry = (y & s) ? 1 : 0;
+            d += (quint64)s * s * ((3 * rx) ^ ry);
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = n - 1 - x;
+                    y = n - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+}
+
+DdbMapView::DdbMapView(QWidget *parent) :
+    QWidget(parent),
+    mColorByGroup(false),
+    mBaseBytesPerPixel(1),
+    mMaxLevel(0),
+    mGeneration(0),
+    mTiles(256),
+    mViewX(0.0),
+    mViewY(0.0),
+    mViewSize(1.0),
+    mDragging(false),
+    mDragViewX(0.0),
+    mDragViewY(0.0)
+{
+    setMinimumSize(256, 256);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMouseTracking(true);
+}
+
+DdbMapView::~DdbMapView()
+{
+    // Tiles still queued for us are dropped along with this object
+    for (auto &worker : mWorkers) {
+        worker.waitForFinished();
+    }
+}
+
+void DdbMapView::SetMap(QSharedPointer<const DdbMap> map)
+{
+    mMap = map;
+
+    // Level 0 holds the whole file, each level below splits its pixels in four
+    mBaseBytesPerPixel = 1;
+    mMaxLevel = 0;
+    const quint64 basePixels = (quint64)BaseSize * BaseSize;
+    while (mMap && mBaseBytesPerPixel * basePixels < mMap->fileSize()) {
+        mBaseBytesPerPixel *= 4;
+        mMaxLevel++;
+    }
+
+    mViewX = mViewY = 0.0;
+    mViewSize = 1.0;
+    UpdateColors();
+}
+
+void DdbMapView::SetColorByGroup(bool byGroup)
+{
+    mColorByGroup = byGroup;
+    UpdateColors();
+}
+
+void DdbMapView::UpdateColors()
+{
+    auto colors = QSharedPointer<QVector<QRgb>>::create();
+    if (mMap) {
+        const auto &spans = mMap->spans();
+        colors->resize(spans.size());
+        for (int i = 0; i < spans.size(); i++) {
+            const auto &span = spans[i];
+            int group = mMap->ownerGroup(span.owner);
+            if (!mColorByGroup || group < 0 || (span.kind != DdbMapSpan::Sound && span.kind != DdbMapSpan::Frame)) {
+                (*colors)[i] = KindColor(span.kind);
+                continue;
+            }
+            // Golden ratio steps keep neighbouring groups apart, frames darker than sounds
+            double hue = std::fmod(group * 0.618033988749895, 1.0);
+            (*colors)[i] = span.kind == DdbMapSpan::Sound ? QColor::fromHsvF(hue, 0.75, 0.95).rgb()
+                                                          : QColor::fromHsvF(hue, 0.55, 0.6).rgb();
+        }
+    }
+    mColors = colors;
+
+    mGeneration++;
+    mTiles.clear();
+    mPending.clear();
+    update();
+}
+
+quint64 DdbMapView::TileKey(int level, int tileX, int tileY)
+{
+    return (quint64)level << 56 | (quint64)tileX << 28 | (quint64)tileY;
+}
+
+DdbMapView::Tile DdbMapView::RenderTile(QSharedPointer<const DdbMap> map, QSharedPointer<const QVector<QRgb>> colors,
+                                        quint64 bytesPerPixel, int level, int tileX, int tileY)
+{
+    Tile tile;
+    tile.key = TileKey(level, tileX, tileY);
+    tile.image = QImage(TileSize, TileSize, QImage::Format_RGB32);
+
+    const quint32 n = (quint32)BaseSize << level;
+    for (int y = 0; y < TileSize; y++) {
+        QRgb *line = (QRgb *)tile.image.scanLine(y);
+        for (int x = 0; x < TileSize; x++) {
+            quint64 offset = HilbertIndex(n, tileX * TileSize + x, tileY * TileSize + y) * bytesPerPixel;
+            int span = offset < map->fileSize() ? map->find(offset) : -1;
+            line[x] = span < 0 || span >= colors->size() ? PastEnd : (*colors)[span];
+        }
+    }
+    return tile;
+}
+
+void DdbMapView::RequestTile(int level, int tileX, int tileY)
+{
+    const quint64 key = TileKey(level, tileX, tileY);
+    if (mPending.contains(key)) {
+        return;
+    }
+    mPending.insert(key);
+
+    // Forget the workers that are done
+    for (int i = mWorkers.size() - 1; i >= 0; i--) {
+        if (mWorkers[i].isFinished()) {
+            mWorkers.remove(i);
+        }
+    }
+
+    auto map = mMap;
+    auto colors = mColors;
+    const quint64 bytesPerPixel = BytesPerPixel(level);
+    const int generation = mGeneration;
+    mWorkers.append(QtConcurrent::run([this, map, colors, bytesPerPixel, level, tileX, tileY, generation]() {
+        Tile tile = RenderTile(map, colors, bytesPerPixel, level, tileX, tileY);
+        tile.generation = generation;
+        QMetaObject::invokeMethod(this, [this, tile]() { OnTileReady(tile); }, Qt::QueuedConnection);
+    }));
+}
+
+void DdbMapView::OnTileReady(const Tile &tile)
+{
+    if (tile.generation != mGeneration) {
+        // Rendered with colours or a map that are gone
+        return;
+    }
+    mPending.remove(tile.key);
+    mTiles.insert(tile.key, new QImage(tile.image));
+    update();
+}
+
+void DdbMapView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    if (!mMap || mMap->spans().isEmpty()) {
+        painter.setPen(Qt::gray);
+        painter.drawText(rect(), Qt::AlignCenter, tr("Empty DDB"));
+        return;
+    }
+
+    // Finest level whose pixels are still no smaller than the screen's
+    const double scale = qMin(width(), height()) / mViewSize;
+    int level = 0;
+    while (level < mMaxLevel && (BaseSize << level) < scale) {
+        level++;
+    }
+
+    const int tilesPerSide = (BaseSize << level) / TileSize;
+    const double tileUnits = 1.0 / tilesPerSide;
+    const int firstX = qMax(0, (int)std::floor(mViewX / tileUnits));
+    const int firstY = qMax(0, (int)std::floor(mViewY / tileUnits));
+    const int lastX = qMin(tilesPerSide - 1, (int)std::floor((mViewX + width() / scale) / tileUnits));
+    const int lastY = qMin(tilesPerSide - 1, (int)std::floor((mViewY + height() / scale) / tileUnits));
+
+    for (int ty = firstY; ty <= lastY; ty++) {
+        for (int tx = firstX; tx <= lastX; tx++) {
+            QRectF target((tx * tileUnits - mViewX) * scale, (ty * tileUnits - mViewY) * scale,
+                          tileUnits * scale, tileUnits * scale);
+            if (QImage *image = mTiles.object(TileKey(level, tx, ty))) {
+                painter.drawImage(target, *image);
+                continue;
+            }
+            RequestTile(level, tx, ty);
+
+            // Meanwhile blow up the part of a coarser tile we already have
+            for (int coarser = level - 1; coarser >= 0; coarser--) {
+                const int shift = level - coarser;
+                QImage *image = mTiles.object(TileKey(coarser, tx >> shift, ty >> shift));
+                if (!image) {
+                    continue;
+                }
+                const double part = (double)TileSize / (1 << shift);
+                QRectF source((tx & ((1 << shift) - 1)) * part, (ty & ((1 << shift) - 1)) * part, part, part);
+                painter.drawImage(target, *image, source);
+                break;
+            }
+        }
+    }
+
+    painter.setPen(Qt::white);
+    painter.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop,
+                     tr("%1 MB, level %2, %3 bytes per pixel")
+                         .arg(mMap->fileSize() / 1048576.0, 0, 'f', 1).arg(level).arg(BytesPerPixel(level)));
+
+    if (!mColorByGroup) {
+        const DdbMapSpan::Kind kinds[] = { DdbMapSpan::Sound, DdbMapSpan::Frame, DdbMapSpan::OtherChunk,
+                                           DdbMapSpan::Orphan, DdbMapSpan::Gap };
+        int x = 4;
+        const int y = height() - 16;
+        for (auto kind : kinds) {
+            painter.fillRect(x, y, 10, 10, QColor(KindColor(kind)));
+            QString name = DdbMap::KindName(kind);
+            painter.drawText(x + 14, y + 10, name);
+            x += 24 + painter.fontMetrics().horizontalAdvance(name);
+        }
+    }
+}
+
+bool DdbMapView::OffsetAt(const QPointF &pos, quint64 &offset) const
+{
+    if (!mMap) {
+        return false;
+    }
+    const double scale = qMin(width(), height()) / mViewSize;
+    const double x = mViewX + pos.x() / scale, y = mViewY + pos.y() / scale;
+    if (x < 0.0 || y < 0.0 || x >= 1.0 || y >= 1.0) {
+        return false;
+    }
+    const quint32 n = (quint32)BaseSize << mMaxLevel;
+    offset = HilbertIndex(n, (quint32)(x * n), (quint32)(y * n)) * BytesPerPixel(mMaxLevel);
+    return offset < mMap->fileSize();
+}
+
+void DdbMapView::wheelEvent(QWheelEvent *event)
+{
+    if (!mMap || event->angleDelta().y() == 0) {
+        return;
+    }
+
+    // Keep the point under the cursor in place
+    const double scale = qMin(width(), height()) / mViewSize;
+    const double anchorX = mViewX + UiCommon::EventPosition(event).x() / scale;
+    const double anchorY = mViewY + UiCommon::EventPosition(event).y() / scale;
+    mViewSize *= event->angleDelta().y() > 0 ? 0.8 : 1.25;
+    ClampView();
+    const double newScale = qMin(width(), height()) / mViewSize;
+    mViewX = anchorX - UiCommon::EventPosition(event).x() / newScale;
+    mViewY = anchorY - UiCommon::EventPosition(event).y() / newScale;
+    ClampView();
+    update();
+}
+
+void DdbMapView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        mDragging = true;
+        mDragOrigin = UiCommon::EventPosition(event);
+        mDragViewX = mViewX;
+        mDragViewY = mViewY;
+    }
+}
+
+void DdbMapView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (mDragging) {
+        const double scale = qMin(width(), height()) / mViewSize;
+        mViewX = mDragViewX - (UiCommon::EventPosition(event).x() - mDragOrigin.x()) / scale;
+        mViewY = mDragViewY - (UiCommon::EventPosition(event).y() - mDragOrigin.y()) / scale;
+        ClampView();
+        update();
+        return;
+    }
+
+    quint64 offset;
+    int span = OffsetAt(UiCommon::EventPosition(event), offset) ? mMap->find(offset) : -1;
+    if (span < 0) {
+        QToolTip::hideText();
+        return;
+    }
+    const auto &info = mMap->spans()[span];
+    QString text = tr("0x%1\n%2 at 0x%3, %4 bytes")
+                       .arg(offset, 0, 16)
+                       .arg(DdbMap::KindName(info.kind))
+                       .arg(info.offset, 0, 16)
+                       .arg(info.size);
+    if (info.owner >= 0) {
+        text += "\n" + mMap->owners()[info.owner];
+    }
+    QToolTip::showText(UiCommon::EventGlobalPosition(event), text, this);
+}
+
+void DdbMapView::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        mDragging = false;
+    }
+}
+
+void DdbMapView::ClampView()
+{
+    // Zoom in until a pixel of the finest level is 8 screen pixels wide, out until the map fits
+    const double finest = 8.0 * ((quint64)BaseSize << mMaxLevel) / qMax(1, qMin(width(), height()));
+    mViewSize = qBound(1.0 / finest, mViewSize, 1.0);
+    mViewX = qBound(-mViewSize / 2, mViewX, 1.0 - mViewSize / 2);
+    mViewY = qBound(-mViewSize / 2, mViewY, 1.0 - mViewSize / 2);
+}
@@ -0,0 +1,79 @@
+#ifndef DDBMAPVIEW_H
+#define DDBMAPVIEW_H
+
+#include <QWidget>
+#include <QImage>
+#include <QCache>
+#include <QSet>
+#include <QVector>
+#include <QFuture>
+#include <QSharedPointer>
+
+class DdbMap;
+
+// Whole DDB address space as a square occupancy map. Bytes are laid along a
+// Hilbert curve, so each on-screen block is a contiguous byte range and every
+// zoom level refines the one above it: a pixel of level n covers the four
+// pixels of level n + 1. Tiles are rendered on demand by pool threads and
+// cached; until one arrives, the closest coarser tile is scaled up instead.
+// Wheel zooms around the cursor, dragging pans, hovering names the chunk.
+class DdbMapView : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit DdbMapView(QWidget *parent = nullptr);
+    ~DdbMapView();
+
+    void SetMap(QSharedPointer<const DdbMap> map);
+    // Colour chunks by voice colour / leading phoneme instead of by kind
+    void SetColorByGroup(bool byGroup);
+
+    static constexpr int TileSize = 256;
+    static constexpr int BaseSize = 1024;   // Level 0 is BaseSize pixels across
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    struct Tile {
+        int generation;
+        quint64 key;
+        QImage image;
+    };
+
+    static Tile RenderTile(QSharedPointer<const DdbMap> map, QSharedPointer<const QVector<QRgb>> colors,
+                           quint64 bytesPerPixel, int level, int tileX, int tileY);
+    static quint64 TileKey(int level, int tileX, int tileY);
+
+    void RequestTile(int level, int tileX, int tileY);
+    void OnTileReady(const Tile &tile);
+    void UpdateColors();
+    void ClampView();
+    quint64 BytesPerPixel(int level) const { return mBaseBytesPerPixel >> (2 * level); }
+    // Byte under a widget position, false outside of the file
+    bool OffsetAt(const QPointF &pos, quint64 &offset) const;
+
+private:
+    QSharedPointer<const DdbMap> mMap;
+    QSharedPointer<const QVector<QRgb>> mColors;   // Per span
+    bool mColorByGroup;
+    quint64 mBaseBytesPerPixel;
+    int mMaxLevel;
+
+    int mGeneration;
+    QCache<quint64, QImage> mTiles;
+    QSet<quint64> mPending;
+    QVector<QFuture<void>> mWorkers;
+
+    // Visible area in map units, the map being the unit square
+    double mViewX, mViewY, mViewSize;
+    bool mDragging;
+    QPointF mDragOrigin;
+    double mDragViewX, mDragViewY;
+};
+
+#endif // DDBMAPVIEW_H
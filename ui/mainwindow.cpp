@@ -4,10 +4,18 @@
 #include <QFileDialog>
 #include <QProgressDialog>
 #include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
 #include <QInputDialog>
 #include <QTableWidget>
+#include <QHeaderView>
+#include <QPushButton>
 #include <QMessageBox>
+#include <QComboBox>
 #include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 #include "chunk/chunkreaderguards.h"
 #include "mainwindow.h"
 #include "chunk/chunkcreator.h"
@@ -16,6 +24,7 @@
 #include "chunk/dbvstationaryphupart_devdb.h"
 #include "chunk/dbvarticulationphu_devdb.h"
 #include "chunk/dbvarticulationphupart_devdb.h"
+#include "chunk/item_audioframerefs.h"
 #include "parser/ddi.h"
 #include "./ui_mainwindow.h"
 #include "qdebug.h"
@@ -25,6 +34,22 @@
 #include "vqmgeneratordialog.h"
 #include "propertycontextmenu.h"
 #include "util/smsgenerator.h"
+#include "util/vqmbatch.h"
+#include "util/smsframeview.h"
+#include "util/smsresynth.h"
+#include "util/devdbpacker.h"
+#include "util/devdbchecker.h"
+#include "util/ddbverifier.h"
+#include "util/ddbcompactor.h"
+#include "util/ddblayoutoptimizer.h"
+#include "util/ddblayoutexport.h"
+#include "util/ddbmap.h"
+#include "ddbmapview.h"
+#include "util/ddidiff.h"
+#include "util/ddiwriter.h"
+#include "util/ddipatcher.h"
+#include "util/perftrace.h"
+#include "util/memoryreport.h"
 #include "common.h"
 #include "util/util.h"
 
@@ -38,10 +63,12 @@ MainWindow::MainWindow(QWidget *parent)
     SetupUI();
 
     mTreeRoot = nullptr;
+    mPatcher = nullptr;
 }
 
 MainWindow::~MainWindow()
 {
+    delete mPatcher;
     delete ui;
 }
 
@@ -68,6 +95,12 @@ void MainWindow::SetupUI()
     mWaveformPlot->yAxis->setRange(-1.0, 1.0);
     mWaveformGraph = new QCPGraph(mWaveformPlot->xAxis, mWaveformPlot->yAxis);
 
+    auto pageSpecLay = new QVBoxLayout;
+    ui->pageSpectrogram->setLayout(pageSpecLay);
+    pageSpecLay->addWidget((mSpectrogramView = new SpectrogramView));
+    mSelectedSampleRate = 0;
+    mSelectedPart = nullptr;
+
     resize(1000, 800);
 }
 
@@ -94,6 +127,7 @@ void MainWindow::BuildTree(BaseChunk *chunk, QTreeWidgetItem *into)
 
 void MainWindow::BuildDdb(QProgressDialog *dlg)
 {
+    PERF_SCOPE("Build DDB tree");
     FILE* f = fopen(mDdbPath.toLocal8Bit(), "rb");
     if (!f) {
         return;
@@ -149,6 +183,7 @@ void MainWindow::BuildDdb(QProgressDialog *dlg)
 
     // DDI -> DDB Linkage
     auto procPitch = [=](BaseChunk* pitch, QTreeWidgetItem* treeParent){
+        PERF_SCOPE("Link DDB pitch");
         auto phPitch = new QTreeWidgetItem(treeParent, {pitch->GetName()});
 
         auto phSnd = new QTreeWidgetItem(phPitch, {tr("Sound")});
@@ -170,29 +205,25 @@ void MainWindow::BuildDdb(QProgressDialog *dlg)
             }
         }
 
-        auto frames = pitch->GetChildByName("<Frames>");
+        auto frames = dynamic_cast<ItemAudioFrameRefs*>(pitch->GetChildByName("<Frames>"));
         if (!frames) return;
 
 #if 0
-        auto &&propMap = frames->GetPropertiesMap();
-        for (auto it = propMap.begin(); it != propMap.end(); it++) {
-            if (it.key() == "Count") continue;
-            if (it->type == PropHex64) {
-                auto frame = new QTreeWidgetItem(phPitch);
-                uint64_t offset;
-                STUFF_INTO(it->data, offset, uint64_t);
-                auto foundChunk = mDdbChunks.lower_bound(offset);
-                if (foundChunk->second->GetOriginalOffset() == offset && foundChunk->second->ObjectSignature() == "FRM2") {
-                    // Must exactly match
-                    frame->setText(0, it.key());
-                    frame->setText(1, QString::number(offset, 16));
-                    frame->setData(0, BaseChunk::ItemChunkRole, QVariant::fromValue<BaseChunk*>(foundChunk->second));
-                    mDdbChunks.erase(foundChunk);
-                } else {
-                    qDebug() << "FRM2 Look for:" << QString::number(offset, 16) << "Found:"
-                             << QString::number(foundChunk->second->GetOriginalOffset(), 16)
-                             << "Signature" << QString(foundChunk->second->GetSignature());
-                }
+        const auto &offsets = frames->Offsets();
+        for (int i = 0; i < offsets.size(); i++) {
+            auto frame = new QTreeWidgetItem(phPitch);
+            uint64_t offset = offsets[i];
+            auto foundChunk = mDdbChunks.lower_bound(offset);
+            if (foundChunk->second->GetOriginalOffset() == offset && foundChunk->second->ObjectSignature() == "FRM2") {
+                // Must exactly match
+                frame->setText(0, QString("Frame %1").arg(i, 5, 10, QChar('0')));
+                frame->setText(1, QString::number(offset, 16));
+                frame->setData(0, BaseChunk::ItemChunkRole, QVariant::fromValue<BaseChunk*>(foundChunk->second));
+                mDdbChunks.erase(foundChunk);
+            } else {
+                qDebug() << "FRM2 Look for:" << QString::number(offset, 16) << "Found:"
+                         << QString::number(foundChunk->second->GetOriginalOffset(), 16)
+                         << "Signature" << QString(foundChunk->second->GetSignature());
             }
         }
 #endif
@@ -243,6 +274,10 @@ void MainWindow::BuildDdb(QProgressDialog *dlg)
         chunkDdb->setData(0, BaseChunk::ItemChunkRole, QVariant::fromValue<BaseChunk*>(it->second));
     }
 #endif
+    // No item refers to the rest, nothing would free them later
+    for (auto it = mDdbChunks.begin(); it != mDdbChunks.end(); it++) {
+        delete it->second;
+    }
     mDdbChunks.clear();
 
     fclose(f);
@@ -411,12 +446,38 @@ void MainWindow::on_actionOpen_triggered()
             QDir::currentPath(),
             "Daisy Database Index (*.ddi);;Development VB Index (*.tree)");
 
-    if(filename.isEmpty())
+    if(filename.isEmpty() || !DiscardFieldEdits())
+        return;
+
+    // A field save cut short leaves its journal behind, put the old bytes back
+    bool recovered;
+    QString recoverError;
+    if (!DdiPatcher::Recover(filename, recovered, recoverError)) {
+        QMessageBox::critical(this, tr("Cannot restore field edits"), recoverError);
         return;
+    }
+    if (recovered) {
+        QMessageBox::information(this, tr("Field edits rolled back"),
+                                 tr("Saving field edits to %1 did not finish, the fields have been restored").arg(filename));
+    }
+
+    PERF_SCOPE("Open DDI");
+
+    // Edits point into the tree deleted below
+    delete mPatcher;
+    mPatcher = nullptr;
 
     if(ui->treeStructure->topLevelItemCount())
         delete ui->treeStructure->topLevelItem(0)->data(0, BaseChunk::ItemChunkRole).value<BaseChunk*>();
 
+    // The selected sound belonged to that tree
+    mSelectedPart = nullptr;
+    mSelectedPcm.clear();
+    mWaveformGraph->data()->clear();
+    mWaveformPlot->clearItems();
+    mWaveformPlot->replot();
+    mSpectrogramView->Clear(tr("Select a sound in the DDB tree"));
+
     // FIXME: If the signal is connected when doing clear, the clear method will deadlock.
     disconnect(ui->treeStructure, &QTreeWidget::currentItemChanged, this, &MainWindow::on_treeStructure_currentItemChanged);
     ui->treeStructure->clear();
@@ -442,7 +503,11 @@ void MainWindow::on_actionOpen_triggered()
     ChunkCreator::Get()->SetProgressDialog(nullptr);
 
     mTreeRoot = root;
-    BuildTree(root, nullptr);
+    mPatcher = new DdiPatcher(filename);
+    {
+        PERF_SCOPE("Build tree view");
+        BuildTree(root, nullptr);
+    }
 
     if (EnsureDdbExists()) {
         // DDB read. DDB is not cached to RAM because it is very large, data is read on demand
@@ -459,20 +524,22 @@ void MainWindow::on_treeStructure_currentItemChanged(QTreeWidgetItem *current, Q
         return;
 
     auto chunk = current->data(0, BaseChunk::ItemChunkRole).value<BaseChunk*>();
-    auto props = chunk->GetPropertiesMap();
+    auto props = chunk->GetDisplayProperties();
     auto styleHints = qApp->styleHints();
 
     ui->listProperties->clear();
-    for(auto i = props.cbegin(); i != props.cend(); i++) {
+    foreach(auto key, chunk->OrderedKeys(props)) {
+        const auto &prop = props[key];
         QString propText;
-        propText += i.key() + tr(" (%1 bytes)\n").arg(i.value().data.size())
-                  + FormatProperty(i.value());
+        propText += key + tr(" (%1 bytes)\n").arg(prop.data.size())
+                  + FormatProperty(prop);
         auto item = new QListWidgetItem(propText);
-        item->setData(BaseChunk::ItemPropDataRole, i.value().data);
-        item->setData(BaseChunk::ItemOffsetRole, i.value().offset);
+        item->setData(BaseChunk::ItemPropDataRole, prop.data);
+        item->setData(BaseChunk::ItemOffsetRole, prop.offset);
+        item->setData(BaseChunk::ItemPropNameRole, key);
 
         // Make those "known values" (with proper typing) a bit more eye catching
-        if(i.value().type != PropRawHex) {
+        if(prop.type != PropRawHex) {
             if (styleHints->colorScheme() == Qt::ColorScheme::Light)
                 item->setBackground(QColor(200, 255, 200));
             else
@@ -493,7 +560,8 @@ void MainWindow::on_listProperties_customContextMenuRequested(QPoint point)
 
     PropertyContextMenu menu(this, item);
     auto globPoint = ui->listProperties->mapToGlobal(point);
-    menu.exec(globPoint);
+    if(menu.exec(globPoint) == menu.EditAction())
+        EditProperty(item);
 }
 
 
@@ -521,7 +589,7 @@ void MainWindow::on_actionPropDist_triggered()
     auto iterfunc = [](void *ctx, BaseChunk *chunk, QString propName){
         PropDistIterCtx *_ctx = reinterpret_cast<PropDistIterCtx*>(ctx);
 
-        auto propMap = chunk->GetPropertiesMap();
+        auto propMap = chunk->GetDisplayProperties();
         if(propMap.contains(propName)) {
             _ctx->statistics[propMap[propName]]++;
         } else {
@@ -629,6 +697,7 @@ void MainWindow::on_actionExportJson_triggered()
     DdiExportJsonOptionsDialog cfgDlg;
     if(cfgDlg.exec() == QDialog::DialogCode::Rejected)
         return;
+    PERF_SCOPE("Export JSON");
 
     auto sanitizeString = [](QString s) -> QString {
         QString ret; QChar prev = '\0';
@@ -662,24 +731,26 @@ void MainWindow::on_actionExportJson_triggered()
         outputIndent(stream, indentLevel);
         *stream << "\"signature\":\"" << chunk->ObjectSignature() << "\"";
         // Properties
-        auto propMap = chunk->GetPropertiesMap();
+        auto propMap = chunk->GetDisplayProperties();
         if(!propMap.isEmpty()) {
             *stream << ",";
             outputIndent(stream, indentLevel);
             *stream << "\"properties\":{";
             indentLevel++;
-            for(auto i = propMap.begin(); i != propMap.end(); ) {
+            auto keys = chunk->OrderedKeys(propMap);
+            for(auto i = keys.cbegin(); i != keys.cend(); ) {
+                const auto &prop = propMap[*i];
                 outputIndent(stream, indentLevel);
                 if(doVerbatimPropValue) {
-                    *stream << '\"' << i.key()
-                            << "\":[" << i.value().type << ",\""
-                            << i.value().data.toHex() << "\"]";
+                    *stream << '\"' << *i
+                            << "\":[" << prop.type << ",\""
+                            << prop.data.toHex() << "\"]";
                 } else {
-                    *stream << '\"' << i.key()
+                    *stream << '\"' << *i
                             <<"\":\""
-                            << FormatProperty(i.value()) << "\"";
+                            << FormatProperty(prop) << "\"";
                 }
-                if(++i != propMap.end()) {
+                if(++i != keys.cend()) {
                     *stream << ',';
                 } else {
                     indentLevel--;
@@ -769,6 +840,7 @@ void MainWindow::on_actionExtractAllSamples_triggered()
                               tr("Cannot create subdirectory for \"%1\".").arg(mLblStatusFilename->text()));
         return;
     }
+    PERF_SCOPE("Extract samples");
 
     // Build task list
     struct Section {
@@ -1040,160 +1112,38 @@ void MainWindow::on_actionExtractAllSamples_triggered()
 
 void MainWindow::on_actionactionExportDdbLayout_triggered()
 {
-    QMap<uint64_t, QString> layout;
+    QElapsedTimer timer;
+    timer.start();
 
     setCursor(Qt::WaitCursor);
-    // Iterate stationaries
-    auto stationaryRoot = SearchForChunkByPath({ "voice", "stationary" });
-    do {
-        if(!stationaryRoot) break;
-        // Iterate voice colors
-        foreach(auto voiceColor, stationaryRoot->Children) {
-            // Iterate stationary segments
-            foreach(auto staSeg, voiceColor->Children) {
-                // Iterate each pitch of the segment
-                foreach(auto pitchSeg, staSeg->Children) {
-                    auto frameRefs = pitchSeg->GetChildByName("<Frames>");
-                    auto &props = frameRefs->GetPropertiesMap();
-                    float pitch;
-                    STUFF_INTO(pitchSeg->GetProperty("mPitch").data, pitch, float);
-                    QString pitchStr = Common::RelativePitchToNoteName(pitch);
-                    for (auto it = props.cbegin(); it != props.cend(); it++) {
-                        if (it.key() == "Count") continue;
-                        uint64_t addr;
-                        STUFF_INTO(it.value().data, addr, uint64_t);
-                        layout[addr] = QString("Stationary %1 > %2 (%3) @ %4 %5").arg(
-                                        voiceColor->GetName(),
-                                        staSeg->GetName(),
-                                        pitchSeg->GetName(),
-                                        pitchStr,
-                                        it.key()
-                                    );
-                    }
-
-                    // SND
-                    uint64_t addr;
-                    STUFF_INTO(pitchSeg->GetProperty("SND Sample offset").data, addr, uint64_t);
-                    layout[addr] = QString("Stationary %1 > %2 (%3) @ %4 Sound").arg(
-                                voiceColor->GetName(),
-                                staSeg->GetName(),
-                                pitchSeg->GetName(),
-                                pitchStr
-                            );
-                }
-            }
-        }
-    } while(0);
-
-    // Iterate articulations
-    auto articulationRoot = SearchForChunkByPath({ "voice", "articulation" });
-    do {
-        if(!articulationRoot) break;
-        // Iterate beginPhonemes
-        foreach(auto beginPhoneme, articulationRoot->Children) {
-            // Iterate end phonemes
-            foreach(auto endPhoneme, beginPhoneme->Children) {
-                // Triphonemes
-                if(endPhoneme->ObjectSignature() == "ART ") {
-                    foreach(auto thirdPhoneme, endPhoneme->Children) {
-                        foreach(auto pitchSeg, thirdPhoneme->Children) {
-                            auto frameRefs = pitchSeg->GetChildByName("<Frames>");
-                            auto &props = frameRefs->GetPropertiesMap();
-                            float pitch;
-                            STUFF_INTO(pitchSeg->GetProperty("mPitch").data, pitch, float);
-                            QString pitchStr = Common::RelativePitchToNoteName(pitch);
-                            for (auto it = props.cbegin(); it != props.cend(); it++) {
-                                if (it.key() == "Count") continue;
-                                uint64_t addr;
-                                STUFF_INTO(it.value().data, addr, uint64_t);
-                                layout[addr] = QString("Triphone Articulation %1 > %2 @ %3 %4").arg(
-                                                pitchSeg->GetName(),
-                                                QString("[%1 ~ %2 ~ %3]").arg(
-                                                    beginPhoneme->GetName(),
-                                                    endPhoneme->GetName(),
-                                                    thirdPhoneme->GetName()),
-                                                pitchStr,
-                                                it.key()
-                                            );
-                            }
-
-                            // SND
-                            uint64_t addr;
-                            STUFF_INTO(pitchSeg->GetProperty("SND Sample offset").data, addr, uint64_t);
-                            layout[addr] = QString("Triphone Articulation %1 > %2 @ %3 Sound").arg(
-                                            pitchSeg->GetName(),
-                                            QString("[%1 ~ %2 ~ %3]").arg(
-                                                beginPhoneme->GetName(),
-                                                endPhoneme->GetName(),
-                                                thirdPhoneme->GetName()),
-                                            pitchStr
-                                        );
-                        }
-                    }
-                    continue;
-                }
-
-                // Iterate each pitch of the segment
-                foreach(auto pitchSeg, endPhoneme->Children) {
-                    auto frameRefs = pitchSeg->GetChildByName("<Frames>");
-                    auto &props = frameRefs->GetPropertiesMap();
-                    float pitch;
-                    STUFF_INTO(pitchSeg->GetProperty("mPitch").data, pitch, float);
-                    QString pitchStr = Common::RelativePitchToNoteName(pitch);
-                    for (auto it = props.cbegin(); it != props.cend(); it++) {
-                        if (it.key() == "Count") continue;
-                        uint64_t addr;
-                        STUFF_INTO(it.value().data, addr, uint64_t);
-                        layout[addr] = QString("Articulation %1 > %2 @ %3 %4").arg(
-                                        pitchSeg->GetName(),
-                                        QString("[%1 ~ %2]").arg(beginPhoneme->GetName(), endPhoneme->GetName()),
-                                        pitchStr,
-                                        it.key()
-                                    );
-                    }
-
-                    // SND
-                    uint64_t addr;
-                    STUFF_INTO(pitchSeg->GetProperty("SND Sample offset").data, addr, uint64_t);
-                    layout[addr] = QString("Articulation %1 > %2 @ %3 Sound").arg(
-                                    pitchSeg->GetName(),
-                                    QString("[%1 ~ %2]").arg(beginPhoneme->GetName(), endPhoneme->GetName()),
-                                    pitchStr
-                                );
-                }
-            }
-        }
-    } while(0);
+    DdbLayoutExport layout;
+    layout.collect(SearchForChunkByPath({ "voice", "stationary" }), SearchForChunkByPath({ "voice", "articulation" }));
+    layout.sort();
     setCursor(Qt::ArrowCursor);
+    qint64 collectMs = timer.elapsed();
 
-    // Export as CSV
-    QFileDialog filedlg;
-    QString filename;
-
-    filename = filedlg.getSaveFileName(
-            this,
-            tr("Save CSV..."),
-            QDir::currentPath(),
-            "Comma separated values (*.csv)");
-
+    const QString csvFilter = "Comma separated values (*.csv)", binaryFilter = "Binary layout (*.ddbl)";
+    QString selectedFilter;
+    QString filename = QFileDialog::getSaveFileName(this, tr("Save DDB Layout..."), QDir::currentPath(),
+                                                    csvFilter + ";;" + binaryFilter, &selectedFilter);
     if(filename.isEmpty())
         return;
 
-    QFile file(filename);
-    file.open(QFile::WriteOnly);
-    if(!file.isWritable()) {
-        QMessageBox::critical(this, tr("Failed to export DDB Layout"), tr("File is not writable"));
+    timer.restart();
+    setCursor(Qt::WaitCursor);
+    bool binary = selectedFilter == binaryFilter || filename.endsWith(".ddbl", Qt::CaseInsensitive);
+    bool written = binary ? layout.writeBinary(filename) : layout.writeCsv(filename);
+    setCursor(Qt::ArrowCursor);
+    if (!written) {
+        QMessageBox::critical(this, tr("Failed to export DDB Layout"), layout.getError());
         return;
     }
 
-    QTextStream stream(&file);
-
-    for (auto it = layout.cbegin(); it != layout.cend(); it++) {
-        QString val = it.value();
-        stream << '\'' << QString::number(it.key(), 16) << "," << val.replace(QLatin1String(","), QLatin1String("\\,")) << ",\n";
-    }
-
-    QMessageBox::information(this, tr("Export finished"), tr("A total of %1 records exported.").arg(layout.size()));
+    QMessageBox::information(this, tr("Export finished"),
+                             tr("A total of %1 records of %2 units exported.\n"
+                                "Collected and sorted in %3 ms, written in %4 ms.")
+                                 .arg(layout.records().size()).arg(layout.units().size())
+                                 .arg(collectMs).arg(timer.elapsed()));
 }
 
 
@@ -1204,173 +1154,18 @@ void MainWindow::on_actionPack_DevDB_triggered()
         return;
     }
 
-    // Sanity check the filesystem structure
     const QString devDbFsRoot = mDdiPath.section('.', 0, -2) + '/';
-    size_t idx = 0;
-    QProgressDialog progDlg(QString(),
-                            QString(),
-                            0,
-                            1,
-                            this);
-    progDlg.setWindowModality(Qt::WindowModal);
-    progDlg.setMinimumDuration(0);
-    progDlg.setAutoReset(false);
-    progDlg.setMaximum(0);
-    progDlg.setValue(0);
-    progDlg.setWindowTitle(tr("Sanity check on filesystem"));
-    progDlg.show();
-
-    if (QMessageBox::question(this, "Check DB", "Do you wish to check for DB consistency before packing?") == QMessageBox::Yes)
-    {
-        LeadingQwordGuard qwg(false);
-        // Stationaries
-        auto stationaryRoot = SearchForChunkByPath({ "voice", "stationary" });
-
-        // Iterate voice colors
-        foreach(auto voiceColor, stationaryRoot->Children) {
-            // Iterate stationary segments
-            foreach(auto staSeg, voiceColor->Children) {
-                // Iterate each pitch of the segment
-                foreach(auto pitchSeg, staSeg->Children) {
-                    QString targetFile = devDbFsRoot
-                                         + QString("voice/stationary/%1/%2/%3")
-                                               .arg(voiceColor->GetName(),
-                                                    Common::devDbDirEncode(staSeg->GetName()),
-                                                    Common::devDbDirEncode(pitchSeg->GetName()));
-                    progDlg.setLabelText(targetFile);
-                    progDlg.setValue(idx++);
-
-                    if (!QFile::exists(targetFile)) {
-                        QMessageBox::critical(this, "Stationary check fail", "Cannot find " + targetFile);
-                        return;
-                    }
-
-                    FILE* f = fopen(targetFile.toLatin1(), "rb");
-                    if (!f) {
-                        QMessageBox::warning(this, "Cannot open " + targetFile, QString("Error %1").arg(errno));
-                        continue;
-                    }
-                    auto STAp = new ChunkDBVStationaryPhUPart_DevDB;
-                    STAp->Read(f);
-                    fclose(f);
-                    if (STAp->GetProperty("Frame count").data != pitchSeg->GetProperty("Frame count").data) {
-                        QMessageBox::critical(this, "Stationary check fail", staSeg->GetName() + " frame count mismatch");
-                        delete STAp;
-                        return;
-                    }
-                    delete STAp;
-                }
-            }
-        }
-
-        // Articulation
-        auto articulationRoot = SearchForChunkByPath({ "voice", "articulation" });        // Iterate beginPhonemes
-        foreach(auto beginPhoneme, articulationRoot->Children) {
-            // Iterate end phonemes
-            foreach(auto endPhoneme, beginPhoneme->Children) {
-                // Triphonemes
-                if(endPhoneme->ObjectSignature() == "ART ") {
-                    foreach(auto thirdPhoneme, endPhoneme->Children) {
-                        QString targetFile = devDbFsRoot
-                                             + QString("voice/articulation/%1/%2/%3")
-                                                   .arg(Common::devDbDirEncode(beginPhoneme->GetName()),
-                                                        Common::devDbDirEncode(endPhoneme->GetName()),
-                                                        Common::devDbDirEncode(thirdPhoneme->GetName()));
-                        progDlg.setLabelText(targetFile);
-                        progDlg.setValue(idx++);
-
-                        if (!QFile::exists(targetFile) && !QFile::exists(targetFile += ".part")) {
-                            QMessageBox::critical(this, "Articulation triphoneme check fail", "Cannot find " + targetFile);
-                            return;
-                        }
-
-                        FILE* f = fopen(targetFile.toLatin1(), "rb");
-                        if (!f) {
-                            QMessageBox::warning(this, "Cannot open " + targetFile, QString("Error %1").arg(errno));
-                            continue;
-                        }
-                        auto ARTu = new ChunkDBVArticulationPhU_DevDB;
-                        ARTu->Read(f);
-                        fclose(f);
-
-                        for(auto pitch = 0; pitch < thirdPhoneme->Children.size(); pitch++) {
-                            auto pitchSeg = thirdPhoneme->Children[pitch];
-
-                            if (ARTu->Children[pitch]->GetProperty("Frame count").data != pitchSeg->GetProperty("Frame count").data) {
-                                QMessageBox::critical(this,
-                                                      "Articulation triphoneme check fail",
-                                                      QString("%1-%2-%3 %4 frame count mismatch")
-                                                          .arg(beginPhoneme->GetName(),
-                                                               endPhoneme->GetName(),
-                                                               thirdPhoneme->GetName(),
-                                                               QString::number(pitch)));
-                                delete ARTu;
-                                return;
-                            }
-                        }
-
-                        delete ARTu;
-                    }
-                    continue;
-                }
-
-                QString targetFile = devDbFsRoot
-                                     + QString("voice/articulation/%1/%2")
-                                           .arg(Common::devDbDirEncode(beginPhoneme->GetName()),
-                                                Common::devDbDirEncode(endPhoneme->GetName()));
-                progDlg.setLabelText(targetFile);
-                progDlg.setValue(idx++);
-
-                if (!QFile::exists(targetFile) && !QFile::exists(targetFile += ".part")) {
-                    QMessageBox::critical(this, "Articulation check fail", "Cannot find " + targetFile);
-                    return;
-                }
-
-                FILE* f = fopen(targetFile.toLatin1(), "rb");
-                if (!f) {
-                    QMessageBox::warning(this, "Cannot open " + targetFile, QString("Error %1").arg(errno));
-                    continue;
-                }
-                auto ARTu = new ChunkDBVArticulationPhU_DevDB;
-                ARTu->Read(f);
-                fclose(f);
-
-                // Iterate each pitch of the segment
-                if (ARTu->Children.count() != endPhoneme->Children.count()) {
-                    QMessageBox::critical(this,
-                                          "Articulation check fail",
-                                          QString("%1-%2 inconsistent sample count (Tree %3 Item %4)")
-                                              .arg(beginPhoneme->GetName(),
-                                                   endPhoneme->GetName())
-                                              .arg(endPhoneme->Children.count())
-                                              .arg(ARTu->Children.count())
-                                          );
-                    delete ARTu;
-                    return;
-                }
-
-                for(auto pitch = 0; pitch < endPhoneme->Children.size(); pitch++) {
-                    auto pitchSeg = endPhoneme->Children[pitch];
-
-                    if (ARTu->Children[pitch]->GetProperty("Frame count").data != pitchSeg->GetProperty("Frame count").data) {
-                        QMessageBox::critical(this,
-                                              "Articulation check fail",
-                                              QString("%1-%2 %3 frame count mismatch")
-                                                  .arg(beginPhoneme->GetName(),
-                                                       endPhoneme->GetName(),
-                                                       QString::number(pitch)));
-                        delete ARTu;
-                        return;
-                    }
-                }
-
-                delete ARTu;
-            }
-        }
-
-        QMessageBox::information(this, "Consistency check pass", "All required files exists and DB index tree is consistent.");
+    DevDbPacker packer(devDbFsRoot);
+    if (!packer.addStationaries(SearchForChunkByPath({ "voice", "stationary" })) ||
+        !packer.addArticulations(SearchForChunkByPath({ "voice", "articulation" }))) {
+        QMessageBox::critical(this, "Cannot pack DB", packer.getError());
+        return;
     }
 
+    if (QMessageBox::question(this, "Check DB", "Do you wish to check for DB consistency before packing?") == QMessageBox::Yes &&
+        !CheckDevDb(packer.units())) {
+        return;
+    }
 
     QFileDialog filedlg;
     QString outputDir;
@@ -1392,330 +1187,799 @@ void MainWindow::on_actionPack_DevDB_triggered()
             return;
         }
     }
-    if (!QFile::copy(mDdiPath, targetFile)) {
-        QMessageBox::critical(this, "Cannot copy file", "Cannot copy database tree to " + targetFile);
-        return;
-    }
-
-    if (!ddi.open(QFile::ReadWrite)) {
+    // Streamed from the tree once the DDB is written
+    if (!ddi.open(QFile::WriteOnly)) {
         QMessageBox::critical(this, "Cannot write file", "Cannot open target DDI " + targetFile);
         return;
     }
 
     QFile ddb(targetFile.section('.', 0, -2) + ".ddb");
+
+    // A previous pack of the same tree lets unchanged units be copied from its DDB
+    const QString manifestPath = ddb.fileName() + ".manifest.json";
+    const QByteArray treeHash = DevDbPackManifest::hashFile(mDdiPath);
+    DevDbPackManifest previousManifest;
+    QFile previousDdb(ddb.fileName() + ".prev");
+    bool incremental = false;
+    if (ddb.exists() && previousManifest.load(manifestPath) &&
+        previousManifest.treeHash == treeHash && previousManifest.ddbSize == (quint64)ddb.size() &&
+        QMessageBox::question(this, "Incremental pack", "A previous pack of this tree was found.\n"
+                                                        "Only repack the units changed since then?") == QMessageBox::Yes) {
+        previousDdb.remove();
+        if (!QFile::rename(ddb.fileName(), previousDdb.fileName()) || !previousDdb.open(QFile::ReadOnly)) {
+            QMessageBox::critical(this, "Cannot write file", "Cannot move " + ddb.fileName() + " aside");
+            return;
+        }
+        incremental = true;
+    }
+    // Put the previous DDB back if packing does not get through
+    auto restorePrevious = [&]() {
+        if (!incremental)
+            return;
+        previousDdb.close();
+        ddb.close();
+        ddb.remove();
+        QFile::rename(previousDdb.fileName(), ddb.fileName());
+    };
+
     if (ddb.exists() &&
         QMessageBox::question(this, "DDB Exists", ddb.fileName() + " exists. Delete it?") == QMessageBox::Yes) {
         ddb.remove();
     }
     if (!ddb.open(QFile::ReadWrite)) {
         QMessageBox::critical(this, "Cannot write file", "Cannot open target DDB " + targetFile);
+        restorePrevious();
         return;
     }
 
-    progDlg.reset();
+    QProgressDialog progDlg(QString(),
+                            QString(),
+                            0,
+                            packer.units().size(),
+                            this);
+    progDlg.setWindowModality(Qt::WindowModal);
+    progDlg.setMinimumDuration(0);
+    progDlg.setAutoReset(false);
     progDlg.setWindowTitle("Pack DB");
-    progDlg.setMaximum(idx);
-    idx = 0;
+    int reusedUnits = 0;
     {
-        LeadingQwordGuard qwg(false);
-        // Writer convenience function
-        auto writeOffset = [&](size_t writeToOffset, size_t offset) -> QByteArray {
-            auto ddiPtr = QByteArray((const char*)&offset, sizeof(offset));
-            ddi.seek(writeToOffset);
-            ddi.write(ddiPtr);
-            return ddiPtr;
-        };
-        auto write32 = [&](size_t writeToOffset, uint32_t data) -> QByteArray {
-            auto ddiPtr = QByteArray((const char*)&data, sizeof(data));
-            ddi.seek(writeToOffset);
-            ddi.write(ddiPtr);
-            return ddiPtr;
-        };
-
-        auto writeBlock = [&](QByteArray content, size_t ddiOffset, int offsetOffset = 0) -> size_t {
-            auto offset = ddb.pos();
-            ddb.write(content);
-            writeOffset(ddiOffset, offset + offsetOffset);
-            return offset;
-        };
-
-        // Stationaries
-        auto stationaryRoot = SearchForChunkByPath({ "voice", "stationary" });
+        if (incremental)
+            packer.setPrevious(&previousManifest, &previousDdb);
+        bool packed = packer.pack(ddb, [&](int unitIndex, const QString &path) {
+            progDlg.setLabelText(path);
+            progDlg.setValue(unitIndex);
+            return !progDlg.wasCanceled();
+        });
+        if (!packer.warnings().isEmpty()) {
+            QStringList shown = packer.warnings().mid(0, 20);
+            if (packer.warnings().size() > shown.size())
+                shown.append(QString("... and %1 more").arg(packer.warnings().size() - shown.size()));
+            QMessageBox::warning(this, "Pack DB", shown.join('\n'));
+        }
+        // Hash is after PHDC, find its end
+        auto phdc = SearchForChunkByPath({ "<Phoneme Dictionary>" }); assert(phdc);
+        if (!packed || !packer.writeDdi(mDdiPath, ddi, phdc->GetOriginalOffset() + phdc->GetSize())) {
+            QMessageBox::critical(this, "Pack DB failed", packer.getError());
+            restorePrevious();
+            return;
+        }
+        reusedUnits = packer.reusedCount();
 
-        // Iterate voice colors
-        foreach(auto voiceColor, stationaryRoot->Children) {
-            // Iterate stationary segments
-            foreach(auto staSeg, voiceColor->Children) {
-                // Iterate each pitch of the segment
-                foreach(auto pitchSeg, staSeg->Children) {
-                    QString targetFile = devDbFsRoot
-                                         + QString("voice/stationary/%1/%2/%3")
-                                               .arg(voiceColor->GetName(),
-                                                    Common::devDbDirEncode(staSeg->GetName()),
-                                                    Common::devDbDirEncode(pitchSeg->GetName()));
-                    progDlg.setLabelText(targetFile);
-                    progDlg.setValue(idx++);
-
-                    if (!QFile::exists(targetFile)) {
-                        QMessageBox::critical(this, "Stationary check fail", "Cannot find " + targetFile);
-                        return;
-                    }
+        auto manifest = packer.manifest(treeHash);
+        if (!manifest.save(manifestPath)) {
+            QMessageBox::warning(this, "Pack DB", manifest.getError() + "\nThe next pack will be a full one.");
+        }
+        if (incremental) {
+            previousDdb.close();
+            previousDdb.remove();
+        }
 
-                    FILE* f = fopen(targetFile.toLatin1(), "rb");
-                    if (!f) {
-                        QMessageBox::warning(this, "Cannot open " + targetFile, QString("Error %1").arg(errno));
-                        continue;
-                    }
-                    auto STAp = new ChunkDBVStationaryPhUPart_DevDB;
-                    STAp->Read(f);
-                    fclose(f);
-
-                    // Write SMS Frames
-                    auto framesDir = pitchSeg->GetChildByName("<Frames>"); assert(framesDir);
-                    auto framesProps = framesDir->GetPropertiesMap(); framesProps.remove("Count");
-                    foreach (auto i, framesProps) {
-                        auto frame = STAp->framesToWrite.takeFirst(); assert(frame->ObjectSignature() == "FRM2");
-                        writeBlock(((ChunkSMSFrameChunk*)frame)->rawData, i.offset);
-                    }
-                    float relPitch; STUFF_INTO(STAp->GetProperty("mPitch").data, relPitch, float);
-                    qDebug() << staSeg->GetName() << Common::RelativePitchToNoteName(relPitch);
-                    // Write sound chunk
-                    {
-                        auto snd = (ChunkSoundChunk*)(STAp->GetChildBySignature("SND "));
-                        if (!snd) {
-                            QMessageBox::warning(this, "Missing SND", "Cannot find SND chunk in " + targetFile);
-                            delete STAp;
-                            continue;
-                        }
-                        // Use dynamic samplePerFrame like ARTp does
-                        double samplePerFrame = (double)snd->sampleCount / (double)STAp->allFramesCount;
-                        // playbackStart should be consistent with ARTp (no +1)
-                        int64_t playbackStart = samplePerFrame * STAp->skipFrameCount;
-                        int64_t sndFrom = std::max(0LL, (int64_t)(playbackStart - 0x400));
-                        int64_t sndTo = std::min((int64_t)snd->sampleCount, (int64_t)(playbackStart + samplePerFrame * STAp->frameCount + 0x400));
-                        // Recalculate after clamping
-                        int64_t actualSampleCount = sndTo - sndFrom;
-                        int64_t paddingBefore = playbackStart - sndFrom;  // samples before playback start
-                        int64_t samplesAfterPlayback = sndTo - playbackStart;  // samples from playback start to end
-
-                        // Check for edge cases that might cause noise
-                        if (paddingBefore < 0x400 || samplesAfterPlayback < samplePerFrame * STAp->frameCount + 0x400) {
-                            qWarning() << "STAp EDGE CASE:" << STAp->GetName()
-                                       << "paddingBefore:" << paddingBefore << "(expected 1024)"
-                                       << "samplesAfterPlayback:" << samplesAfterPlayback;
-                        }
+        ddi.close();
+        ddb.close();
+    }
 
-                        auto truncatedChunk = snd->GetTruncatedChunk(sndFrom, sndTo);
-                        // Write SND chunk to DDB
-                        // For STAp, only one offset field exists - it should point to playback start
-                        // The engine adds 2*sampleIndex to this offset, so sample 0 reads from here
-                        auto sndOffset = writeBlock(truncatedChunk,
-                                   pitchSeg->GetProperty("SND Sample offset").offset, 0x12 + paddingBefore * 2);
-                        // Sample count is samples available from playback start (for boundary checking)
-                        // Since offset_440 falls back to offset_448, boundary_end = offset_448 + 2*sampleCount
-                        write32(pitchSeg->GetProperty("SND Sample count").offset, samplesAfterPlayback);
-                    }
+    QMessageBox::information(this, "Packing done", ddi.fileName() + '\n' + ddb.fileName() +
+                             (incremental ? QString("\n%1 unchanged units reused").arg(reusedUnits) : QString()));
+}
 
-                    delete STAp;
-                }
-            }
+
+bool MainWindow::CheckDevDb(const QVector<DevDbUnit> &units)
+{
+    QVector<DevDbCheckJob> jobs(units.size());
+    for (int i = 0; i < units.size(); i++) {
+        jobs[i].unit = &units[i];
+    }
+
+    // Header only parses, one part file per pool thread
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+
+    QProgressDialog progDlg(tr("Checking %1 DevDB units...").arg(jobs.size()), tr("Cancel"), 0, jobs.size(), this);
+    progDlg.setWindowModality(Qt::WindowModal);
+    progDlg.setMinimumDuration(0);
+    progDlg.setWindowTitle(tr("Check DB"));
+
+    QFutureWatcher<void> watcher;
+    connect(&watcher, &QFutureWatcher<void>::finished, &progDlg, &QProgressDialog::reset);
+    connect(&progDlg, &QProgressDialog::canceled, &watcher, &QFutureWatcher<void>::cancel);
+    connect(&watcher, &QFutureWatcher<void>::progressRangeChanged, &progDlg, &QProgressDialog::setRange);
+    connect(&watcher, &QFutureWatcher<void>::progressValueChanged, &progDlg, &QProgressDialog::setValue);
+    watcher.setFuture(QtConcurrent::map(jobs, &DevDbChecker::check));
+    progDlg.exec();
+    watcher.waitForFinished();
+
+    qint64 wallMs = wallTimer.elapsed();
+    if (watcher.isCanceled()) {
+        return false;
+    }
+
+    QString reportPath = mDdiPath.section('.', 0, -2) + "_check.json";
+    bool reportWritten = DevDbChecker::writeReport(reportPath, mDdiPath, jobs, wallMs);
+
+    QStringList lines;
+    int issueCount = 0;
+    for (const auto &job : jobs) {
+        for (const auto &issue : job.issues) {
+            if (issueCount++ < 20)
+                lines.append(DevDbChecker::describe(job, issue));
         }
+    }
 
-        // Articulation
-        auto articulationRoot = SearchForChunkByPath({ "voice", "articulation" });        // Iterate beginPhonemes
-        foreach(auto beginPhoneme, articulationRoot->Children) {
-            // Iterate end phonemes
-            foreach(auto endPhoneme, beginPhoneme->Children) {
-                // Triphonemes
-                if(endPhoneme->ObjectSignature() == "ART ") {
-                    foreach(auto thirdPhoneme, endPhoneme->Children) {
-                        QString targetFile = devDbFsRoot
-                                             + QString("voice/articulation/%1/%2/%3")
-                                                   .arg(Common::devDbDirEncode(beginPhoneme->GetName()),
-                                                        Common::devDbDirEncode(endPhoneme->GetName()),
-                                                        Common::devDbDirEncode(thirdPhoneme->GetName()));
-                        progDlg.setLabelText(targetFile);
-                        progDlg.setValue(idx++);
-
-                        if (!QFile::exists(targetFile) && !QFile::exists(targetFile += ".part")) {
-                            QMessageBox::critical(this, "Articulation triphoneme check fail", "Cannot find " + targetFile);
-                            return;
-                        }
+    if (issueCount == 0) {
+        QMessageBox::information(this, "Consistency check pass",
+                                 tr("All required files exists and DB index tree is consistent.\n"
+                                    "%1 units checked in %2 ms.").arg(jobs.size()).arg(wallMs));
+        return true;
+    }
 
-                        FILE* f = fopen(targetFile.toLatin1(), "rb");
-                        if (!f) {
-                            QMessageBox::warning(this, "Cannot open " + targetFile, QString("Error %1").arg(errno));
-                            continue;
-                        }
-                        auto ARTu = new ChunkDBVArticulationPhU_DevDB;
-                        ARTu->Read(f);
-                        fclose(f);
-
-                        for(auto pitch = 0; pitch < thirdPhoneme->Children.size(); pitch++) {
-                            auto pitchSeg = thirdPhoneme->Children[pitch];
-                            auto ARTp = (ChunkDBVArticulationPhUPart_DevDB*)(ARTu->Children[pitch]);
-
-                            // Write SMS Frames
-                            auto framesDir = pitchSeg->GetChildByName("<Frames>"); assert(framesDir);
-                            auto framesProps = framesDir->GetPropertiesMap(); framesProps.remove("Count");
-                            foreach (auto i, framesProps) {
-                                auto frame = ARTp->framesToWrite.takeFirst(); assert(frame->ObjectSignature() == "FRM2");
-                                writeBlock(((ChunkSMSFrameChunk*)frame)->rawData, i.offset);
-                            }
-                            // Write sound chunk
-                            {
-                                auto snd = (ChunkSoundChunk*)(ARTp->GetChildBySignature("SND "));
-                                if (!snd) {
-                                    qWarning() << "Missing SND chunk in ARTp";
-                                    continue;
-                                }
-                                double samplePerFrame = (double)snd->sampleCount / (double)ARTp->allFramesCount;
-                                int64_t playbackStart = samplePerFrame * ARTp->skipFrameCount;
-                                int64_t sndFrom = std::max(0LL, (int64_t)(playbackStart - 0x400));
-                                int64_t sndTo = std::min((int64_t)snd->sampleCount, (int64_t)(playbackStart + samplePerFrame * ARTp->frameCount + 0x400));
-                                int64_t actualSampleCount = sndTo - sndFrom;
-                                int64_t paddingBefore = playbackStart - sndFrom;
-
-                                // Check for edge cases
-                                if (paddingBefore < 0x400) {
-                                    qWarning() << "ARTp triphoneme EDGE CASE: paddingBefore:" << paddingBefore << "(expected 1024)";
-                                }
-
-                                // Write SND chunk to DDB
-                                auto sndOffset = writeBlock(snd->GetTruncatedChunk(sndFrom, sndTo),
-                                               pitchSeg->GetProperty("SND Sample offset").offset, 0x12);
-                                // DDI field order: "SND Sample offset" → offset 440 (boundary), "SND Sample offset+800" → offset 448 (playback)
-                                // So "SND Sample offset" should point to data start (boundary)
-                                // And "SND Sample offset+800" should point to playback start (data start + padding)
-                                writeOffset(pitchSeg->GetProperty("SND Sample offset+800").offset, sndOffset + 0x12 + paddingBefore * 2);
-                                write32(pitchSeg->GetProperty("SND Sample count").offset, actualSampleCount);
-                            }
-                        }
+    if (issueCount > lines.size())
+        lines.append(tr("... and %1 more").arg(issueCount - lines.size()));
+    lines.append(QString());
+    lines.append(reportWritten ? tr("Full report: %1").arg(reportPath)
+                               : tr("Cannot write report to %1").arg(reportPath));
+    QMessageBox::critical(this, "Consistency check fail",
+                          tr("%1 issues in %2 units:\n\n").arg(issueCount).arg(jobs.size()) + lines.join('\n'));
+    return false;
+}
 
-                        delete ARTu;
-                    }
-                    continue;
-                }
+void MainWindow::on_actionCheck_DevDB_triggered()
+{
+    if (!mDdiPath.endsWith(".tree")) {
+        QMessageBox::critical(this, "Cannot check DB", "Consistency check is only intended for development DBs");
+        return;
+    }
 
-                QString targetFile = devDbFsRoot
-                                     + QString("voice/articulation/%1/%2")
-                                           .arg(Common::devDbDirEncode(beginPhoneme->GetName()),
-                                                Common::devDbDirEncode(endPhoneme->GetName()));
-                progDlg.setLabelText(targetFile);
-                progDlg.setValue(idx++);
+    DevDbPacker packer(mDdiPath.section('.', 0, -2) + '/');
+    if (!packer.addStationaries(SearchForChunkByPath({ "voice", "stationary" })) ||
+        !packer.addArticulations(SearchForChunkByPath({ "voice", "articulation" }))) {
+        QMessageBox::critical(this, "Cannot check DB", packer.getError());
+        return;
+    }
+    CheckDevDb(packer.units());
+}
 
-                if (!QFile::exists(targetFile) && !QFile::exists(targetFile += ".part")) {
-                    QMessageBox::critical(this, "Articulation check fail", "Cannot find " + targetFile);
-                    return;
-                }
+void MainWindow::on_actionVerifyDdb_triggered()
+{
+    if (!mTreeRoot || !EnsureDdbExists()) {
+        QMessageBox::critical(this, "Cannot verify DDB", "Open a DDI whose DDB exists first");
+        return;
+    }
 
-                FILE* f = fopen(targetFile.toLatin1(), "rb");
-                if (!f) {
-                    QMessageBox::warning(this, "Cannot open " + targetFile, QString("Error %1").arg(errno));
-                    continue;
-                }
-                auto ARTu = new ChunkDBVArticulationPhU_DevDB;
-                ARTu->Read(f);
-                fclose(f);
+    DdiReferences references;
+    references.collect(mTreeRoot);
 
-                // Iterate each pitch of the segment
-                if (ARTu->Children.count() != endPhoneme->Children.count()) {
-                    QMessageBox::critical(this,
-                                          "Articulation check fail",
-                                          QString("%1-%2 inconsistent sample count (Tree %3 Item %4)")
-                                              .arg(beginPhoneme->GetName(),
-                                                   endPhoneme->GetName())
-                                              .arg(endPhoneme->Children.count())
-                                              .arg(ARTu->Children.count())
-                                          );
-                    delete ARTu;
-                    return;
-                }
+    QProgressDialog progDlg(tr("Verifying %1...").arg(mDdbPath), tr("Cancel"), 0,
+                            QFileInfo(mDdbPath).size() >> 20, this);
+    progDlg.setWindowModality(Qt::WindowModal);
+    progDlg.setMinimumDuration(0);
+    progDlg.setWindowTitle(tr("Verify DDB"));
+
+    DdbVerifier verifier;
+    DdbVerifyResult result;
+    bool verified = verifier.verify(mDdbPath, mTreeRoot->GetProperty("HashStore").data, references, result,
+                                    [&](quint64 done, quint64) {
+        progDlg.setValue(done >> 20);
+        return !progDlg.wasCanceled();
+    });
+    progDlg.reset();
+    if (!verified) {
+        QMessageBox::critical(this, "Cannot verify DDB", verifier.getError());
+        return;
+    }
 
-                for(auto pitch = 0; pitch < endPhoneme->Children.size(); pitch++) {
-                    auto pitchSeg = endPhoneme->Children[pitch];
-                    auto ARTp = (ChunkDBVArticulationPhUPart_DevDB*)(ARTu->Children[pitch]);
+    QString reportPath = mDdbPath + ".verify.json";
+    bool reportWritten = DdbVerifier::writeReport(reportPath, mDdbPath, result, references);
+
+    QString hashLine = result.storedHash.isEmpty()
+            ? tr("No hash stored in the DDI, MD4 is %1").arg(QString(result.actualHash))
+            : result.hashMatches ? tr("MD4 matches HashStore")
+                                 : tr("MD4 mismatch: DDI holds %1, DDB is %2").arg(QString(result.storedHash), QString(result.actualHash));
+    QString summary = tr("%1\n"
+                         "%2 chunks, %3 references, %4 bad\n"
+                         "%5 orphaned bytes in %6 regions\n"
+                         "%7 index issues\n"
+                         "%8 MB in %9 ms\n\n")
+                          .arg(hashLine)
+                          .arg(result.chunkCount).arg(result.referenceCount).arg(result.badReferences.size())
+                          .arg(result.orphanBytes).arg(result.orphans.size())
+                          .arg(result.indexIssues.size())
+                          .arg(result.ddbSize >> 20).arg(result.elapsedMs)
+                      + (reportWritten ? tr("Full report: %1").arg(reportPath)
+                                       : tr("Cannot write report to %1").arg(reportPath));
+
+    bool clean = (result.hashMatches || result.storedHash.isEmpty()) && result.badReferences.isEmpty() &&
+                 result.orphans.isEmpty() && result.indexIssues.isEmpty();
+    if (clean)
+        QMessageBox::information(this, "DDB verified", summary);
+    else
+        QMessageBox::warning(this, "DDB verification found issues", summary);
+}
 
-                    // Write SMS Frames
-                    auto framesDir = pitchSeg->GetChildByName("<Frames>"); assert(framesDir);
-                    auto framesProps = framesDir->GetPropertiesMap(); framesProps.remove("Count");
-                    foreach (auto i, framesProps) {
-                        auto frame = ARTp->framesToWrite.takeFirst(); assert(frame->ObjectSignature() == "FRM2");
-                        writeBlock(((ChunkSMSFrameChunk*)frame)->rawData, i.offset);
-                    }
-                    // Write sound chunk
-                    {
-                        auto snd = (ChunkSoundChunk*)(ARTp->GetChildBySignature("SND "));
-                        if (!snd) {
-                            qWarning() << "Missing SND chunk in ARTp";
-                            continue;
-                        }
-                        double samplePerFrame = (double)snd->sampleCount / (double)ARTp->allFramesCount;
-                        int64_t playbackStart = samplePerFrame * ARTp->skipFrameCount;
-                        int64_t sndFrom = std::max(0LL, (int64_t)(playbackStart - 0x400));
-                        int64_t sndTo = std::min((int64_t)snd->sampleCount, (int64_t)(playbackStart + samplePerFrame * ARTp->frameCount + 0x400));
-                        int64_t actualSampleCount = sndTo - sndFrom;
-                        int64_t paddingBefore = playbackStart - sndFrom;
-
-                        // Check for edge cases
-                        if (paddingBefore < 0x400) {
-                            qWarning() << "ARTp diphoneme EDGE CASE: paddingBefore:" << paddingBefore << "(expected 1024)";
-                        }
+bool MainWindow::CompactDdb(DdbCompactor& compactor, const QString& title, QString& outputDir)
+{
+    outputDir = QFileDialog::getExistingDirectory(this, tr("Choose destination of the new DDI and DDB"),
+                                                  QFileInfo(mDdiPath).absolutePath(),
+                                                  QFileDialog::ShowDirsOnly);
+    if (outputDir.isEmpty()) {
+        return false;
+    }
+    if (QDir(outputDir) == QFileInfo(mDdiPath).absoluteDir() || QDir(outputDir) == QFileInfo(mDdbPath).absoluteDir()) {
+        QMessageBox::critical(this, title, "Choose a directory other than the one of the DDI and DDB");
+        return false;
+    }
+    QString outDdiPath = outputDir + "/" + QFileInfo(mDdiPath).fileName();
+    QString outDdbPath = outputDir + "/" + QFileInfo(mDdbPath).fileName();
 
-                        // Write SND chunk to DDB
-                        auto sndOffset = writeBlock(snd->GetTruncatedChunk(sndFrom, sndTo),
-                                       pitchSeg->GetProperty("SND Sample offset").offset, 0x12);
-                        // DDI field order: "SND Sample offset" → offset 440 (boundary), "SND Sample offset+800" → offset 448 (playback)
-                        writeOffset(pitchSeg->GetProperty("SND Sample offset+800").offset, sndOffset + 0x12 + paddingBefore * 2);
-                        write32(pitchSeg->GetProperty("SND Sample count").offset, actualSampleCount);
-                    }
-                }
+    auto hashStore = mTreeRoot->GetProperty("HashStore");
+    qint64 hashStoreField = hashStore.data.size() == DdbCompactor::HashStoreSize ? (qint64)hashStore.offset : -1;
 
-                delete ARTu;
-            }
-        }
+    QProgressDialog progDlg(tr("Repacking %1...").arg(mDdbPath), tr("Cancel"), 0, 0, this);
+    progDlg.setWindowModality(Qt::WindowModal);
+    progDlg.setMinimumDuration(0);
+    progDlg.setWindowTitle(title);
+
+    bool compacted = compactor.compact(mDdiPath, mDdbPath, hashStoreField, outDdiPath, outDdbPath,
+                                       [&](const QString& step, quint64 done, quint64 total) {
+        progDlg.setLabelText(step);
+        progDlg.setMaximum(total >> 20);
+        progDlg.setValue(done >> 20);
+        return !progDlg.wasCanceled();
+    });
+    progDlg.reset();
+    if (!compacted) {
+        QMessageBox::critical(this, title, compactor.getError());
+        return false;
+    }
+    return true;
+}
+
+void MainWindow::on_actionCompactDdb_triggered()
+{
+    if (!mTreeRoot || !EnsureDdbExists()) {
+        QMessageBox::critical(this, "Cannot compact DDB", "Open a DDI whose DDB exists first");
+        return;
+    }
 
-        // Build final DDI with hash segment
-        ddi.seek(0);
-        auto phase1Ddi = ddi.readAll();
+    DdiReferences references;
+    references.collect(mTreeRoot);
 
-        // Hash is after PHDC, find its end
-        auto phdc = SearchForChunkByPath({ "<Phoneme Dictionary>" }); assert(phdc);
+    DdbCompactor compactor(references);
+    QString outputDir;
+    if (!CompactDdb(compactor, tr("Compact DDB"), outputDir)) {
+        return;
+    }
+
+    const auto& stats = compactor.stats();
+    QMessageBox::information(this, "DDB compacted",
+                             tr("%1 of %2 chunks kept, %3 references moved\n"
+                                "%4 MB -> %5 MB, %6 bytes dropped\n"
+                                "MD4 %7%8\n"
+                                "Done in %9 ms\n\n"
+                                "Written to %10, open it and use Verify DDB to check the result")
+                                 .arg(stats.liveChunks).arg(stats.chunks).arg(stats.references)
+                                 .arg(stats.inputSize >> 20).arg(stats.outputSize >> 20).arg(stats.droppedBytes)
+                                 .arg(QString(stats.hash), mTreeRoot->GetProperty("HashStore").data.isEmpty()
+                                                               ? tr(" (the DDI has no HashStore)") : QString())
+                                 .arg(stats.elapsedMs)
+                                 .arg(outputDir));
+}
+
+void MainWindow::on_actionOptimizeDdbLayout_triggered()
+{
+    if (!mTreeRoot || !EnsureDdbExists()) {
+        QMessageBox::critical(this, "Cannot optimize DDB layout", "Open a DDI whose DDB exists first");
+        return;
+    }
+
+    QString tracePath = QFileDialog::getOpenFileName(this, tr("Open access trace"), QFileInfo(mDdiPath).absolutePath(),
+                                                     tr("Access traces (*.txt *.trace);;All files (*)"));
+    if (tracePath.isEmpty()) {
+        return;
+    }
+
+    DdiReferences references;
+    references.collect(mTreeRoot);
+
+    DdbLayoutOptimizer optimizer(references);
+    if (!optimizer.loadTrace(tracePath)) {
+        QMessageBox::critical(this, "Cannot optimize DDB layout", optimizer.getError());
+        return;
+    }
+
+    DdbCompactor compactor(references);
+    compactor.setOwnerOrder(optimizer.computeOrder());
+    QString outputDir;
+    if (!CompactDdb(compactor, tr("Optimize DDB Layout"), outputDir)) {
+        return;
+    }
+
+    // Replay the trace against the old offsets and the new ones
+    const auto& chunks = compactor.index().chunks();
+    QVector<quint64> oldOffsets(chunks.size());
+    for (int i = 0; i < chunks.size(); i++) {
+        oldOffsets[i] = chunks[i].offset;
+    }
+    auto before = optimizer.replay(chunks, oldOffsets, compactor.referenceChunks());
+    auto after = optimizer.replay(chunks, compactor.newOffsets(), compactor.referenceChunks());
 
-        // Calculate MD4 hash of the DDB file content (not DDI!)
-        // The hash covers the entire DDB file that was just written
-        ddb.seek(0);
-        QByteArray ddbContent = ddb.readAll();
+    QString reportPath = outputDir + "/" + QFileInfo(mDdbPath).fileName() + ".layout.json";
+    bool reportWritten = DdbLayoutOptimizer::writeReport(reportPath, tracePath, optimizer, before, after);
 
-        QCryptographicHash md4(QCryptographicHash::Md4);
-        md4.addData(ddbContent);
-        QByteArray hashResult = md4.result().toHex(); // 32 bytes hex string (lowercase)
+    auto percent = [](quint64 from, quint64 to) {
+        return from ? QString::number(100.0 * ((double)from - (double)to) / from, 'f', 1) + "%" : QString("-");
+    };
+    QMessageBox::information(this, "DDB layout optimized",
+                             tr("%1 sequences over %2 units, %3 trace entries not in this DDI\n"
+                                "Seeks: %4 -> %5 (%6 fewer)\n"
+                                "Seek distance: %7 MB -> %8 MB (%9 less)\n"
+                                "Page faults: %10 -> %11 (%12 fewer)\n\n"
+                                "Written to %13\n")
+                                 .arg(optimizer.sequenceCount()).arg(optimizer.tracedOwners()).arg(optimizer.unknownUnits())
+                                 .arg(before.seeks).arg(after.seeks).arg(percent(before.seeks, after.seeks))
+                                 .arg(before.seekBytes >> 20).arg(after.seekBytes >> 20).arg(percent(before.seekBytes, after.seekBytes))
+                                 .arg(before.pages).arg(after.pages).arg(percent(before.pages, after.pages))
+                                 .arg(outputDir)
+                             + (reportWritten ? tr("Full report: %1").arg(reportPath)
+                                              : tr("Cannot write report to %1").arg(reportPath)));
+}
+
+void MainWindow::on_actionDdbMap_triggered()
+{
+    if (!mTreeRoot || !EnsureDdbExists()) {
+        QMessageBox::critical(this, "Cannot map DDB", "Open a DDI whose DDB exists first");
+        return;
+    }
+
+    DdiReferences references;
+    references.collect(mTreeRoot);
+
+    QProgressDialog progDlg(tr("Indexing %1...").arg(mDdbPath), tr("Cancel"), 0,
+                            QFileInfo(mDdbPath).size() >> 20, this);
+    progDlg.setWindowModality(Qt::WindowModal);
+    progDlg.setMinimumDuration(0);
+    progDlg.setWindowTitle(tr("DDB Map"));
+
+    auto map = QSharedPointer<DdbMap>::create();
+    bool built = map->build(mDdbPath, references, [&](quint64 done, quint64) {
+        progDlg.setValue(done >> 20);
+        return !progDlg.wasCanceled();
+    });
+    progDlg.reset();
+    if (!built) {
+        if (!progDlg.wasCanceled())
+            QMessageBox::critical(this, "Cannot map DDB", map->getError());
+        return;
+    }
+
+    auto window = new QWidget(this, Qt::Window);
+    window->setAttribute(Qt::WA_DeleteOnClose);
+    window->setWindowTitle(tr("DDB Map - %1").arg(QFileInfo(mDdbPath).fileName()));
+    auto layout = new QVBoxLayout(window);
+    auto colorBy = new QComboBox(window);
+    colorBy->addItems({ tr("Colour by chunk kind"), tr("Colour by voice colour / leading phoneme") });
+    auto view = new DdbMapView(window);
+    view->SetMap(map);
+    connect(colorBy, QOverload<int>::of(&QComboBox::currentIndexChanged), view, [view](int index) {
+        view->SetColorByGroup(index == 1);
+    });
+    layout->addWidget(colorBy);
+    layout->addWidget(view, 1);
+    window->resize(800, 840);
+    window->show();
+}
+
+void MainWindow::on_actionDiffDdi_triggered()
+{
+    if (!mTreeRoot) {
+        QMessageBox::critical(this, "Cannot compare DDI", "Open a DDI first");
+        return;
+    }
+
+    QString otherPath = QFileDialog::getOpenFileName(this, tr("Compare with..."), mDatabaseDirectory,
+                                                     "DDI (*.ddi);;Development DB tree (*.tree)");
+    if (otherPath.isEmpty()) {
+        return;
+    }
 
-        // Pad hash to 260 bytes with zeros (as per Vocaloid implementation)
-        QByteArray hashSegment;
-        hashSegment.append(hashResult);
-        while (hashSegment.size() < 260) {
-            hashSegment.append('\0');
+    QProgressDialog progDlg(tr("Reading %1...").arg(otherPath.section('/', -1)), QString(), 0,
+                            QFileInfo(otherPath).size(), this);
+    progDlg.setWindowModality(Qt::WindowModal);
+    progDlg.setMinimumDuration(0);
+    progDlg.setAutoClose(false);
+
+    // The reader flags are global, put back the ones of the opened tree
+    const bool devDb = BaseChunk::DevDb;
+    ChunkCreator::Get()->SetProgressDialog(&progDlg);
+    BaseChunk* other = ParseDdi(otherPath);
+    ChunkCreator::Get()->SetProgressDialog(nullptr);
+    BaseChunk::DevDb = devDb;
+    if (!other) {
+        return;
+    }
+
+    // Payloads are only compared when both DDBs are there
+    const bool haveDdb = EnsureDdbExists();
+    QString otherDdb = otherPath.section('.', 0, -2) + ".ddb";
+    if (!haveDdb || !QFile::exists(otherDdb)) {
+        otherDdb.clear();
+    }
+    QString ourDdb = otherDdb.isEmpty() ? QString() : mDdbPath;
+
+    progDlg.setLabelText(ourDdb.isEmpty() ? tr("Comparing trees...") : tr("Comparing trees and DDB payloads..."));
+    progDlg.setRange(0, 0);
+
+    DdiDiff diff;
+    QFutureWatcher<bool> watcher;
+    connect(&watcher, &QFutureWatcher<bool>::finished, &progDlg, &QProgressDialog::accept);
+    watcher.setFuture(QtConcurrent::run([&]() {
+        return diff.compare(mTreeRoot, ourDdb, other, otherDdb);
+    }));
+    progDlg.exec();
+    watcher.waitForFinished();
+    delete other;
+
+    if (!watcher.result()) {
+        QMessageBox::critical(this, "Cannot compare DDI", diff.getError());
+        return;
+    }
+
+    QString reportPath = mDdiPath.section('.', 0, -2) + "_diff.json";
+    bool reportWritten = DdiDiff::writeReport(reportPath, mDdiPath, otherPath, diff);
+
+    int counts[4] = { 0, 0, 0, 0 };
+    QStringList lines;
+    foreach (const auto& entry, diff.entries()) {
+        counts[entry.kind]++;
+        if (lines.size() < 20) {
+            lines.append(entry.field.isEmpty() ? QString("%1: %2").arg(DdiDiff::KindName(entry.kind), entry.path)
+                                               : QString("%1: %2 [%3] %4 -> %5").arg(DdiDiff::KindName(entry.kind), entry.path,
+                                                                                     entry.field, entry.before, entry.after));
         }
-        hashSegment.resize(260);
+    }
+    if (diff.entries().size() > lines.size()) {
+        lines.append(tr("... and %1 more").arg(diff.entries().size() - lines.size()));
+    }
 
-        // Build final DDI: header + PHDC + hash segment + rest
-        QByteArray finalDdi;
-        finalDdi.append("\0\0\0\0\0\0\0\0DBSe", 12); // Fixed header
-        finalDdi.append(phase1Ddi.left(phdc->GetOriginalOffset() + phdc->GetSize()).mid(12)); // PHDC
-        finalDdi.append(hashSegment); // 260-byte hash segment
-        finalDdi.append(phase1Ddi.mid(phdc->GetOriginalOffset() + phdc->GetSize())); // Rest of DDI
+    QString summary = tr("%1 nodes against %2, compared in %3 ms%4\n"
+                         "%5 added, %6 removed, %7 changed fields, %8 changed payloads\n\n")
+                          .arg(diff.nodeCount(0)).arg(diff.nodeCount(1)).arg(diff.elapsedMs())
+                          .arg(diff.payloadsCompared() ? QString() : tr(" (trees only, a DDB is missing)"))
+                          .arg(counts[DdiDiffEntry::Added]).arg(counts[DdiDiffEntry::Removed])
+                          .arg(counts[DdiDiffEntry::Changed]).arg(counts[DdiDiffEntry::PayloadChanged])
+                      + lines.join('\n') + "\n\n"
+                      + (reportWritten ? tr("Full report: %1").arg(reportPath)
+                                       : tr("Cannot write report to %1").arg(reportPath));
+    QMessageBox::information(this, diff.entries().isEmpty() ? tr("No differences") : tr("DDI differences"), summary);
+}
 
-        ddi.seek(0);
-        ddi.write(finalDdi);
+bool MainWindow::WriteDdi(DdiWriter &writer, const QString &path, const QString &title)
+{
+    QProgressDialog progDlg(tr("Writing %1...").arg(path), tr("Cancel"), 0, QFileInfo(mDdiPath).size() >> 20, this);
+    progDlg.setWindowModality(Qt::WindowModal);
+    progDlg.setMinimumDuration(0);
+    progDlg.setWindowTitle(title);
 
-        ddi.close();
-        ddb.close();
+    bool written = writer.write(mDdiPath, path, [&](quint64 done, quint64) {
+        progDlg.setValue(done >> 20);
+        return !progDlg.wasCanceled();
+    });
+    progDlg.reset();
+    if (!written) {
+        QMessageBox::critical(this, title, writer.getError());
+    }
+    return written;
+}
+
+void MainWindow::on_actionSaveDdiAs_triggered()
+{
+    if (!mTreeRoot) {
+        QMessageBox::critical(this, "Cannot save DDI", "Open a DDI first");
+        return;
+    }
+
+    QString filter = BaseChunk::DevDb ? "Development VB Index (*.tree)" : "Daisy Database Index (*.ddi)";
+    QString path = QFileDialog::getSaveFileName(this, tr("Save DDI As..."), QFileInfo(mDdiPath).absolutePath(), filter);
+    if (path.isEmpty()) {
+        return;
+    }
+
+    DdiWriter writer(mTreeRoot);
+    if (!WriteDdi(writer, path, tr("Save DDI"))) {
+        return;
+    }
+    QMessageBox::information(this, tr("DDI saved"),
+                             tr("%1\n%2 bytes, %3 spans from the tree, %4 chunk lengths updated, %5 ms")
+                                 .arg(path).arg(writer.outputSize()).arg(writer.spanCount())
+                                 .arg(writer.resizedChunks()).arg(writer.elapsedMs()));
+}
+
+void MainWindow::on_actionVerifyRoundTrip_triggered()
+{
+    if (!mTreeRoot) {
+        QMessageBox::critical(this, "Cannot verify round trip", "Open a DDI first");
+        return;
+    }
+
+    QTemporaryFile temp(QDir::tempPath() + "/ddiview_roundtrip_XXXXXX.ddi");
+    if (!temp.open()) {
+        QMessageBox::critical(this, "Cannot verify round trip", "Cannot create a temporary file");
+        return;
+    }
+    temp.close();
+
+    DdiWriter writer(mTreeRoot);
+    if (!WriteDdi(writer, temp.fileName(), tr("Verify DDI Round Trip"))) {
+        return;
+    }
+
+    qint64 difference;
+    QString error;
+    if (!DdiWriter::Compare(mDdiPath, temp.fileName(), difference, error)) {
+        QMessageBox::critical(this, "Cannot verify round trip", error);
+        return;
+    }
+
+    QString stats = tr("%1 spans from the tree, %2 bytes written in %3 ms")
+                        .arg(writer.spanCount()).arg(writer.outputSize()).arg(writer.elapsedMs());
+    if (difference < 0) {
+        QMessageBox::information(this, tr("Round trip verified"),
+                                 tr("The written DDI is identical to %1\n%2").arg(mDdiPath, stats));
+    } else {
+        QMessageBox::warning(this, tr("Round trip differs"),
+                             tr("The written DDI first differs from %1 at 0x%2, edited properties count too\n%3")
+                                 .arg(mDdiPath).arg(difference, 0, 16).arg(stats));
+    }
+}
+
+void MainWindow::EditProperty(QListWidgetItem *item)
+{
+    auto treeItem = ui->treeStructure->currentItem();
+    if (!mPatcher || !treeItem) {
+        return;
+    }
+    auto chunk = treeItem->data(0, BaseChunk::ItemChunkRole).value<BaseChunk*>();
+    QString name = item->data(BaseChunk::ItemPropNameRole).toString();
+    ChunkProperty prop = chunk->GetProperty(name);
+    if (!chunk->GetPropertiesMap().contains(name)) {
+        QMessageBox::critical(this, tr("Cannot edit value"), tr("%1 is not a field read from the DDI").arg(name));
+        return;
+    }
+
+    bool ok;
+    QString current = prop.type == PropRawHex ? QString(prop.data.toHex(' ')) : FormatProperty(prop);
+    QString text = QInputDialog::getText(this, tr("Edit Value"),
+                                         tr("%1 (%2, %3 bytes at 0x%4)")
+                                             .arg(name, PropertyTypeNames[prop.type]).arg(prop.data.size())
+                                             .arg(prop.offset, 0, 16),
+                                         QLineEdit::Normal, current, &ok);
+    if (!ok || text == current) {
+        return;
+    }
+
+    QByteArray data;
+    QString error;
+    if (!DdiPatcher::Encode(prop.type, text, prop.data.size(), data, error) || !mPatcher->stage(chunk, name, data)) {
+        QMessageBox::critical(this, tr("Cannot edit value"), error.isEmpty() ? mPatcher->getError() : error);
+        return;
+    }
+
+    int row = ui->listProperties->row(item);
+    on_treeStructure_currentItemChanged(treeItem, nullptr);
+    ui->listProperties->setCurrentRow(row);
+    ui->statusbar->showMessage(tr("%1 field edit(s) pending, save them from the File menu").arg(mPatcher->staged().size()));
+}
+
+bool MainWindow::DiscardFieldEdits()
+{
+    if (!mPatcher || mPatcher->staged().isEmpty()) {
+        return true;
+    }
+    auto answer = QMessageBox::question(this, tr("Unsaved field edits"),
+                                        tr("%1 field edit(s) have not been saved. Discard them?")
+                                            .arg(mPatcher->staged().size()));
+    if (answer != QMessageBox::Yes) {
+        return false;
+    }
+    mPatcher->discard();
+    return true;
+}
+
+void MainWindow::on_actionSaveEdits_triggered()
+{
+    if (!mPatcher || mPatcher->staged().isEmpty()) {
+        QMessageBox::information(this, tr("Save Field Edits"), tr("No field edits to save"));
+        return;
+    }
+
+    int count = mPatcher->staged().size();
+    if (!mPatcher->save()) {
+        QMessageBox::critical(this, tr("Cannot save field edits"), mPatcher->getError());
+        return;
+    }
+    ui->statusbar->showMessage(tr("%1 field edit(s) written to %2 in %3 ms")
+                                   .arg(count).arg(mDdiPath).arg(mPatcher->elapsedMs()));
+}
+
+void MainWindow::on_actionUndoEdits_triggered()
+{
+    if (!mPatcher || !mPatcher->canUndo()) {
+        QMessageBox::information(this, tr("Undo Saved Field Edits"), tr("No saved field edits to undo"));
+        return;
+    }
+
+    if (!mPatcher->undo()) {
+        QMessageBox::critical(this, tr("Cannot undo field edits"), mPatcher->getError());
+        return;
+    }
+    on_treeStructure_currentItemChanged(ui->treeStructure->currentItem(), nullptr);
+    ui->statusbar->showMessage(tr("Saved field edits reverted in %1").arg(mDdiPath));
+}
+
+void MainWindow::on_actionPerformance_triggered()
+{
+#ifdef DDIVIEW_PERF_TRACE
+    auto window = new QWidget(this, Qt::Window);
+    window->setAttribute(Qt::WA_DeleteOnClose);
+    window->setWindowTitle(tr("Performance"));
+    auto layout = new QVBoxLayout(window);
+    auto status = new QLabel(window);
+    auto table = new QTableWidget(0, 6, window);
+    table->setHorizontalHeaderLabels({ tr("Name"), tr("Count"), tr("Total ms"), tr("Self ms"), tr("Bytes"), tr("MB/s") });
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->hide();
+    auto buttons = new QHBoxLayout();
+    auto btnRefresh = new QPushButton(tr("Refresh"), window);
+    auto btnExport = new QPushButton(tr("Export Trace..."), window);
+    auto btnClear = new QPushButton(tr("Clear"), window);
+    buttons->addWidget(btnRefresh);
+    buttons->addWidget(btnExport);
+    buttons->addStretch();
+    buttons->addWidget(btnClear);
+    layout->addWidget(status);
+    layout->addWidget(table, 1);
+    layout->addLayout(buttons);
+
+    auto refresh = [=]() {
+        const auto summaries = PerfTrace::Summarize();
+        table->setSortingEnabled(false);
+        table->setRowCount(summaries.size());
+        for (int row = 0; row < summaries.size(); row++) {
+            const auto& summary = summaries[row];
+            // Numbers sort as numbers through the display role
+            auto cell = [&](int column, const QVariant& value) {
+                auto item = new QTableWidgetItem();
+                item->setData(Qt::DisplayRole, value);
+                table->setItem(row, column, item);
+            };
+            cell(0, summary.name);
+            cell(1, summary.count);
+            cell(2, summary.totalNs / 1e6);
+            cell(3, summary.selfNs / 1e6);
+            cell(4, summary.bytes);
+            cell(5, summary.bytes && summary.totalNs ? summary.bytes * 1e3 / summary.totalNs : QVariant());
+        }
+        table->setSortingEnabled(true);
+        table->resizeColumnsToContents();
+        status->setText(tr("%1 events recorded%2").arg(PerfTrace::EventCount())
+                            .arg(PerfTrace::EventsDropped() ? tr(", later ones only counted in the totals") : QString()));
+    };
+    connect(btnRefresh, &QPushButton::clicked, window, refresh);
+    connect(btnClear, &QPushButton::clicked, window, [=]() {
+        PerfTrace::Clear();
+        refresh();
+    });
+    connect(btnExport, &QPushButton::clicked, window, [=]() {
+        QString path = QFileDialog::getSaveFileName(window, tr("Export Trace..."), mDatabaseDirectory, "Chrome trace (*.json)");
+        if (path.isEmpty()) {
+            return;
+        }
+        QString error;
+        if (!PerfTrace::WriteChromeTrace(path, error)) {
+            QMessageBox::critical(window, tr("Cannot export trace"), error);
+        }
+    });
+    refresh();
+    window->resize(720, 480);
+    window->show();
+#else
+    QMessageBox::information(this, tr("Performance"),
+                             tr("This build records no timings, configure it with -DDDIVIEW_PERF_TRACE=ON"));
+#endif
+}
+
+void MainWindow::CollectMemory(MemoryReport &report)
+{
+    report.addTree(mTreeRoot);
+
+    // DDB chunks are only held by the items of the DDB tree
+    QVector<QTreeWidgetItem*> pending { ui->treeStructureDdb->invisibleRootItem() };
+    while (!pending.isEmpty()) {
+        auto item = pending.takeLast();
+        for (int i = 0; i < item->childCount(); i++) {
+            pending.append(item->child(i));
+        }
+        report.addDdbChunk(item->data(0, BaseChunk::ItemChunkRole).value<BaseChunk*>());
     }
 
-    QMessageBox::information(this, "Packing done", ddi.fileName() + '\n' + ddb.fileName());
+    report.addTreeItems(tr("DDI tree"), ui->treeStructure->invisibleRootItem());
+    report.addTreeItems(tr("DDB tree"), ui->treeStructureDdb->invisibleRootItem());
+    report.add(tr("Waveform cache"), tr("Selected PCM"), mSelectedPcm.size(), report.vectorBytes(mSelectedPcm));
+    report.add(tr("Waveform cache"), tr("Plot points"), mWaveformGraph->dataCount(),
+               mWaveformGraph->dataCount() * sizeof(QCPGraphData));
+    const qint64 tiles = mSpectrogramView->CacheBytes();
+    report.add(tr("Waveform cache"), tr("Spectrogram tiles"), tiles ? 1 : 0, tiles);
 }
 
+void MainWindow::on_actionMemoryReport_triggered()
+{
+    auto window = new QWidget(this, Qt::Window);
+    window->setAttribute(Qt::WA_DeleteOnClose);
+    window->setWindowTitle(tr("Memory Usage"));
+    auto layout = new QVBoxLayout(window);
+    auto status = new QLabel(window);
+    auto table = new QTableWidget(0, 5, window);
+    table->setHorizontalHeaderLabels({ tr("Category"), tr("Detail"), tr("Count"), tr("Bytes"), tr("Share %") });
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->hide();
+    auto buttons = new QHBoxLayout();
+    auto btnRefresh = new QPushButton(tr("Refresh"), window);
+    buttons->addWidget(btnRefresh);
+    buttons->addStretch();
+    layout->addWidget(status);
+    layout->addWidget(table, 1);
+    layout->addLayout(buttons);
+
+    auto refresh = [=]() {
+        QElapsedTimer timer;
+        timer.start();
+        MemoryReport report;
+        CollectMemory(report);
+        const auto rows = report.rows();
+        table->setSortingEnabled(false);
+        table->setRowCount(rows.size());
+        for (int row = 0; row < rows.size(); row++) {
+            // Numbers sort as numbers through the display role
+            auto cell = [&](int column, const QVariant& value) {
+                auto item = new QTableWidgetItem();
+                item->setData(Qt::DisplayRole, value);
+                table->setItem(row, column, item);
+            };
+            cell(0, rows[row].category);
+            cell(1, rows[row].detail);
+            cell(2, rows[row].count);
+            cell(3, rows[row].bytes);
+            cell(4, report.totalBytes() ? qRound(rows[row].bytes * 1000.0 / report.totalBytes()) / 10.0 : 0.0);
+        }
+        table->setSortingEnabled(true);
+        table->resizeColumnsToContents();
+        status->setText(tr("%1 in total, counted in %2 ms").arg(MemoryReport::FormatBytes(report.totalBytes()))
+                            .arg(timer.elapsed()));
+    };
+    connect(btnRefresh, &QPushButton::clicked, window, refresh);
+    refresh();
+    window->resize(720, 480);
+    window->show();
+}
 
 void MainWindow::on_listProperties_currentItemChanged(QListWidgetItem *current, QListWidgetItem *previous)
 {
@@ -1771,12 +2035,14 @@ void MainWindow::on_treeStructureDdb_currentItemChanged(QTreeWidgetItem *current
         QVector<double> keys, vals;
         keys.reserve(sampleCount);
         vals.reserve(sampleCount);
+        mSelectedPcm.resize(sampleCount);
         double sampleToSecFac = 1.0 / sampleRate, sampleValNormFac = 1.0 / 32768.0;
         for (int i = 0; i < sampleCount; i++) {
             int16_t sample;
             mDdbStream >> sample;
             keys.append(i * sampleToSecFac);
             vals.append(sample * sampleValNormFac);
+            mSelectedPcm[i] = sample * sampleValNormFac;
         }
         mWaveformPlot->xAxis->setRange(0.0, sampleCount * sampleToSecFac);
         mWaveformGraph->setData(keys, vals, true);
@@ -1867,10 +2133,67 @@ void MainWindow::on_treeStructureDdb_currentItemChanged(QTreeWidgetItem *current
         }
 
         mWaveformPlot->replot();
+
+        mSelectedSampleRate = sampleRate;
+        mSelectedPart = pitchChunk;
+        UpdateSpectrogramView();
     }
 }
 
 
+void MainWindow::on_cmbMediaView_currentIndexChanged(int index)
+{
+    ui->stkMediaView->setCurrentWidget(index == 0 ? ui->pageWaveform : ui->pageSpectrogram);
+    UpdateSpectrogramView();
+}
+
+void MainWindow::UpdateSpectrogramView()
+{
+    // Only compute what is on screen
+    int mode = ui->cmbMediaView->currentIndex();
+    if (mode == 0) {
+        return;
+    }
+
+    if (mSelectedPcm.isEmpty()) {
+        mSpectrogramView->Clear(tr("Select a sound in the DDB tree"));
+        return;
+    }
+
+    if (mode == 1) {
+        mSpectrogramView->SetPcm(mSelectedPcm, mSelectedSampleRate);
+        return;
+    }
+
+    // Harmonic tracks, decoded straight from the mapped DDB
+    SmsFrameSet frameSet;
+    if (!mSelectedPart || !frameSet.load(mDdbFile, mSelectedPart) || frameSet.count() == 0) {
+        mSpectrogramView->Clear(frameSet.getError().isEmpty() ? tr("No frames for this sound")
+                                                              : frameSet.getError());
+        return;
+    }
+
+    HarmonicTracks tracks;
+    for (const SmsFrameView &frame : frameSet.frames()) {
+        tracks.harmonics = qMax(tracks.harmonics, frame.harmonicCount());
+    }
+    tracks.f0.resize(frameSet.count());
+    tracks.freqs.fill(0.0f, frameSet.count() * tracks.harmonics);
+    tracks.amps.fill(-100.0f, frameSet.count() * tracks.harmonics);
+    for (int i = 0; i < frameSet.count(); i++) {
+        const SmsFrameView &frame = frameSet.at(i);
+        tracks.f0[i] = frame.f0Hz();
+        auto freqs = frame.frequencies();
+        auto amps = frame.amplitudes();
+        for (int h = 0; h < qMin(freqs.size(), amps.size()); h++) {
+            tracks.freqs[i * tracks.harmonics + h] = freqs[h];
+            tracks.amps[i * tracks.harmonics + h] = amps[h];
+        }
+    }
+    mSpectrogramView->SetHarmonicTracks(tracks, mSelectedSampleRate);
+}
+
+
 void MainWindow::on_actionVqmGenerator_triggered()
 {
     VqmGeneratorDialog dlg(this);
@@ -1964,3 +2287,184 @@ void MainWindow::on_actionVqmGenerator_triggered()
                              .arg(smsPath, dstWavPath, iniPath));
 }
 
+
+
+void MainWindow::on_actionVqmBatchGenerator_triggered()
+{
+    QString manifestPath = QFileDialog::getOpenFileName(
+        this,
+        tr("Open VQM batch manifest..."),
+        QDir::currentPath(),
+        "Batch manifest (*.csv *.json);;All Files (*)");
+    if (manifestPath.isEmpty()) {
+        return;
+    }
+
+    QString error;
+    QVector<VqmBatchEntry> entries;
+    if (!VqmBatch::readManifest(manifestPath, entries, error)) {
+        QMessageBox::critical(this, tr("Invalid Manifest"),
+                              tr("Failed to read manifest:\n%1").arg(error));
+        return;
+    }
+
+    QString outputDir = QFileDialog::getExistingDirectory(
+        this,
+        tr("Select Output Directory"),
+        QDir::currentPath(),
+        QFileDialog::ShowDirsOnly);
+    if (outputDir.isEmpty()) {
+        return;
+    }
+
+    bool ok;
+    int maxHarmonics = QInputDialog::getInt(this, tr("VQM Batch Generator"),
+                                            tr("Max harmonics:"), 64, 8, 128, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    // Frame rate is ignored by the analyzer (always sampleRate / 256), keep the dialog's default
+    const int frameRate = 172;
+
+    QDir().mkpath(outputDir + "/VQM");
+
+    QVector<VqmBatchResult> jobs;
+    jobs.reserve(entries.size());
+    for (const auto &entry : entries) {
+        VqmBatchResult job;
+        job.entry = entry;
+        jobs.append(job);
+    }
+
+    // Analyze and write outputs concurrently, one WAV per pool thread
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+
+    QProgressDialog progDlg(tr("Generating %1 VQM samples...").arg(jobs.size()), tr("Cancel"), 0, jobs.size(), this);
+    progDlg.setWindowModality(Qt::WindowModal);
+    progDlg.setMinimumDuration(0);
+
+    QFutureWatcher<void> watcher;
+    connect(&watcher, &QFutureWatcher<void>::finished, &progDlg, &QProgressDialog::reset);
+    connect(&progDlg, &QProgressDialog::canceled, &watcher, &QFutureWatcher<void>::cancel);
+    connect(&watcher, &QFutureWatcher<void>::progressRangeChanged, &progDlg, &QProgressDialog::setRange);
+    connect(&watcher, &QFutureWatcher<void>::progressValueChanged, &progDlg, &QProgressDialog::setValue);
+    watcher.setFuture(QtConcurrent::map(jobs, [outputDir, frameRate, maxHarmonics](VqmBatchResult &job) {
+        VqmBatch::process(job, outputDir, frameRate, maxHarmonics);
+    }));
+    progDlg.exec();
+    watcher.waitForFinished();
+
+    qint64 wallMs = wallTimer.elapsed();
+
+    // Merge all entries into vqm.ini with one rewrite
+    QString iniPath = outputDir + "/vqm.ini";
+    if (!VqmBatch::writeIni(iniPath, jobs)) {
+        QMessageBox::critical(this, tr("Write Failed"),
+                              tr("Failed to write VQM.ini file."));
+        return;
+    }
+
+    QString reportPath = outputDir + "/vqm_batch_report.csv";
+    VqmBatch::writeReport(reportPath, jobs, wallMs);
+
+    int succeeded = 0;
+    QString details;
+    for (const auto &job : jobs) {
+        if (job.ok) {
+            succeeded++;
+            details += tr("%1: %2 frames, analyze %3 ms, SMS %4 ms, WAV %5 ms\n")
+                           .arg(job.entry.sampleName)
+                           .arg(job.frameCount)
+                           .arg(job.analyzeMs)
+                           .arg(job.writeSmsMs)
+                           .arg(job.copyWavMs);
+        } else {
+            details += tr("%1: %2\n").arg(job.entry.sampleName,
+                                          job.error.isEmpty() ? tr("cancelled") : job.error);
+        }
+    }
+
+    QMessageBox resultBox(succeeded == jobs.size() ? QMessageBox::Information : QMessageBox::Warning,
+                          tr("VQM Batch Generation Complete"),
+                          tr("%1 of %2 samples generated in %3 s.\n\n"
+                             "INI: %4\n"
+                             "Timing report: %5")
+                              .arg(succeeded)
+                              .arg(jobs.size())
+                              .arg(wallMs / 1000.0, 0, 'f', 2)
+                              .arg(iniPath, reportPath),
+                          QMessageBox::Ok,
+                          this);
+    resultBox.setDetailedText(details);
+    resultBox.exec();
+}
+
+
+void MainWindow::on_actionResynthesize_triggered()
+{
+    if (!mSelectedPart || !mDdbFile.isOpen()) {
+        QMessageBox::information(this, tr("Resynthesize"), tr("Select a sound in the DDB tree first."));
+        return;
+    }
+
+    SmsFrameSet frameSet;
+    if (!frameSet.load(mDdbFile, mSelectedPart) || frameSet.count() == 0) {
+        QMessageBox::warning(this, tr("Resynthesize"),
+                             tr("Cannot decode the frames of this sound.\n%1").arg(frameSet.getError()));
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    SmsResynth resynth(mSelectedSampleRate);
+    QVector<float> synth;
+    resynth.render(frameSet, synth);
+    qint64 renderMs = qMax<qint64>(1, timer.elapsed());
+    double audioMs = synth.size() * 1000.0 / mSelectedSampleRate;
+
+    // Reference PCM starts at the part's sample offset, which frame 0 lines up with
+    QVector<float> reference;
+    auto sndOffsetProp = mSelectedPart->GetProperty("SND Sample offset");
+    if (sndOffsetProp.type == PropHex64) {
+        uint64_t offset;
+        STUFF_INTO(sndOffsetProp.data, offset, uint64_t);
+        mDdbFile.seek(offset);
+        QByteArray pcm = mDdbFile.read(synth.size() * sizeof(int16_t));
+        reference.resize(pcm.size() / 2);
+        for (int i = 0; i < reference.size(); i++) {
+            reference[i] = qFromLittleEndian<qint16>(pcm.constData() + i * 2) / 32768.0f;
+        }
+    }
+    SmsResynthMetrics metrics = SmsResynth::compare(reference, synth);
+
+    QString message = tr("%1 frames, %2 s of audio rendered in %3 ms (%4x real time).")
+                          .arg(frameSet.count())
+                          .arg(audioMs / 1000.0, 0, 'f', 3)
+                          .arg(renderMs)
+                          .arg(audioMs / renderMs, 0, 'f', 1);
+    if (metrics.samples > 0) {
+        message += tr("\n\nCompared with SND over %1 samples:\n"
+                      "SNR %2 dB, RMS error %3\n"
+                      "SNR after gain match (x%4): %5 dB")
+                       .arg(metrics.samples)
+                       .arg(metrics.snrDb, 0, 'f', 2)
+                       .arg(metrics.errorRms, 0, 'g', 4)
+                       .arg(metrics.matchedGain, 0, 'g', 4)
+                       .arg(metrics.matchedSnrDb, 0, 'f', 2);
+    }
+    message += tr("\n\nSave the resynthesis as WAV?");
+
+    if (QMessageBox::question(this, tr("Resynthesize"), message) != QMessageBox::Yes) {
+        return;
+    }
+
+    QString wavPath = QFileDialog::getSaveFileName(this, tr("Save resynthesis..."),
+                                                   QDir::currentPath(), "WAV Files (*.wav)");
+    if (wavPath.isEmpty()) {
+        return;
+    }
+    if (!SmsResynth::writeWav(wavPath, synth, mSelectedSampleRate)) {
+        QMessageBox::critical(this, tr("Write Failed"), tr("Failed to write %1").arg(wavPath));
+    }
+}
@@ -8,11 +8,18 @@
 #include <QLabel>
 #include "chunk/basechunk.h"
 #include "qcustomplot.h"
+#include "spectrogramview.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
+struct DevDbUnit;
+class DdbCompactor;
+class DdiWriter;
+class DdiPatcher;
+class MemoryReport;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -34,6 +41,20 @@ protected:
 
     bool EnsureDdbExists();
 
+    void UpdateSpectrogramView();
+
+    // Check DevDB part files against the tree, reports every issue. True if consistent
+    bool CheckDevDb(const QVector<DevDbUnit> &units);
+    bool CompactDdb(DdbCompactor &compactor, const QString &title, QString &outputDir);
+    // Write the opened tree to path, shows the error and returns false if that failed
+    bool WriteDdi(DdiWriter &writer, const QString &path, const QString &title);
+    // Asks for a new value of the property and stages it with the patcher
+    void EditProperty(QListWidgetItem *item);
+    // Asks whether staged edits may be dropped, true if there are none left
+    bool DiscardFieldEdits();
+    // Both trees, the DDB chunks and the view caches
+    void CollectMemory(MemoryReport &report);
+
 private slots:
     void on_actionExit_triggered();
 
@@ -53,18 +74,48 @@ private slots:
 
     void on_actionExportJson_triggered();
 
+    void on_actionSaveDdiAs_triggered();
+
+    void on_actionSaveEdits_triggered();
+
+    void on_actionUndoEdits_triggered();
+
     void on_actionExtractAllSamples_triggered();
 
     void on_actionactionExportDdbLayout_triggered();
 
     void on_actionPack_DevDB_triggered();
 
+    void on_actionCheck_DevDB_triggered();
+
+    void on_actionVerifyDdb_triggered();
+
+    void on_actionCompactDdb_triggered();
+
+    void on_actionOptimizeDdbLayout_triggered();
+
+    void on_actionDdbMap_triggered();
+
+    void on_actionDiffDdi_triggered();
+
+    void on_actionVerifyRoundTrip_triggered();
+
     void on_actionVqmGenerator_triggered();
 
+    void on_actionVqmBatchGenerator_triggered();
+
+    void on_actionResynthesize_triggered();
+
+    void on_actionPerformance_triggered();
+
+    void on_actionMemoryReport_triggered();
+
     void on_listProperties_currentItemChanged(QListWidgetItem *current, QListWidgetItem *previous);
 
     void on_treeStructureDdb_currentItemChanged(QTreeWidgetItem *current, QTreeWidgetItem *previous);
 
+    void on_cmbMediaView_currentIndexChanged(int index);
+
 private:
     Ui::MainWindow *ui;
     QLabel *mLblStatusFilename,
@@ -73,8 +124,15 @@ private:
            *mLblPropertyOffset;
     QCustomPlot *mWaveformPlot;
     QCPGraph *mWaveformGraph;
+    SpectrogramView *mSpectrogramView;
+
+    // Selected DDB sound, kept for the spectrogram view
+    QVector<float> mSelectedPcm;
+    int mSelectedSampleRate;
+    BaseChunk *mSelectedPart;
 
     BaseChunk* mTreeRoot;
+    DdiPatcher *mPatcher;
     std::map<size_t, BaseChunk*> mDdbChunks;
     QFile mDdbFile;
     QDataStream mDdbStream;
@@ -11,6 +11,7 @@ PropertyContextMenu::PropertyContextMenu(QWidget *parent, QListWidgetItem* item)
     m_actDispPropName = new QAction(item->text().section('\n', 0, 0), this);
     m_actCopyAsDisplayed = new QAction(tr("Copy value as displayed"), this);
     m_actCopyAsHexSeq = new QAction(tr("Copy as raw hex sequence"), this);
+    m_actEdit = new QAction(tr("Edit value..."), this);
 
     auto dispFont = m_actDispPropName->font();
     dispFont.setBold(true);
@@ -21,6 +22,8 @@ PropertyContextMenu::PropertyContextMenu(QWidget *parent, QListWidgetItem* item)
     addSeparator();
     addAction(m_actCopyAsDisplayed);
     addAction(m_actCopyAsHexSeq);
+    addSeparator();
+    addAction(m_actEdit);
 
     connect(m_actCopyAsDisplayed, &QAction::triggered,
             this, &PropertyContextMenu::CopyAsDisplayed);
@@ -10,9 +10,13 @@ class PropertyContextMenu : public QMenu
 public:
     PropertyContextMenu(QWidget *parent, QListWidgetItem *item);
 
+    // Handled by the owner, it knows which chunk the item belongs to
+    QAction *EditAction() { return m_actEdit; }
+
 private:
     QAction *m_actCopyAsDisplayed,
             *m_actCopyAsHexSeq,
+            *m_actEdit,
             *m_actDispPropName;
 
     QListWidgetItem *m_item;
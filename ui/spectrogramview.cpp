@@ -0,0 +1,378 @@
+#include "spectrogramview.h"
+#include "util/fft.h"
+#include "uicommon.h"
+
+#include <QPainter>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QtConcurrent>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+    constexpr float MIN_DB = -100.0f;
+    constexpr float MAX_DB = 0.0f;
+
+    // Black -> purple -> orange -> pale yellow, indexed by dB
+    const QRgb *Palette()
+    {
+        static QRgb palette[256];
+        static bool initialized = false;
+        if (!initialized) {
+            const QColor stops[] = { QColor(0, 0, 4), QColor(80, 18, 123), QColor(183, 55, 121),
+                                     QColor(251, 136, 97), QColor(252, 253, 191) };
+            const int segments = 4;
+            for (int i = 0; i < 256; i++) {
+                double pos = i / 255.0 * segments;
+                int s = qMin((int)pos, segments - 1);
+                double t = pos - s;
+                const QColor &a = stops[s], &b = stops[s + 1];
+                palette[i] = qRgb(a.red() + (b.red() - a.red()) * t,
+                                  a.green() + (b.green() - a.green()) * t,
+                                  a.blue() + (b.blue() - a.blue()) * t);
+            }
+            initialized = true;
+        }
+        return palette;
+    }
+
+    inline QRgb ColorFor(float db, const QRgb *palette)
+    {
+        int index = (int)((db - MIN_DB) * (255.0f / (MAX_DB - MIN_DB)));
+        return palette[qBound(0, index, 255)];
+    }
+}
+
+SpectrogramView::SpectrogramView(QWidget *parent) :
+    QWidget(parent),
+    mGeneration(0),
+    mViewStart(0.0),
+    mViewSpan(1.0),
+    mDragging(false),
+    mDragOriginX(0),
+    mDragViewStart(0.0)
+{
+    setMinimumHeight(120);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    // Build the palette on the GUI thread before any worker needs it
+    Palette();
+    connect(&mWatcher, &QFutureWatcher<Pyramid>::finished, this, &SpectrogramView::OnPyramidReady);
+}
+
+SpectrogramView::~SpectrogramView()
+{
+    // Workers poll the generation, make them bail out before we go away
+    mGeneration++;
+    mWatcher.waitForFinished();
+}
+
+void SpectrogramView::SetPcm(const QVector<float> &samples, int sampleRate)
+{
+    mPyramid = Pyramid();
+    mMessage = tr("Computing spectrogram...");
+    Start([samples, sampleRate](const std::function<bool()> &cancelled) {
+        return ComputeStft(samples, sampleRate, cancelled);
+    });
+}
+
+void SpectrogramView::SetHarmonicTracks(const HarmonicTracks &tracks, int sampleRate)
+{
+    mPyramid = Pyramid();
+    mMessage = tr("Rendering harmonic tracks...");
+    Start([tracks, sampleRate](const std::function<bool()> &cancelled) {
+        return RasterizeTracks(tracks, sampleRate, cancelled);
+    });
+}
+
+void SpectrogramView::Clear(const QString &message)
+{
+    mGeneration++;
+    mPyramid = Pyramid();
+    mMessage = message;
+    update();
+}
+
+qint64 SpectrogramView::CacheBytes() const
+{
+    qint64 bytes = mPyramid.f0.capacity() * sizeof(float);
+    for (const auto &level : mPyramid.levels) {
+        for (const auto &tile : level) {
+            bytes += tile.sizeInBytes();
+        }
+    }
+    return bytes;
+}
+
+void SpectrogramView::Start(const std::function<Pyramid(const std::function<bool()> &)> &job)
+{
+    int generation = ++mGeneration;
+    auto cancelled = [this, generation]() { return mGeneration.load() != generation; };
+    mWatcher.setFuture(QtConcurrent::run([job, cancelled, generation]() {
+        Pyramid pyramid = job(cancelled);
+        pyramid.generation = generation;
+        return pyramid;
+    }));
+    update();
+}
+
+void SpectrogramView::OnPyramidReady()
+{
+    Pyramid pyramid = mWatcher.result();
+    if (pyramid.generation != mGeneration.load()) {
+        // Superseded by a newer request
+        return;
+    }
+    mPyramid = pyramid;
+    mMessage.clear();
+    mViewStart = 0.0;
+    mViewSpan = qMax(mPyramid.duration, mPyramid.secondsPerColumn);
+    update();
+}
+
+SpectrogramView::Pyramid SpectrogramView::ComputeStft(QVector<float> samples, int sampleRate,
+                                                      const std::function<bool()> &cancelled)
+{
+    Pyramid pyramid;
+    if (samples.isEmpty() || sampleRate <= 0) {
+        return pyramid;
+    }
+
+    const int rows = FftSize / 2;
+    const int columnCount = (samples.size() + HopSize - 1) / HopSize;
+
+    QVector<float> window(FftSize);
+    float windowSum = 0.0f;
+    for (int i = 0; i < FftSize; i++) {
+        window[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * i / (FftSize - 1)));
+        windowSum += window[i];
+    }
+    const float norm = 2.0f / windowSum;
+
+    Fft fft(FftSize);
+    QVector<float> frame(FftSize), mags(rows + 1);
+    QVector<float> columns(columnCount * rows);
+
+    for (int c = 0; c < columnCount; c++) {
+        if ((c & 63) == 0 && cancelled()) {
+            return Pyramid();
+        }
+
+        // Column c is centered on sample c * HopSize, zero padded at both ends
+        int start = c * HopSize - FftSize / 2;
+        for (int i = 0; i < FftSize; i++) {
+            int s = start + i;
+            frame[i] = (s >= 0 && s < samples.size()) ? samples[s] * window[i] : 0.0f;
+        }
+        fft.magnitudes(frame.constData(), mags.data());
+
+        float *column = columns.data() + c * rows;
+        for (int r = 0; r < rows; r++) {
+            column[r] = 20.0f * log10f(mags[r] * norm + 1e-10f);
+        }
+    }
+
+    pyramid.rows = rows;
+    pyramid.secondsPerColumn = (double)HopSize / sampleRate;
+    pyramid.maxFrequency = sampleRate / 2.0;
+    pyramid.duration = (double)samples.size() / sampleRate;
+    BuildLevels(pyramid, std::move(columns), columnCount, cancelled);
+    return pyramid;
+}
+
+SpectrogramView::Pyramid SpectrogramView::RasterizeTracks(HarmonicTracks tracks, int sampleRate,
+                                                          const std::function<bool()> &cancelled)
+{
+    Pyramid pyramid;
+    const int columnCount = tracks.f0.size();
+    if (columnCount == 0 || sampleRate <= 0) {
+        return pyramid;
+    }
+
+    const int rows = FftSize / 2;
+    const double maxFrequency = sampleRate / 2.0;
+    QVector<float> columns(columnCount * rows, MIN_DB);
+
+    for (int c = 0; c < columnCount; c++) {
+        if ((c & 63) == 0 && cancelled()) {
+            return Pyramid();
+        }
+
+        float *column = columns.data() + c * rows;
+        const float *freqs = tracks.freqs.constData() + c * tracks.harmonics;
+        const float *amps = tracks.amps.constData() + c * tracks.harmonics;
+        for (int h = 0; h < tracks.harmonics; h++) {
+            if (freqs[h] <= 0.0f || freqs[h] >= maxFrequency) {
+                continue;
+            }
+            // Partials are thin lines, widen them to one row either side
+            int row = (int)(freqs[h] / maxFrequency * rows);
+            for (int r = qMax(0, row - 1); r <= qMin(rows - 1, row + 1); r++) {
+                column[r] = qMax(column[r], amps[h]);
+            }
+        }
+    }
+
+    pyramid.rows = rows;
+    pyramid.secondsPerColumn = (double)HopSize / sampleRate;
+    pyramid.maxFrequency = maxFrequency;
+    pyramid.duration = columnCount * pyramid.secondsPerColumn;
+    pyramid.f0 = tracks.f0;
+    BuildLevels(pyramid, std::move(columns), columnCount, cancelled);
+    return pyramid;
+}
+
+void SpectrogramView::BuildLevels(Pyramid &pyramid, QVector<float> columns, int columnCount,
+                                  const std::function<bool()> &cancelled)
+{
+    const QRgb *palette = Palette();
+    const int rows = pyramid.rows;
+
+    forever {
+        if (cancelled()) {
+            pyramid.levels.clear();
+            return;
+        }
+
+        // Colorize this level into tiles, low frequencies at the bottom
+        QVector<QImage> tiles;
+        for (int first = 0; first < columnCount; first += TileColumns) {
+            int width = qMin(TileColumns, columnCount - first);
+            QImage tile(width, rows, QImage::Format_RGB32);
+            for (int r = 0; r < rows; r++) {
+                QRgb *line = (QRgb *)tile.scanLine(rows - 1 - r);
+                for (int x = 0; x < width; x++) {
+                    line[x] = ColorFor(columns[(first + x) * rows + r], palette);
+                }
+            }
+            tiles.append(tile);
+        }
+        pyramid.levels.append(tiles);
+
+        if (columnCount <= TileColumns) {
+            break;
+        }
+
+        // Next level: pairs of columns max-pooled so short peaks stay visible
+        int nextCount = (columnCount + 1) / 2;
+        QVector<float> next(nextCount * rows);
+        for (int c = 0; c < nextCount; c++) {
+            const float *a = columns.constData() + (c * 2) * rows;
+            const float *b = (c * 2 + 1 < columnCount) ? a + rows : a;
+            float *out = next.data() + c * rows;
+            for (int r = 0; r < rows; r++) {
+                out[r] = qMax(a[r], b[r]);
+            }
+        }
+        columns = std::move(next);
+        columnCount = nextCount;
+    }
+}
+
+void SpectrogramView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    if (mPyramid.levels.isEmpty()) {
+        painter.setPen(Qt::gray);
+        painter.drawText(rect(), Qt::AlignCenter, mMessage);
+        return;
+    }
+
+    // Coarsest level that still has at least one column per pixel
+    const double secondsPerPixel = mViewSpan / qMax(1, width());
+    int level = 0;
+    while (level + 1 < mPyramid.levels.size() &&
+           mPyramid.secondsPerColumn * (1 << (level + 1)) <= secondsPerPixel) {
+        level++;
+    }
+
+    const QVector<QImage> &tiles = mPyramid.levels[level];
+    const double columnSeconds = mPyramid.secondsPerColumn * (1 << level);
+    const double tileSeconds = columnSeconds * TileColumns;
+    const double pixelsPerSecond = width() / mViewSpan;
+
+    int firstTile = qMax(0, (int)(mViewStart / tileSeconds));
+    int lastTile = qMin(tiles.size() - 1, (int)((mViewStart + mViewSpan) / tileSeconds));
+    for (int t = firstTile; t <= lastTile; t++) {
+        const QImage &tile = tiles[t];
+        QRectF target((t * tileSeconds - mViewStart) * pixelsPerSecond, 0,
+                      tile.width() * columnSeconds * pixelsPerSecond, height());
+        painter.drawImage(target, tile);
+    }
+
+    // F0 overlay of the harmonic view
+    if (!mPyramid.f0.isEmpty()) {
+        int first = qMax(0, (int)(mViewStart / mPyramid.secondsPerColumn));
+        int last = qMin(mPyramid.f0.size() - 1, (int)((mViewStart + mViewSpan) / mPyramid.secondsPerColumn) + 1);
+        int step = qMax(1, (int)(secondsPerPixel / mPyramid.secondsPerColumn));
+        QPolygonF line;
+        for (int c = first; c <= last; c += step) {
+            line << QPointF((c * mPyramid.secondsPerColumn - mViewStart) * pixelsPerSecond,
+                            height() * (1.0 - mPyramid.f0[c] / mPyramid.maxFrequency));
+        }
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(QPen(Qt::cyan, 1.5));
+        painter.drawPolyline(line);
+    }
+
+    painter.setPen(Qt::white);
+    painter.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop,
+                     tr("%1 kHz").arg(mPyramid.maxFrequency / 1000.0, 0, 'f', 1));
+    painter.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignBottom,
+                     tr("%1 s").arg(mViewStart, 0, 'f', 3));
+    painter.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignRight | Qt::AlignBottom,
+                     tr("%1 s").arg(mViewStart + mViewSpan, 0, 'f', 3));
+}
+
+void SpectrogramView::wheelEvent(QWheelEvent *event)
+{
+    if (mPyramid.levels.isEmpty() || event->angleDelta().y() == 0) {
+        return;
+    }
+
+    // Keep the time under the cursor in place
+    double anchor = UiCommon::EventPosition(event).x() / qMax(1, width());
+    double anchorTime = mViewStart + anchor * mViewSpan;
+    mViewSpan *= event->angleDelta().y() > 0 ? 0.8 : 1.25;
+    mViewStart = anchorTime - anchor * mViewSpan;
+    ClampView();
+    update();
+}
+
+void SpectrogramView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        mDragging = true;
+        mDragOriginX = UiCommon::EventPosition(event).x();
+        mDragViewStart = mViewStart;
+    }
+}
+
+void SpectrogramView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!mDragging) {
+        return;
+    }
+    mViewStart = mDragViewStart - (UiCommon::EventPosition(event).x() - mDragOriginX) * mViewSpan / qMax(1, width());
+    ClampView();
+    update();
+}
+
+void SpectrogramView::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        mDragging = false;
+    }
+}
+
+void SpectrogramView::ClampView()
+{
+    double duration = qMax(mPyramid.duration, mPyramid.secondsPerColumn);
+    // Zoom in no further than 8 columns across the widget
+    mViewSpan = qBound(mPyramid.secondsPerColumn * 8, mViewSpan, duration);
+    mViewStart = qBound(0.0, mViewStart, duration - mViewSpan);
+}
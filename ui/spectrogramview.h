@@ -0,0 +1,82 @@
+#ifndef SPECTROGRAMVIEW_H
+#define SPECTROGRAMVIEW_H
+
+#include <QWidget>
+#include <QImage>
+#include <QVector>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <atomic>
+#include <functional>
+
+// Harmonic model of a unit part, one entry per FRM2 frame
+struct HarmonicTracks {
+    int harmonics = 0;
+    QVector<float> f0;      // Hz per frame
+    QVector<float> freqs;   // frames * harmonics, Hz
+    QVector<float> amps;    // frames * harmonics, dB
+};
+
+// Time/frequency view of a DDB sample: either an STFT of the PCM or the
+// harmonic tracks of its frames. The image is computed on a worker thread
+// and kept as a pyramid of tiles (each level halves the time resolution),
+// so painting only blits the few tiles of the level matching the zoom.
+// Wheel zooms the time axis around the cursor, dragging pans.
+class SpectrogramView : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit SpectrogramView(QWidget *parent = nullptr);
+    ~SpectrogramView();
+
+    void SetPcm(const QVector<float> &samples, int sampleRate);
+    void SetHarmonicTracks(const HarmonicTracks &tracks, int sampleRate);
+    void Clear(const QString &message = QString());
+    // Bytes held by the tile pyramid, for the memory report
+    qint64 CacheBytes() const;
+
+    static constexpr int FftSize = 1024;
+    static constexpr int HopSize = 256;     // One column per SMS frame
+    static constexpr int TileColumns = 256;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    struct Pyramid {
+        int generation = -1;
+        int rows = 0;
+        double secondsPerColumn = 0.0;
+        double maxFrequency = 0.0;
+        double duration = 0.0;
+        QVector<QVector<QImage>> levels;    // levels[l][tile]
+        QVector<float> f0;                  // Harmonic mode overlay, Hz per column
+    };
+
+    // Column major dB matrix to a tile pyramid
+    static void BuildLevels(Pyramid &pyramid, QVector<float> columns, int columnCount,
+                            const std::function<bool()> &cancelled);
+    static Pyramid ComputeStft(QVector<float> samples, int sampleRate, const std::function<bool()> &cancelled);
+    static Pyramid RasterizeTracks(HarmonicTracks tracks, int sampleRate, const std::function<bool()> &cancelled);
+
+    void Start(const std::function<Pyramid(const std::function<bool()> &)> &job);
+    void OnPyramidReady();
+    void ClampView();
+
+private:
+    Pyramid mPyramid;
+    QFutureWatcher<Pyramid> mWatcher;
+    std::atomic_int mGeneration;
+    QString mMessage;
+
+    double mViewStart, mViewSpan;
+    bool mDragging;
+    int mDragOriginX;
+    double mDragViewStart;
+};
+
+#endif // SPECTROGRAMVIEW_H
@@ -2,11 +2,36 @@
 #define UICOMMON_H
 
 #include <QtGlobal>
+#include <QMouseEvent>
+#include <QWheelEvent>
 
 namespace UiCommon {
 
     int SystemUnitDpi();
     double SystemScalingFactor();
+
+    // Event positions, named differently in Qt 5 and 6
+    inline QPointF EventPosition(const QMouseEvent *event) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        return event->position();
+#else
+        return event->localPos();
+#endif
+    }
+    inline QPointF EventPosition(const QWheelEvent *event) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        return event->position();
+#else
+        return event->posF();
+#endif
+    }
+    inline QPoint EventGlobalPosition(const QMouseEvent *event) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        return event->globalPosition().toPoint();
+#else
+        return event->globalPos();
+#endif
+    }
 }
 
 #endif // UICOMMON_H
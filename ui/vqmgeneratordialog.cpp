@@ -3,8 +3,8 @@
 
 #include <QFileDialog>
 #include <QMessageBox>
-#include <QFile>
-#include <QDataStream>
+
+#include "util/wavreader.h"
 
 VqmGeneratorDialog::VqmGeneratorDialog(QWidget *parent) :
     QDialog(parent),
@@ -108,86 +108,16 @@ void VqmGeneratorDialog::on_btnBrowseOutput_clicked()
 
 bool VqmGeneratorDialog::loadWavInfo(const QString& path)
 {
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) {
-        QMessageBox::warning(this, tr("Error"), tr("Cannot open WAV file."));
-        return false;
-    }
-
-    QDataStream stream(&file);
-    stream.setByteOrder(QDataStream::LittleEndian);
-
-    // Read RIFF header
-    char riff[4];
-    file.read(riff, 4);
-    if (strncmp(riff, "RIFF", 4) != 0) {
-        QMessageBox::warning(this, tr("Error"), tr("Invalid WAV file: missing RIFF header."));
-        return false;
-    }
-
-    quint32 fileSize;
-    stream >> fileSize;
-
-    char wave[4];
-    file.read(wave, 4);
-    if (strncmp(wave, "WAVE", 4) != 0) {
-        QMessageBox::warning(this, tr("Error"), tr("Invalid WAV file: missing WAVE format."));
-        return false;
-    }
-
-    // Find fmt chunk
-    bool foundFmt = false;
-    quint32 dataSize = 0;
-
-    while (!file.atEnd()) {
-        char chunkId[4];
-        quint32 chunkSize;
-        file.read(chunkId, 4);
-        stream >> chunkSize;
-
-        if (strncmp(chunkId, "fmt ", 4) == 0) {
-            quint16 audioFormat;
-            quint16 numChannels;
-            quint32 sampleRate;
-            quint32 byteRate;
-            quint16 blockAlign;
-            quint16 bitsPerSample;
-
-            stream >> audioFormat >> numChannels >> sampleRate >> byteRate >> blockAlign >> bitsPerSample;
-
-            if (audioFormat != 1) {
-                QMessageBox::warning(this, tr("Error"), tr("Only PCM WAV files are supported."));
-                return false;
-            }
-
-            mSampleRate = sampleRate;
-            mChannels = numChannels;
-            mBitsPerSample = bitsPerSample;
-            foundFmt = true;
-
-            // Skip rest of fmt chunk
-            if (chunkSize > 16) {
-                file.seek(file.pos() + chunkSize - 16);
-            }
-        } else if (strncmp(chunkId, "data", 4) == 0) {
-            dataSize = chunkSize;
-            break;
-        } else {
-            // Skip unknown chunk
-            file.seek(file.pos() + chunkSize);
-        }
-    }
-
-    if (!foundFmt || dataSize == 0) {
-        QMessageBox::warning(this, tr("Error"), tr("Invalid WAV file: missing fmt or data chunk."));
+    WavReader reader;
+    if (!reader.open(path)) {
+        QMessageBox::warning(this, tr("Error"), reader.getError());
         return false;
     }
 
-    // Calculate duration
-    int bytesPerSample = mBitsPerSample / 8;
-    int samplesPerFrame = mChannels * bytesPerSample;
-    quint32 totalSamples = dataSize / samplesPerFrame;
-    mDuration = (double)totalSamples / mSampleRate;
+    mSampleRate = reader.sampleRate();
+    mChannels = reader.channels();
+    mBitsPerSample = reader.bitsPerSample();
+    mDuration = reader.duration();
 
     return true;
 }
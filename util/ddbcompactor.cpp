@@ -0,0 +1,245 @@
+#include "ddbcompactor.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QtEndian>
+#include <algorithm>
+
+#include "ddipatchwriter.h"
+#include "perftrace.h"
+
+DdbCompactor::DdbCompactor(const DdiReferences& references) :
+    mReferences(references)
+{
+}
+
+bool DdbCompactor::compact(const QString& ddiPath, const QString& ddbPath, qint64 hashStoreField,
+                           const QString& outDdiPath, const QString& outDdbPath, const Progress& progress)
+{
+    PERF_SCOPE("Compact DDB");
+    QElapsedTimer timer;
+    timer.start();
+    mStats = DdbCompactStats();
+    mError.clear();
+
+    if (QFileInfo(outDdiPath).absoluteFilePath() == QFileInfo(ddiPath).absoluteFilePath() ||
+        QFileInfo(outDdbPath).absoluteFilePath() == QFileInfo(ddbPath).absoluteFilePath()) {
+        mError = "Cannot compact a DDB onto itself";
+        return false;
+    }
+
+    QFile ddb(ddbPath);
+    if (!ddb.open(QIODevice::ReadOnly)) {
+        mError = "Cannot open " + ddbPath;
+        return false;
+    }
+    mStats.inputSize = ddb.size();
+    // Mapped when possible, chunks are then copied without an extra buffer
+    const uchar* mapped = mStats.inputSize > 0 ? ddb.map(0, mStats.inputSize) : nullptr;
+
+    mRefChunks.clear();
+    mNewOffsets.clear();
+    QVector<int> layout;
+    if (!buildIndex(ddb, mapped, progress) || !resolve(layout) ||
+        !writeDdb(ddb, mapped, layout, outDdbPath, progress)) {
+        return false;
+    }
+
+    const auto& refs = mReferences.references();
+    const auto& chunks = mIndex.chunks();
+    QVector<DdiPatch> patches;
+    patches.reserve(refs.size() + 1);
+    for (int i = 0; i < refs.size(); i++) {
+        const int chunk = mRefChunks[i];
+        quint64 target = qToLittleEndian<quint64>(mNewOffsets[chunk] + (refs[i].target - chunks[chunk].offset));
+        patches.append(DdiPatch{ refs[i].field, QByteArray((const char*)&target, sizeof(target)) });
+    }
+    if (hashStoreField >= 0) {
+        patches.append(DdiPatch{ (quint64)hashStoreField, mStats.hash.leftJustified(HashStoreSize, '\0', true) });
+    }
+    std::sort(patches.begin(), patches.end(), [](const DdiPatch& a, const DdiPatch& b) {
+        return a.ddiOffset < b.ddiOffset;
+    });
+
+    if (progress && !progress("Writing DDI", 0, 0)) {
+        mError = "Compaction cancelled";
+        return false;
+    }
+    QFile ddi(ddiPath);
+    if (!ddi.open(QIODevice::ReadOnly)) {
+        mError = "Cannot open " + ddiPath;
+        return false;
+    }
+    QSaveFile outDdi(outDdiPath);
+    if (!outDdi.open(QIODevice::WriteOnly)) {
+        mError = "Cannot write " + outDdiPath;
+        return false;
+    }
+    if (!DdiPatchWriter::write(ddi, outDdi, patches, mError)) {
+        outDdi.cancelWriting();
+        return false;
+    }
+    if (!outDdi.commit()) {
+        mError = "Cannot write " + outDdiPath;
+        return false;
+    }
+
+    mStats.elapsedMs = timer.elapsed();
+    return true;
+}
+
+bool DdbCompactor::buildIndex(QFile& ddb, const uchar* mapped, const Progress& progress)
+{
+    const quint64 total = mStats.inputSize;
+    mIndex.reset(total);
+    QByteArray buffer;
+    for (quint64 done = 0; done < total; ) {
+        if (progress && !progress("Indexing DDB", done, total)) {
+            mError = "Compaction cancelled";
+            return false;
+        }
+        qint64 size = qMin<quint64>(BlockSize, total - done);
+        if (mapped) {
+            mIndex.feed((const char*)mapped + done, size);
+        } else {
+            buffer = ddb.read(size);
+            if (buffer.size() != size) {
+                mError = QString("Cannot read %1 at 0x%2").arg(ddb.fileName()).arg(done, 0, 16);
+                return false;
+            }
+            mIndex.feed(buffer.constData(), size);
+        }
+        done += size;
+    }
+    mIndex.finish();
+    mStats.chunks = mIndex.chunks().size();
+    return true;
+}
+
+bool DdbCompactor::resolve(QVector<int>& layout)
+{
+    const auto& refs = mReferences.references();
+    const auto& chunks = mIndex.chunks();
+    mStats.references = refs.size();
+
+    // Anything that does not resolve cleanly would be lost, so refuse instead
+    mRefChunks.resize(refs.size());
+    QVector<QVector<int>> ownerRefs(mReferences.owners().size());
+    for (int i = 0; i < refs.size(); i++) {
+        const auto& ref = refs[i];
+        const int chunk = mIndex.find(ref.target);
+        const quint32 wanted = ref.kind == DdiReference::Frame ? DdbIndex::FrameSignature : DdbIndex::SndSignature;
+        if (chunk < 0 || chunks[chunk].signature != wanted ||
+            (ref.kind == DdiReference::Frame && ref.target != chunks[chunk].offset)) {
+            mError = QString("%1 of %2 does not point to a valid chunk (0x%3), verify the DDB first")
+                         .arg(DdiReferences::KindName(ref.kind), mReferences.owners()[ref.owner])
+                         .arg(ref.target, 0, 16);
+            return false;
+        }
+        mRefChunks[i] = chunk;
+        ownerRefs[ref.owner].append(i);
+    }
+
+    QVector<int> order;
+    QVector<bool> ordered(ownerRefs.size(), false);
+    foreach (int owner, mOwnerOrder) {
+        if (owner >= 0 && owner < ownerRefs.size() && !ordered[owner]) {
+            ordered[owner] = true;
+            order.append(owner);
+        }
+    }
+    for (int owner = 0; owner < ownerRefs.size(); owner++) {
+        if (!ordered[owner]) {
+            order.append(owner);
+        }
+    }
+
+    // Each chunk goes where it is first used
+    QVector<bool> placed(chunks.size(), false);
+    foreach (int owner, order) {
+        foreach (int ref, ownerRefs[owner]) {
+            const int chunk = mRefChunks[ref];
+            if (!placed[chunk]) {
+                placed[chunk] = true;
+                layout.append(chunk);
+            }
+        }
+    }
+    mStats.liveChunks = layout.size();
+    return true;
+}
+
+bool DdbCompactor::writeDdb(QFile& ddb, const uchar* mapped, const QVector<int>& layout, const QString& outDdbPath,
+                            const Progress& progress)
+{
+    const auto& chunks = mIndex.chunks();
+    quint64 total = 0;
+    foreach (int chunk, layout) {
+        total += chunks[chunk].size;
+    }
+
+    QSaveFile out(outDdbPath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        mError = "Cannot write " + outDdbPath;
+        return false;
+    }
+
+    QCryptographicHash md4(QCryptographicHash::Md4);
+    mNewOffsets.fill(0, chunks.size());
+    QByteArray buffer;
+    quint64 pos = 0, reported = 0;
+    for (int i = 0; i < layout.size(); i++) {
+        // Chunks are small, report about once per block
+        if (progress && (i == 0 || pos - reported >= (quint64)BlockSize)) {
+            reported = pos;
+            if (!progress("Writing DDB", pos, total)) {
+                mError = "Compaction cancelled";
+                out.cancelWriting();
+                return false;
+            }
+        }
+
+        const auto& info = chunks[layout[i]];
+        mNewOffsets[layout[i]] = pos;
+        if (!mapped && !ddb.seek(info.offset)) {
+            mError = QString("Cannot read %1 at 0x%2").arg(ddb.fileName()).arg(info.offset, 0, 16);
+            out.cancelWriting();
+            return false;
+        }
+        for (quint64 done = 0; done < info.size; ) {
+            qint64 size = qMin<quint64>(BlockSize, info.size - done);
+            const char* data;
+            if (mapped) {
+                data = (const char*)mapped + info.offset + done;
+            } else {
+                buffer = ddb.read(size);
+                if (buffer.size() != size) {
+                    mError = QString("Cannot read %1 at 0x%2").arg(ddb.fileName()).arg(info.offset + done, 0, 16);
+                    out.cancelWriting();
+                    return false;
+                }
+                data = buffer.constData();
+            }
+            md4.addData(QByteArray::fromRawData(data, size));
+            if (out.write(data, size) != size) {
+                mError = "Cannot write " + outDdbPath + ": " + out.errorString();
+                out.cancelWriting();
+                return false;
+            }
+            done += size;
+        }
+        pos += info.size;
+    }
+
+    if (!out.commit()) {
+        mError = "Cannot write " + outDdbPath;
+        return false;
+    }
+    mStats.outputSize = pos;
+    mStats.droppedBytes = mStats.inputSize - pos;
+    mStats.hash = md4.result().toHex();
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef DDBCOMPACTOR_H
+#define DDBCOMPACTOR_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <functional>
+
+class QFile;
+
+#include "ddbindex.h"
+#include "ddireferences.h"
+
+struct DdbCompactStats {
+    quint64 inputSize = 0;
+    quint64 outputSize = 0;
+    int chunks = 0;
+    int liveChunks = 0;
+    quint64 droppedBytes = 0;
+    int references = 0;
+    QByteArray hash;        // Hex MD4 of the new DDB
+    qint64 elapsedMs = 0;
+};
+
+// Rewrites a DDB with only the chunks its DDI refers to, and the DDI with
+// every reference moved along and a fresh HashStore.
+// Live chunks are laid out in the order their owners come in (tree order by
+// default, so the parts of one phoneme and pitch end up next to each other),
+// each at its first use. Both files are streamed: the source DDB is mapped
+// or read per chunk, the DDI is copied block by block with patches applied.
+class DdbCompactor
+{
+public:
+    // Return false to cancel
+    typedef std::function<bool(const QString& step, quint64 done, quint64 total)> Progress;
+
+    static constexpr qint64 BlockSize = 8 << 20;
+    static constexpr int HashStoreSize = 260;
+
+    explicit DdbCompactor(const DdiReferences& references);
+
+    // Owners (indexes into DdiReferences::owners()) in the order to lay out
+    // their chunks, owners left out follow in tree order
+    void setOwnerOrder(const QVector<int>& order) { mOwnerOrder = order; }
+
+    // hashStoreField is the DDI offset of the HashStore property, -1 if none
+    bool compact(const QString& ddiPath, const QString& ddbPath, qint64 hashStoreField,
+                 const QString& outDdiPath, const QString& outDdbPath, const Progress& progress = Progress());
+
+    const DdbCompactStats& stats() const { return mStats; }
+    const DdbIndex& index() const { return mIndex; }
+    // Chunk index of every reference, and where each live chunk went
+    const QVector<int>& referenceChunks() const { return mRefChunks; }
+    const QVector<quint64>& newOffsets() const { return mNewOffsets; }
+    QString getError() const { return mError; }
+
+private:
+    bool buildIndex(QFile& ddb, const uchar* mapped, const Progress& progress);
+    // Fills mRefChunks and the chunks in output order
+    bool resolve(QVector<int>& layout);
+    bool writeDdb(QFile& ddb, const uchar* mapped, const QVector<int>& layout, const QString& outDdbPath,
+                  const Progress& progress);
+
+private:
+    const DdiReferences& mReferences;
+    QVector<int> mOwnerOrder;
+    DdbIndex mIndex;
+    QVector<int> mRefChunks;
+    QVector<quint64> mNewOffsets;
+    DdbCompactStats mStats;
+    QString mError;
+};
+
+#endif // DDBCOMPACTOR_H
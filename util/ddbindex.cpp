@@ -0,0 +1,139 @@
+#include "ddbindex.h"
+
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+    // Issues listed one by one, the rest are only counted
+    constexpr int MaxListedIssues = 1000;
+}
+
+DdbIndex::DdbIndex()
+{
+    reset(0);
+}
+
+void DdbIndex::reset(quint64 fileSize)
+{
+    mFileSize = fileSize;
+    mPos = 0;
+    mNext = 0;
+    mIndexedEnd = 0;
+    mStopped = false;
+    mCarry.clear();
+    mChunks.clear();
+    mIssues.clear();
+    mIssueCount = 0;
+}
+
+void DdbIndex::addIssue(const QString& issue)
+{
+    if (mIssueCount++ < MaxListedIssues) {
+        mIssues.append(issue);
+    }
+}
+
+void DdbIndex::stop(const QString& issue)
+{
+    addIssue(issue);
+    mStopped = true;
+    mCarry.clear();
+}
+
+bool DdbIndex::parseHeader(const char* header, qint64 available)
+{
+    const bool atEnd = mNext + available >= mFileSize;
+    if (available < 8) {
+        if (atEnd) {
+            stop(QString("Truncated chunk header at 0x%1").arg(mNext, 0, 16));
+        }
+        return false;
+    }
+
+    quint32 signature = FourCC(header);
+    quint64 size = qFromLittleEndian<quint32>(header + 4);
+    bool printable = std::all_of(header, header + 4, [](char c) { return c >= 0x20 && c < 0x7f; });
+    if (!printable || size < 8) {
+        stop(QString("No chunk header at 0x%1, the rest of the file is not indexed").arg(mNext, 0, 16));
+        return false;
+    }
+
+    quint64 extent = size;
+    quint32 sampleCount = 0;
+    if (signature == SndSignature) {
+        if (available < SndHeaderSize) {
+            if (atEnd) {
+                stop(QString("Truncated SND header at 0x%1").arg(mNext, 0, 16));
+            }
+            return false;
+        }
+        // 16 bit samples follow the header, whatever the size field says
+        sampleCount = qFromLittleEndian<quint32>(header + 14);
+        extent = SndHeaderSize + (quint64)sampleCount * 2;
+        if (size != extent) {
+            addIssue(QString("SND at 0x%1: size field 0x%2, %3 samples need 0x%4")
+                         .arg(mNext, 0, 16).arg(size, 0, 16).arg(sampleCount).arg(extent, 0, 16));
+        }
+    }
+
+    if (mNext + extent > mFileSize) {
+        addIssue(QString("%1 at 0x%2 runs past the end of the file")
+                     .arg(FourCCName(signature)).arg(mNext, 0, 16));
+        extent = mFileSize - mNext;
+    }
+
+    mChunks.append({ mNext, extent, signature, sampleCount });
+    mNext += extent;
+    mIndexedEnd = mNext;
+    return true;
+}
+
+void DdbIndex::feed(const char* data, qint64 size)
+{
+    const quint64 blockStart = mPos;
+    mPos += size;
+
+    while (!mStopped && mNext < mPos) {
+        if (mNext < blockStart) {
+            // Header started in the previous feed, mCarry holds its first bytes
+            qint64 take = qMin<qint64>(SndHeaderSize - mCarry.size(), size);
+            mCarry.append(data, take);
+            if (!parseHeader(mCarry.constData(), mCarry.size())) {
+                return;     // Needs even more, or stopped
+            }
+            mCarry.clear();
+            continue;
+        }
+
+        const char* header = data + (mNext - blockStart);
+        qint64 available = mPos - mNext;
+        if (!parseHeader(header, available)) {
+            if (!mStopped) {
+                mCarry = QByteArray(header, available);
+            }
+            return;
+        }
+    }
+}
+
+void DdbIndex::finish()
+{
+    if (!mStopped && mNext < mFileSize) {
+        stop(QString("Index stopped at 0x%1, before the end of the file").arg(mNext, 0, 16));
+    }
+    if (mIssueCount > mIssues.size()) {
+        mIssues.append(QString("... and %1 more").arg(mIssueCount - mIssues.size()));
+    }
+}
+
+int DdbIndex::find(quint64 offset) const
+{
+    auto it = std::upper_bound(mChunks.cbegin(), mChunks.cend(), offset, [](quint64 value, const DdbChunkInfo& chunk) {
+        return value < chunk.offset;
+    });
+    if (it == mChunks.cbegin()) {
+        return -1;
+    }
+    --it;
+    return offset < it->offset + it->size ? int(it - mChunks.cbegin()) : -1;
+}
@@ -0,0 +1,65 @@
+#ifndef DDBINDEX_H
+#define DDBINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QByteArray>
+
+#include "chunk/basechunk.h"
+
+// One top level chunk of a DDB
+struct DdbChunkInfo {
+    quint64 offset;
+    quint64 size;           // Extent in the file, header included
+    quint32 signature;      // FourCC as stored, see FourCC()
+    quint32 sampleCount;    // SND only
+};
+
+// Chunk boundaries of a DDB, built from its bytes in file order so it can be
+// fed by whatever reads the file (see DdbVerifier). Chunks follow each other
+// without gaps; SND extents come from their sample count, and a size field
+// that disagrees is reported. The walk stops at the first header that does
+// not look like a chunk, leaving the rest of the file unindexed.
+class DdbIndex
+{
+public:
+    static constexpr int SndHeaderSize = 0x12;
+
+    DdbIndex();
+
+    void reset(quint64 fileSize);
+    // Consecutive bytes of the file, starting at offset 0
+    void feed(const char* data, qint64 size);
+    void finish();
+
+    const QVector<DdbChunkInfo>& chunks() const { return mChunks; }
+    // Offset of the first byte not covered by a chunk, fileSize if none
+    quint64 indexedEnd() const { return mIndexedEnd; }
+    const QStringList& issues() const { return mIssues; }
+
+    // Index of the chunk containing offset, -1 if none
+    int find(quint64 offset) const;
+
+    static constexpr quint32 SndSignature = FourCC("SND ");
+    static constexpr quint32 FrameSignature = FourCC("FRM2");
+
+private:
+    // Parse the header at mNext, false when more bytes are needed or the walk is over
+    bool parseHeader(const char* header, qint64 available);
+    void addIssue(const QString& issue);
+    void stop(const QString& issue);
+
+private:
+    quint64 mFileSize;
+    quint64 mPos;           // File offset of the next fed byte
+    quint64 mNext;          // Offset of the next chunk header
+    quint64 mIndexedEnd;
+    bool mStopped;
+    QByteArray mCarry;      // Header split across two feeds
+    QVector<DdbChunkInfo> mChunks;
+    QStringList mIssues;
+    int mIssueCount;
+};
+
+#endif // DDBINDEX_H
@@ -0,0 +1,352 @@
+#include "ddblayoutexport.h"
+
+#include <QFile>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <algorithm>
+#include <numeric>
+#include <cstdio>
+#include <cstring>
+
+#include "chunk/basechunk.h"
+#include "chunk/chunkvisitor.h"
+#include "chunk/item_audioframerefs.h"
+#include "parser/ddi.h"
+#include "common.h"
+#include "perftrace.h"
+
+namespace {
+    // Written out whenever the buffer grows past this
+    constexpr int FlushSize = 4 << 20;
+    // Below this a single std::sort is faster than splitting
+    constexpr int MinParallelSort = 1 << 16;
+
+    bool RecordLess(const DdbLayoutRecord& a, const DdbLayoutRecord& b)
+    {
+        if (a.offset != b.offset) return a.offset < b.offset;
+        if (a.unit != b.unit) return a.unit < b.unit;
+        return a.frame < b.frame;
+    }
+
+    // Sort runs on the pool, then merge neighbouring runs pairwise
+    template<typename T, typename Less> void ParallelSort(QVector<T>& values, Less less)
+    {
+        const int parts = QThread::idealThreadCount();
+        if (values.size() < MinParallelSort || parts < 2) {
+            std::sort(values.begin(), values.end(), less);
+            return;
+        }
+
+        T* data = values.data();
+        QVector<qint64> bounds;
+        for (int i = 0; i <= parts; i++) {
+            bounds.append((qint64)values.size() * i / parts);
+        }
+        QVector<int> runs(parts);
+        std::iota(runs.begin(), runs.end(), 0);
+        QtConcurrent::blockingMap(runs, [&](int& run) {
+            std::sort(data + bounds[run], data + bounds[run + 1], less);
+        });
+
+        for (int width = 1; width < parts; width *= 2) {
+            QVector<int> merges;
+            for (int run = 0; run + width < parts; run += 2 * width) {
+                merges.append(run);
+            }
+            QtConcurrent::blockingMap(merges, [&](int& run) {
+                std::inplace_merge(data + bounds[run], data + bounds[run + width],
+                                   data + bounds[qMin(run + 2 * width, parts)], less);
+            });
+        }
+    }
+
+    template<typename T> void AppendLittleEndian(QByteArray& buffer, T value)
+    {
+        value = qToLittleEndian(value);
+        buffer.append((const char*)&value, sizeof(value));
+    }
+
+    void AppendHex(QByteArray& buffer, quint64 value)
+    {
+        char digits[16];
+        int n = 0;
+        do {
+            digits[n++] = "0123456789abcdef"[value & 0xF];
+            value >>= 4;
+        } while (value);
+        while (n) {
+            buffer.append(digits[--n]);
+        }
+    }
+
+    bool Flush(QFile& file, QByteArray& buffer)
+    {
+        if (file.write(buffer) != buffer.size()) {
+            return false;
+        }
+        buffer.clear();
+        return true;
+    }
+}
+
+void DdbLayoutExport::collect(BaseChunk* stationaryRoot, BaseChunk* articulationRoot)
+{
+    PERF_SCOPE("Collect DDB layout");
+    mUnits.clear();
+    mRecords.clear();
+
+    if (stationaryRoot) {
+        foreach (auto voiceColor, stationaryRoot->Children) {
+            foreach (auto staSeg, voiceColor->Children) {
+                const QString owner = voiceColor->GetName() + " > " + staSeg->GetName();
+                foreach (auto pitchSeg, staSeg->Children) {
+                    addPitch(pitchSeg, DdbLayoutUnit::Stationary, owner);
+                }
+            }
+        }
+    }
+
+    if (articulationRoot) {
+        foreach (auto beginPhoneme, articulationRoot->Children) {
+            foreach (auto endPhoneme, beginPhoneme->Children) {
+                if (endPhoneme->ObjectSignature() == "ART ") {
+                    foreach (auto thirdPhoneme, endPhoneme->Children) {
+                        const QString owner = QString("[%1 ~ %2 ~ %3]").arg(beginPhoneme->GetName(),
+                                                                            endPhoneme->GetName(),
+                                                                            thirdPhoneme->GetName());
+                        foreach (auto pitchSeg, thirdPhoneme->Children) {
+                            addPitch(pitchSeg, DdbLayoutUnit::Triphone, owner);
+                        }
+                    }
+                    continue;
+                }
+                const QString owner = QString("[%1 ~ %2]").arg(beginPhoneme->GetName(), endPhoneme->GetName());
+                foreach (auto pitchSeg, endPhoneme->Children) {
+                    addPitch(pitchSeg, DdbLayoutUnit::Articulation, owner);
+                }
+            }
+        }
+    }
+}
+
+// Pitch segments are taken as they are left, the names of the arrays
+// around them only come once those are left too: every unit collects them
+// on its way out, and is labelled or dropped when the whole DDI is read
+class DdbLayoutExport::Visitor : public ChunkVisitor
+{
+public:
+    explicit Visitor(DdbLayoutExport& layout) : mLayout(layout) { }
+
+    void onEnterChunk(const QByteArray& signature, uint64_t offset) override
+    {
+        mFirstUnit.append(mPaths.size());
+    }
+
+    void onLeave(BaseChunk* chunk) override
+    {
+        const QString name = chunk->GetName();
+        for (int i = mFirstUnit.takeLast(); i < mPaths.size(); i++) {
+            mPaths[i].prepend(name);
+        }
+        const QByteArray signature = chunk->ObjectSignature();
+        if (signature == "STAp" || signature == "ARTp") {
+            mLayout.addUnit(chunk);
+            mPaths.append(QStringList(name));
+        }
+    }
+
+    // Paths run from the root: root, voice, stationary, color, segment, pitch
+    // or root, voice, articulation, begin, end, [third,] pitch
+    void resolve()
+    {
+        QVector<quint32> remap(mPaths.size(), Dropped);
+        QVector<DdbLayoutUnit> units;
+        for (int i = 0; i < mPaths.size(); i++) {
+            const auto& path = mPaths[i];
+            if (path.size() < 6 || path[1] != "voice") {
+                continue;
+            }
+            DdbLayoutUnit unit = mLayout.mUnits[i];
+            QString owner;
+            if (path[2] == "stationary" && path.size() == 6) {
+                unit.kind = DdbLayoutUnit::Stationary;
+                owner = path[3] + " > " + path[4];
+            } else if (path[2] == "articulation" && path.size() == 6) {
+                unit.kind = DdbLayoutUnit::Articulation;
+                owner = QString("[%1 ~ %2]").arg(path[3], path[4]);
+            } else if (path[2] == "articulation" && path.size() == 7) {
+                unit.kind = DdbLayoutUnit::Triphone;
+                owner = QString("[%1 ~ %2 ~ %3]").arg(path[3], path[4], path[5]);
+            } else {
+                continue;
+            }
+            unit.label = Label(unit.kind, owner, path.last(), unit.pitch);
+            remap[i] = units.size();
+            units.append(unit);
+        }
+
+        auto& records = mLayout.mRecords;
+        auto kept = std::remove_if(records.begin(), records.end(), [&](DdbLayoutRecord& record) {
+            record.unit = remap[record.unit];
+            return record.unit == Dropped;
+        });
+        records.erase(kept, records.end());
+        mLayout.mUnits = units;
+    }
+
+private:
+    static constexpr quint32 Dropped = ~0u;
+
+    DdbLayoutExport& mLayout;
+    QVector<int> mFirstUnit;        // first unit inside each chunk being read
+    QVector<QStringList> mPaths;    // names around each unit, innermost last
+};
+
+bool DdbLayoutExport::collect(const QString& ddiPath)
+{
+    PERF_SCOPE("Collect DDB layout from events");
+    mUnits.clear();
+    mRecords.clear();
+    mError.clear();
+
+    Visitor visitor(*this);
+    if (!ParseDdiEvents(ddiPath, &visitor, mError)) {
+        return false;
+    }
+    visitor.resolve();
+    return true;
+}
+
+void DdbLayoutExport::addPitch(BaseChunk* pitchSeg, DdbLayoutUnit::Kind kind, const QString& owner)
+{
+    auto& unit = mUnits[addUnit(pitchSeg)];
+    unit.kind = kind;
+    unit.label = Label(kind, owner, pitchSeg->GetName(), unit.pitch);
+}
+
+QByteArray DdbLayoutExport::Label(DdbLayoutUnit::Kind kind, const QString& owner, const QString& pitchName, float pitch)
+{
+    const QString note = Common::RelativePitchToNoteName(pitch);
+    QString label;
+    switch (kind) {
+    case DdbLayoutUnit::Stationary:
+        label = "Stationary " + owner + " (" + pitchName + ") @ " + note;
+        break;
+    case DdbLayoutUnit::Articulation:
+        label = "Articulation " + pitchName + " > " + owner + " @ " + note;
+        break;
+    case DdbLayoutUnit::Triphone:
+        label = "Triphone Articulation " + pitchName + " > " + owner + " @ " + note;
+        break;
+    }
+    return label.replace(QLatin1String(","), QLatin1String("\\,")).toUtf8();
+}
+
+quint32 DdbLayoutExport::addUnit(BaseChunk* pitchSeg)
+{
+    DdbLayoutUnit unit;
+    unit.kind = DdbLayoutUnit::Stationary;
+    STUFF_INTO(pitchSeg->GetProperty("mPitch").data, unit.pitch, float);
+
+    const quint32 unitIndex = mUnits.size();
+    mUnits.append(unit);
+
+    if (auto frameRefs = dynamic_cast<ItemAudioFrameRefs*>(pitchSeg->GetChildByName("<Frames>"))) {
+        const auto& offsets = frameRefs->Offsets();
+        for (int frame = 0; frame < offsets.size(); frame++) {
+            mRecords.append(DdbLayoutRecord{ offsets[frame], unitIndex, frame });
+        }
+    }
+
+    quint64 offset;
+    STUFF_INTO(pitchSeg->GetProperty("SND Sample offset").data, offset, quint64);
+    mRecords.append(DdbLayoutRecord{ offset, unitIndex, -1 });
+    return unitIndex;
+}
+
+void DdbLayoutExport::sort()
+{
+    PERF_SCOPE("Sort DDB layout");
+    ParallelSort(mRecords, RecordLess);
+}
+
+bool DdbLayoutExport::writeCsv(const QString& path)
+{
+    PERF_SCOPE("Write DDB layout CSV");
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        mError = "Cannot write " + path;
+        return false;
+    }
+
+    QByteArray buffer;
+    buffer.reserve(FlushSize + 4096);
+    char frameName[24];
+    bool ok = true;
+    foreach (const auto& record, mRecords) {
+        buffer.append('\'');
+        AppendHex(buffer, record.offset);
+        buffer.append(',');
+        buffer.append(mUnits[record.unit].label);
+        if (record.frame < 0) {
+            buffer.append(" Sound,\n");
+        } else {
+            int n = std::snprintf(frameName, sizeof(frameName), " Frame %05d,\n", record.frame);
+            buffer.append(frameName, n);
+        }
+        if (buffer.size() >= FlushSize && !(ok = Flush(file, buffer))) {
+            break;
+        }
+    }
+    if (!ok || !Flush(file, buffer)) {
+        mError = "Cannot write " + path + ": " + file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool DdbLayoutExport::writeBinary(const QString& path)
+{
+    PERF_SCOPE("Write DDB layout binary");
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        mError = "Cannot write " + path;
+        return false;
+    }
+
+    QByteArray buffer("DDBL");
+    buffer.reserve(FlushSize + 4096);
+    AppendLittleEndian<quint32>(buffer, BinaryVersion);
+    AppendLittleEndian<quint32>(buffer, mUnits.size());
+    AppendLittleEndian<quint64>(buffer, mRecords.size());
+
+    bool ok = true;
+    foreach (const auto& unit, mUnits) {
+        buffer.append((char)unit.kind);
+        quint32 pitchBits;
+        memcpy(&pitchBits, &unit.pitch, sizeof(pitchBits));
+        AppendLittleEndian<quint32>(buffer, pitchBits);
+        AppendLittleEndian<quint32>(buffer, unit.label.size());
+        buffer.append(unit.label);
+        if (buffer.size() >= FlushSize && !(ok = Flush(file, buffer))) {
+            break;
+        }
+    }
+    foreach (const auto& record, mRecords) {
+        if (!ok) {
+            break;
+        }
+        AppendLittleEndian<quint64>(buffer, record.offset);
+        AppendLittleEndian<quint32>(buffer, record.unit);
+        AppendLittleEndian<qint32>(buffer, record.frame);
+        if (buffer.size() >= FlushSize) {
+            ok = Flush(file, buffer);
+        }
+    }
+    if (!ok || !Flush(file, buffer)) {
+        mError = "Cannot write " + path + ": " + file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef DDBLAYOUTEXPORT_H
+#define DDBLAYOUTEXPORT_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+
+class BaseChunk;
+
+// A pitch segment of the tree, shared by all of its records
+struct DdbLayoutUnit {
+    enum Kind : quint8 { Stationary, Articulation, Triphone };
+    Kind kind;
+    float pitch;            // Relative, in cents from A4
+    QByteArray label;       // UTF-8 description, commas already escaped for CSV
+};
+
+// One DDB offset referenced by the tree
+struct DdbLayoutRecord {
+    quint64 offset;
+    quint32 unit;           // Index into DdbLayoutExport::units()
+    qint32 frame;           // Frame index, -1 for the SND
+};
+
+// Layout of a DDB as referenced by the stationary and articulation trees.
+// Records stay plain values until written: they are sorted in parallel and
+// formatted straight into large buffers, one label per unit.
+// The binary form is little endian:
+//   "DDBL", u32 version, u32 unit count, u64 record count,
+//   units as u8 kind, f32 pitch, u32 label size, label,
+//   records as u64 offset, u32 unit, i32 frame.
+class DdbLayoutExport
+{
+public:
+    static constexpr quint32 BinaryVersion = 1;
+
+    void collect(BaseChunk* stationaryRoot, BaseChunk* articulationRoot);
+    // Same as above, reading the DDI as events rather than from a tree
+    bool collect(const QString& ddiPath);
+    // By offset, then unit and frame
+    void sort();
+
+    // "'offset,description," lines, as the layout export always wrote
+    bool writeCsv(const QString& path);
+    bool writeBinary(const QString& path);
+
+    const QVector<DdbLayoutUnit>& units() const { return mUnits; }
+    const QVector<DdbLayoutRecord>& records() const { return mRecords; }
+    QString getError() const { return mError; }
+
+private:
+    class Visitor;
+
+    // Owner is the segment above the pitch, "color > segment" or "[a ~ b]"
+    void addPitch(BaseChunk* pitchSeg, DdbLayoutUnit::Kind kind, const QString& owner);
+    // Unit of the pitch segment with its records, labelled later
+    quint32 addUnit(BaseChunk* pitchSeg);
+    static QByteArray Label(DdbLayoutUnit::Kind kind, const QString& owner, const QString& pitchName, float pitch);
+
+private:
+    QVector<DdbLayoutUnit> mUnits;
+    QVector<DdbLayoutRecord> mRecords;
+    QString mError;
+};
+
+#endif // DDBLAYOUTEXPORT_H
@@ -0,0 +1,263 @@
+#include "ddblayoutoptimizer.h"
+
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QTextStream>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <algorithm>
+
+namespace {
+    constexpr int MaxUnknownSamples = 20;
+
+    QJsonObject CostToJson(const DdbAccessCost& cost)
+    {
+        return QJsonObject{
+            { "reads", (qint64)cost.reads },
+            { "seeks", (qint64)cost.seeks },
+            { "seekBytes", (qint64)cost.seekBytes },
+            { "pages", (qint64)cost.pages },
+        };
+    }
+
+    // Percentage saved from before to after, negative if it got worse
+    double Reduction(quint64 before, quint64 after)
+    {
+        return before ? 100.0 * ((double)before - (double)after) / before : 0.0;
+    }
+}
+
+DdbLayoutOptimizer::DdbLayoutOptimizer(const DdiReferences& references) :
+    mReferences(references),
+    mUnknownCount(0)
+{
+    const auto& refs = mReferences.references();
+    mOwnerRefs.resize(mReferences.owners().size());
+    for (int i = 0; i < refs.size(); i++) {
+        mOwnerRefs[refs[i].owner].append(i);
+    }
+}
+
+bool DdbLayoutOptimizer::loadTrace(const QString& path)
+{
+    mSequences.clear();
+    mUnknownCount = 0;
+    mUnknownSamples.clear();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        mError = "Cannot open " + path;
+        return false;
+    }
+
+    // Owner paths start with the root chunk name, which traces may leave out
+    const auto& owners = mReferences.owners();
+    QHash<QString, int> ownerByPath;
+    for (int i = 0; i < owners.size(); i++) {
+        ownerByPath.insert(owners[i], i);
+        ownerByPath.insert(owners[i].section('/', 1), i);
+    }
+
+    QTextStream stream(&file);
+    QVector<int> sequence;
+    while (!stream.atEnd()) {
+        QString line = stream.readLine().trimmed();
+        if (line.startsWith('#')) {
+            continue;
+        }
+        if (line.isEmpty()) {
+            if (!sequence.isEmpty()) {
+                mSequences.append(sequence);
+                sequence.clear();
+            }
+            continue;
+        }
+        if (line.startsWith('/')) {
+            line.remove(0, 1);
+        }
+        int owner = ownerByPath.value(line, -1);
+        if (owner < 0) {
+            if (mUnknownSamples.size() < MaxUnknownSamples) {
+                mUnknownSamples.append(line);
+            }
+            mUnknownCount++;
+            continue;
+        }
+        sequence.append(owner);
+    }
+    if (!sequence.isEmpty()) {
+        mSequences.append(sequence);
+    }
+
+    if (mSequences.isEmpty()) {
+        mError = path + " holds no unit of the opened DDI";
+        return false;
+    }
+    return true;
+}
+
+int DdbLayoutOptimizer::tracedOwners() const
+{
+    QSet<int> owners;
+    foreach (const auto& sequence, mSequences) {
+        foreach (int owner, sequence) {
+            owners.insert(owner);
+        }
+    }
+    return owners.size();
+}
+
+QVector<int> DdbLayoutOptimizer::computeOrder() const
+{
+    const int ownerCount = mOwnerRefs.size();
+    QVector<quint64> heat(ownerCount, 0);
+    QHash<quint64, quint64> pairWeights;
+    foreach (const auto& sequence, mSequences) {
+        for (int i = 0; i < sequence.size(); i++) {
+            heat[sequence[i]]++;
+            if (i == 0 || sequence[i] == sequence[i - 1]) {
+                continue;
+            }
+            quint64 a = qMin(sequence[i], sequence[i - 1]), b = qMax(sequence[i], sequence[i - 1]);
+            pairWeights[a << 32 | b]++;
+        }
+    }
+
+    struct Pair {
+        int a, b;
+        quint64 weight;
+    };
+    QVector<Pair> pairs;
+    pairs.reserve(pairWeights.size());
+    for (auto it = pairWeights.cbegin(); it != pairWeights.cend(); ++it) {
+        pairs.append(Pair{ (int)(it.key() >> 32), (int)(it.key() & 0xFFFFFFFF), it.value() });
+    }
+    // Heaviest first, the rest only keeps the result stable
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& x, const Pair& y) {
+        if (x.weight != y.weight) return x.weight > y.weight;
+        if (x.a != y.a) return x.a < y.a;
+        return x.b < y.b;
+    });
+
+    // Every traced owner starts as a chain of its own
+    QVector<QVector<int>> chains(ownerCount);
+    QVector<int> chainOf(ownerCount, -1);
+    for (int owner = 0; owner < ownerCount; owner++) {
+        if (heat[owner]) {
+            chains[owner].append(owner);
+            chainOf[owner] = owner;
+        }
+    }
+
+    foreach (const auto& pair, pairs) {
+        int first = chainOf[pair.a], second = chainOf[pair.b];
+        if (first == second) {
+            continue;
+        }
+        // Turn the chains so the pair meets in the middle where it can
+        auto& head = chains[first];
+        auto& tail = chains[second];
+        if (head.first() == pair.a && head.last() != pair.a) {
+            std::reverse(head.begin(), head.end());
+        }
+        if (tail.last() == pair.b && tail.first() != pair.b) {
+            std::reverse(tail.begin(), tail.end());
+        }
+        foreach (int owner, tail) {
+            chainOf[owner] = first;
+        }
+        head += tail;
+        tail.clear();
+    }
+
+    struct Chain {
+        int id;
+        quint64 heat;
+    };
+    QVector<Chain> hottest;
+    for (int id = 0; id < ownerCount; id++) {
+        if (chains[id].isEmpty()) {
+            continue;
+        }
+        quint64 chainHeat = 0;
+        foreach (int owner, chains[id]) {
+            chainHeat += heat[owner];
+        }
+        hottest.append(Chain{ id, chainHeat });
+    }
+    std::stable_sort(hottest.begin(), hottest.end(), [](const Chain& x, const Chain& y) {
+        return x.heat > y.heat;
+    });
+
+    QVector<int> order;
+    foreach (const auto& chain, hottest) {
+        order += chains[chain.id];
+    }
+    return order;
+}
+
+DdbAccessCost DdbLayoutOptimizer::replay(const QVector<DdbChunkInfo>& chunks, const QVector<quint64>& offsets,
+                                         const QVector<int>& refChunks) const
+{
+    DdbAccessCost cost;
+    QSet<quint64> pages;
+    foreach (const auto& sequence, mSequences) {
+        pages.clear();
+        quint64 position = 0;
+        int lastChunk = -1;
+        bool first = true;
+        foreach (int owner, sequence) {
+            foreach (int ref, mOwnerRefs[owner]) {
+                const int chunk = refChunks[ref];
+                if (chunk == lastChunk) {
+                    continue;   // Playback offset into the same SND
+                }
+                lastChunk = chunk;
+
+                const quint64 offset = offsets[chunk], size = chunks[chunk].size;
+                cost.reads++;
+                if (first || offset != position) {
+                    cost.seeks++;
+                    if (!first) {
+                        cost.seekBytes += offset > position ? offset - position : position - offset;
+                    }
+                }
+                first = false;
+                position = offset + size;
+
+                for (quint64 page = offset / PageSize; page <= (position - 1) / PageSize; page++) {
+                    pages.insert(page);
+                }
+            }
+        }
+        cost.pages += pages.size();
+    }
+    return cost;
+}
+
+bool DdbLayoutOptimizer::writeReport(const QString& reportPath, const QString& tracePath,
+                                     const DdbLayoutOptimizer& optimizer,
+                                     const DdbAccessCost& before, const DdbAccessCost& after)
+{
+    QJsonObject root{
+        { "trace", tracePath },
+        { "sequences", optimizer.sequenceCount() },
+        { "tracedUnits", optimizer.tracedOwners() },
+        { "unknownUnits", optimizer.unknownUnits() },
+        { "unknownSamples", QJsonArray::fromStringList(optimizer.unknownSamples()) },
+        { "pageSize", PageSize },
+        { "before", CostToJson(before) },
+        { "after", CostToJson(after) },
+        { "seekReduction", Reduction(before.seeks, after.seeks) },
+        { "seekDistanceReduction", Reduction(before.seekBytes, after.seekBytes) },
+        { "pageFaultReduction", Reduction(before.pages, after.pages) },
+    };
+
+    QFile file(reportPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    return file.write(QJsonDocument(root).toJson()) >= 0;
+}
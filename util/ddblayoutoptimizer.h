@@ -0,0 +1,64 @@
+#ifndef DDBLAYOUTOPTIMIZER_H
+#define DDBLAYOUTOPTIMIZER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "ddbindex.h"
+#include "ddireferences.h"
+
+// Estimated cost of reading the traced sequences from a DDB layout, each
+// sequence starting from a cold cache
+struct DdbAccessCost {
+    quint64 reads = 0;
+    quint64 seeks = 0;      // Reads not starting where the previous one ended
+    quint64 seekBytes = 0;  // Distance covered by those seeks
+    quint64 pages = 0;      // Distinct pages touched, i.e. page faults
+};
+
+// Orders the units of a DDI so that units used together end up next to each
+// other in the DDB, from a trace of unit sequences as the engine reads them.
+// A unit is a reference owner (see DdiReferences::owners()), named in the
+// trace by its tree path, one per line, with or without the root chunk name.
+// Blank lines separate sequences and '#' starts a comment.
+// Units following each other in a sequence are weighed by how often they do,
+// and chains are built greedily from the heaviest pairs (Pettis-Hansen style),
+// hottest chain first. The order feeds DdbCompactor::setOwnerOrder.
+class DdbLayoutOptimizer
+{
+public:
+    static constexpr int PageSize = 4096;
+
+    explicit DdbLayoutOptimizer(const DdiReferences& references);
+
+    bool loadTrace(const QString& path);
+
+    // Traced owners in layout order, the others are left to the compactor
+    QVector<int> computeOrder() const;
+
+    // Replay the trace against a layout: the chunks of the DDB and the offset
+    // each one has in it, with the chunk of every reference
+    DdbAccessCost replay(const QVector<DdbChunkInfo>& chunks, const QVector<quint64>& offsets,
+                         const QVector<int>& refChunks) const;
+
+    int sequenceCount() const { return mSequences.size(); }
+    int tracedOwners() const;
+    int unknownUnits() const { return mUnknownCount; }
+    // The first few names in the trace that are not units of the tree
+    const QStringList& unknownSamples() const { return mUnknownSamples; }
+    QString getError() const { return mError; }
+
+    static bool writeReport(const QString& reportPath, const QString& tracePath, const DdbLayoutOptimizer& optimizer,
+                            const DdbAccessCost& before, const DdbAccessCost& after);
+
+private:
+    const DdiReferences& mReferences;
+    QVector<QVector<int>> mOwnerRefs;   // References of each owner, in tree order
+    QVector<QVector<int>> mSequences;   // Owners
+    int mUnknownCount;
+    QStringList mUnknownSamples;
+    QString mError;
+};
+
+#endif // DDBLAYOUTOPTIMIZER_H
@@ -0,0 +1,100 @@
+#include "ddbmap.h"
+
+#include <QFile>
+#include <QHash>
+#include <algorithm>
+
+#include "ddireferences.h"
+
+bool DdbMap::build(const QString& ddbPath, const DdiReferences& references, const Progress& progress)
+{
+    mSpans.clear();
+    mError.clear();
+
+    QFile ddb(ddbPath);
+    if (!ddb.open(QIODevice::ReadOnly)) {
+        mError = "Cannot open " + ddbPath;
+        return false;
+    }
+    mFileSize = ddb.size();
+
+    DdbIndex index;
+    index.reset(mFileSize);
+    for (quint64 done = 0; done < mFileSize; ) {
+        if (progress && !progress(done, mFileSize)) {
+            mError = "Cancelled";
+            return false;
+        }
+        QByteArray block = ddb.read(qMin<quint64>(BlockSize, mFileSize - done));
+        if (block.isEmpty()) {
+            mError = QString("Cannot read %1 at 0x%2").arg(ddbPath).arg(done, 0, 16);
+            return false;
+        }
+        index.feed(block.constData(), block.size());
+        done += block.size();
+    }
+    index.finish();
+
+    // "root/voice/stationary/<voice colour>/..", "root/voice/articulation/<phoneme>/.."
+    mOwners = references.owners();
+    mGroups.clear();
+    mOwnerGroups.resize(mOwners.size());
+    QHash<QString, int> groupIds;
+    for (int i = 0; i < mOwners.size(); i++) {
+        QString group = mOwners[i].section('/', 2, 3);
+        auto it = groupIds.constFind(group);
+        if (it == groupIds.cend()) {
+            it = groupIds.insert(group, mGroups.size());
+            mGroups.append(group);
+        }
+        mOwnerGroups[i] = *it;
+    }
+
+    const auto& chunks = index.chunks();
+    QVector<qint32> chunkOwners(chunks.size(), -1);
+    foreach (const auto& ref, references.references()) {
+        int chunk = index.find(ref.target);
+        if (chunk >= 0 && chunkOwners[chunk] < 0) {
+            chunkOwners[chunk] = ref.owner;
+        }
+    }
+
+    mSpans.reserve(chunks.size() + 1);
+    for (int i = 0; i < chunks.size(); i++) {
+        DdbMapSpan::Kind kind = DdbMapSpan::Orphan;
+        if (chunkOwners[i] >= 0) {
+            kind = chunks[i].signature == DdbIndex::SndSignature ? DdbMapSpan::Sound
+                 : chunks[i].signature == DdbIndex::FrameSignature ? DdbMapSpan::Frame
+                 : DdbMapSpan::OtherChunk;
+        }
+        mSpans.append(DdbMapSpan{ chunks[i].offset, chunks[i].size, kind, chunkOwners[i] });
+    }
+    if (index.indexedEnd() < mFileSize) {
+        mSpans.append(DdbMapSpan{ index.indexedEnd(), mFileSize - index.indexedEnd(), DdbMapSpan::Gap, -1 });
+    }
+    return true;
+}
+
+int DdbMap::find(quint64 offset) const
+{
+    auto it = std::upper_bound(mSpans.cbegin(), mSpans.cend(), offset, [](quint64 value, const DdbMapSpan& span) {
+        return value < span.offset;
+    });
+    if (it == mSpans.cbegin()) {
+        return -1;
+    }
+    --it;
+    return offset < it->offset + it->size ? int(it - mSpans.cbegin()) : -1;
+}
+
+QString DdbMap::KindName(DdbMapSpan::Kind kind)
+{
+    switch (kind) {
+    case DdbMapSpan::Sound: return "SND";
+    case DdbMapSpan::Frame: return "FRM2";
+    case DdbMapSpan::OtherChunk: return "Other chunk";
+    case DdbMapSpan::Orphan: return "Orphan";
+    case DdbMapSpan::Gap: return "Unindexed";
+    }
+    return QString();
+}
@@ -0,0 +1,57 @@
+#ifndef DDBMAP_H
+#define DDBMAP_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+
+#include "ddbindex.h"
+
+class DdiReferences;
+
+// Contiguous region of a DDB as the map shows it
+struct DdbMapSpan {
+    enum Kind : quint8 { Sound, Frame, OtherChunk, Orphan, Gap };
+    quint64 offset;
+    quint64 size;
+    Kind kind;
+    qint32 owner;           // First owner referring to it, -1 if none
+};
+
+// Occupancy of a whole DDB: every indexed chunk, whether and by which unit
+// it is referenced, and the unindexed tail. Owners are grouped by voice
+// colour (stationaries) or leading phoneme (articulations) for colouring.
+// Read only once built, so tile renderers may share it across threads.
+class DdbMap
+{
+public:
+    // Return false to cancel
+    typedef std::function<bool(quint64 done, quint64 total)> Progress;
+
+    static constexpr qint64 BlockSize = 8 << 20;
+
+    bool build(const QString& ddbPath, const DdiReferences& references, const Progress& progress = Progress());
+
+    quint64 fileSize() const { return mFileSize; }
+    const QVector<DdbMapSpan>& spans() const { return mSpans; }
+    // Index of the span containing offset, -1 past the end
+    int find(quint64 offset) const;
+
+    const QStringList& owners() const { return mOwners; }
+    const QStringList& groups() const { return mGroups; }
+    int ownerGroup(int owner) const { return owner < 0 ? -1 : mOwnerGroups[owner]; }
+
+    static QString KindName(DdbMapSpan::Kind kind);
+    QString getError() const { return mError; }
+
+private:
+    quint64 mFileSize = 0;
+    QVector<DdbMapSpan> mSpans;
+    QStringList mOwners;
+    QStringList mGroups;
+    QVector<int> mOwnerGroups;
+    QString mError;
+};
+
+#endif // DDBMAP_H
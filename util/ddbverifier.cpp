@@ -0,0 +1,214 @@
+#include "ddbverifier.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <deque>
+
+#include "perftrace.h"
+
+namespace {
+    // Every block opens its own handle, so reads never share a file position
+    QByteArray ReadBlock(const QString& path, quint64 offset, qint64 size)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly) || !file.seek(offset)) {
+            return QByteArray();
+        }
+        return file.read(size);
+    }
+}
+
+DdbVerifier::DdbVerifier() :
+    mReadAhead(0)
+{
+}
+
+QByteArray DdbVerifier::ParseHashStore(const QByteArray& hashStore)
+{
+    int end = hashStore.indexOf('\0');
+    QByteArray hash = (end < 0 ? hashStore : hashStore.left(end)).trimmed().toLower();
+    return hash;
+}
+
+bool DdbVerifier::verify(const QString& ddbPath, const QByteArray& hashStore, const DdiReferences& references,
+                         DdbVerifyResult& result, const Progress& progress)
+{
+    PERF_SCOPE("Verify DDB");
+    QElapsedTimer timer;
+    timer.start();
+
+    result = DdbVerifyResult();
+    mError.clear();
+
+    QFileInfo info(ddbPath);
+    if (!info.isFile()) {
+        mError = "Cannot find " + ddbPath;
+        return false;
+    }
+    const quint64 total = info.size();
+    result.ddbSize = total;
+    result.storedHash = ParseHashStore(hashStore);
+    mIndex.reset(total);
+
+    const int readAhead = mReadAhead > 0 ? mReadAhead : qBound(2, QThread::idealThreadCount(), 8);
+    std::deque<QFuture<QByteArray>> inFlight;
+    quint64 requested = 0, done = 0;
+    QCryptographicHash md4(QCryptographicHash::Md4);
+    bool ok = true;
+
+    while (done < total) {
+        while (requested < total && (int)inFlight.size() < readAhead) {
+            qint64 size = qMin<quint64>(BlockSize, total - requested);
+            inFlight.push_back(QtConcurrent::run(ReadBlock, ddbPath, requested, size));
+            requested += size;
+        }
+
+        if (progress && !progress(done, total)) {
+            mError = "Verification cancelled";
+            ok = false;
+            break;
+        }
+
+        QByteArray block = inFlight.front().result();
+        inFlight.pop_front();
+        qint64 expected = qMin<quint64>(BlockSize, total - done);
+        if (block.size() != expected) {
+            mError = QString("Cannot read %1 at 0x%2").arg(ddbPath).arg(done, 0, 16);
+            ok = false;
+            break;
+        }
+
+        md4.addData(block);
+        mIndex.feed(block.constData(), block.size());
+        done += block.size();
+    }
+
+    for (auto& future : inFlight) {
+        future.waitForFinished();
+    }
+    if (!ok) {
+        return false;
+    }
+
+    mIndex.finish();
+    result.actualHash = md4.result().toHex();
+    result.hashMatches = !result.storedHash.isEmpty() && result.storedHash == result.actualHash;
+    result.chunkCount = mIndex.chunks().size();
+    result.indexIssues = mIndex.issues();
+
+    checkReferences(references, result);
+    result.elapsedMs = timer.elapsed();
+    return true;
+}
+
+void DdbVerifier::checkReferences(const DdiReferences& references, DdbVerifyResult& result)
+{
+    const auto& chunks = mIndex.chunks();
+    const auto& refs = references.references();
+    QVector<bool> referenced(chunks.size(), false);
+    result.referenceCount = refs.size();
+
+    for (int i = 0; i < refs.size(); i++) {
+        const auto& ref = refs[i];
+        if (ref.target >= result.ddbSize) {
+            result.badReferences.append(DdbReferenceIssue{ i, "Outside of the DDB" });
+            continue;
+        }
+        int chunk = mIndex.find(ref.target);
+        if (chunk < 0) {
+            result.badReferences.append(DdbReferenceIssue{ i, "Not in an indexed chunk" });
+            continue;
+        }
+
+        const auto& info = chunks[chunk];
+        const quint32 wanted = ref.kind == DdiReference::Frame ? DdbIndex::FrameSignature : DdbIndex::SndSignature;
+        if (info.signature != wanted) {
+            result.badReferences.append(DdbReferenceIssue{ i, QString("Points into %1 at 0x%2")
+                                                 .arg(FourCCName(info.signature))
+                                                 .arg(info.offset, 0, 16) });
+            continue;
+        }
+        // Frames are referred to by their start, sounds anywhere in their samples
+        if (ref.kind == DdiReference::Frame && ref.target != info.offset) {
+            result.badReferences.append(DdbReferenceIssue{ i, QString("Inside FRM2 at 0x%1, not at its start").arg(info.offset, 0, 16) });
+            continue;
+        }
+        referenced[chunk] = true;
+    }
+
+    // Coalesce runs of unreferenced chunks
+    for (int i = 0; i < chunks.size(); i++) {
+        if (referenced[i]) {
+            continue;
+        }
+        if (!result.orphans.isEmpty() && result.orphans.last().chunks > 0 &&
+            result.orphans.last().offset + result.orphans.last().size == chunks[i].offset) {
+            result.orphans.last().size += chunks[i].size;
+            result.orphans.last().chunks++;
+        } else {
+            result.orphans.append(DdbRegion{ chunks[i].offset, chunks[i].size, 1 });
+        }
+        result.orphanBytes += chunks[i].size;
+    }
+    if (mIndex.indexedEnd() < result.ddbSize) {
+        quint64 size = result.ddbSize - mIndex.indexedEnd();
+        result.orphans.append(DdbRegion{ mIndex.indexedEnd(), size, 0 });
+        result.orphanBytes += size;
+    }
+}
+
+bool DdbVerifier::writeReport(const QString& reportPath, const QString& ddbPath,
+                              const DdbVerifyResult& result, const DdiReferences& references)
+{
+    QJsonArray badReferences;
+    foreach (const auto& issue, result.badReferences) {
+        const auto& ref = references.references()[issue.reference];
+        badReferences.append(QJsonObject{
+            { "owner", references.owners()[ref.owner] },
+            { "kind", DdiReferences::KindName(ref.kind) },
+            { "target", QString::number(ref.target, 16) },
+            { "ddiField", QString::number(ref.field, 16) },
+            { "reason", issue.reason },
+        });
+    }
+
+    QJsonArray orphans;
+    foreach (const auto& region, result.orphans) {
+        orphans.append(QJsonObject{
+            { "offset", QString::number(region.offset, 16) },
+            { "size", (qint64)region.size },
+            { "chunks", region.chunks },
+        });
+    }
+
+    double seconds = result.elapsedMs / 1000.0;
+    QJsonObject root{
+        { "ddb", ddbPath },
+        { "size", (qint64)result.ddbSize },
+        { "storedHash", QString::fromLatin1(result.storedHash) },
+        { "actualHash", QString::fromLatin1(result.actualHash) },
+        { "hashMatches", result.hashMatches },
+        { "chunks", result.chunkCount },
+        { "references", result.referenceCount },
+        { "badReferences", badReferences },
+        { "orphanBytes", (qint64)result.orphanBytes },
+        { "orphans", orphans },
+        { "indexIssues", QJsonArray::fromStringList(result.indexIssues) },
+        { "elapsedMs", result.elapsedMs },
+        { "mbPerSecond", seconds > 0 ? result.ddbSize / 1048576.0 / seconds : 0.0 },
+    };
+
+    QFile file(reportPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    return file.write(QJsonDocument(root).toJson()) >= 0;
+}
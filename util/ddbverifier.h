@@ -0,0 +1,81 @@
+#ifndef DDBVERIFIER_H
+#define DDBVERIFIER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QByteArray>
+#include <functional>
+
+#include "ddbindex.h"
+#include "ddireferences.h"
+
+// DDI reference that does not land where it should
+struct DdbReferenceIssue {
+    int reference;          // Index into DdiReferences::references()
+    QString reason;
+};
+
+// Bytes of the DDB no DDI reference points into
+struct DdbRegion {
+    quint64 offset;
+    quint64 size;
+    int chunks;             // 0 for bytes that are not even indexed
+};
+
+struct DdbVerifyResult {
+    quint64 ddbSize = 0;
+    QByteArray storedHash;  // From the DDI HashStore, empty when there is none
+    QByteArray actualHash;  // Hex MD4 of the DDB
+    bool hashMatches = false;
+    int chunkCount = 0;
+    int referenceCount = 0;
+    QVector<DdbReferenceIssue> badReferences;
+    QVector<DdbRegion> orphans;
+    quint64 orphanBytes = 0;
+    QStringList indexIssues;
+    qint64 elapsedMs = 0;
+};
+
+// Checks a DDB against its DDI: the MD4 in HashStore, every SND and frame
+// reference against the actual chunk boundaries and signatures, and regions
+// nothing refers to.
+// The file is read once in large blocks by pool threads, several blocks ahead,
+// while the calling thread hashes and indexes them in order, so the MD4 runs
+// back to back instead of waiting on each read.
+class DdbVerifier
+{
+public:
+    // Return false to cancel
+    typedef std::function<bool(quint64 done, quint64 total)> Progress;
+
+    static constexpr qint64 BlockSize = 8 << 20;
+    static constexpr int HashStoreSize = 260;
+
+    DdbVerifier();
+
+    // Blocks read ahead of the hash, 0 picks from the ideal thread count
+    void setReadAhead(int blocks) { mReadAhead = blocks; }
+
+    bool verify(const QString& ddbPath, const QByteArray& hashStore, const DdiReferences& references,
+                DdbVerifyResult& result, const Progress& progress = Progress());
+
+    const DdbIndex& index() const { return mIndex; }
+    QString getError() const { return mError; }
+
+    // Hex hash held by a HashStore property, empty if it holds none
+    static QByteArray ParseHashStore(const QByteArray& hashStore);
+
+    static bool writeReport(const QString& reportPath, const QString& ddbPath,
+                            const DdbVerifyResult& result, const DdiReferences& references);
+
+private:
+    void checkReferences(const DdiReferences& references, DdbVerifyResult& result);
+
+private:
+    int mReadAhead;
+    DdbIndex mIndex;
+    QString mError;
+};
+
+#endif // DDBVERIFIER_H
@@ -0,0 +1,428 @@
+#include "ddidiff.h"
+
+#include <QFile>
+#include <QHash>
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <algorithm>
+#include <numeric>
+
+#include "chunk/basechunk.h"
+#include "chunk/propertytype.h"
+#include "ddireferences.h"
+
+namespace {
+    // Pairs handed to the pool at once, enough to keep every thread busy
+    constexpr int ParallelPairs = 64;
+
+    template<typename T> void AddLittleEndian(QCryptographicHash& hash, T value)
+    {
+        value = qToLittleEndian(value);
+        hash.addData(QByteArray::fromRawData((const char*)&value, sizeof(value)));
+    }
+
+    void AddString(QCryptographicHash& hash, const QString& text)
+    {
+        QByteArray utf8 = text.toUtf8();
+        AddLittleEndian<quint32>(hash, utf8.size());
+        hash.addData(utf8);
+    }
+}
+
+bool DdiDiff::IsOffsetField(const QString& name)
+{
+    // DDB offsets move with every repack, the chunk length with any child.
+    // Frame offsets are not properties at all, see ItemAudioFrameRefs
+    return name == "SND Sample offset" || name == "SND Sample offset+800" || name == "FrameRefs" ||
+           name == "HashStore" || name == "Chunk length";
+}
+
+void DdiDiff::Flatten(BaseChunk* root, Tree& tree)
+{
+    tree.nodes.clear();
+    tree.levels.clear();
+    if (!root) {
+        return;
+    }
+
+    tree.nodes.append(Node{ root, root->GetName(), -1, 0, 0, 1, QByteArray(), QByteArray() });
+    tree.levels.append(0);
+    int levelEnd = 1;
+    for (int i = 0; i < tree.nodes.size(); i++) {
+        if (i == levelEnd) {
+            tree.levels.append(i);
+            levelEnd = tree.nodes.size();
+        }
+
+        BaseChunk* chunk = tree.nodes[i].chunk;
+        tree.nodes[i].firstChild = tree.nodes.size();
+        QHash<QString, int> seen;
+        foreach (auto child, chunk->Children) {
+            if (!child) {
+                continue;
+            }
+            QString key = child->GetName();
+            if (key.isEmpty()) {
+                key = "[" + QString::fromLatin1(child->GetSignature()) + "]";
+            }
+            // Same named siblings are told apart by their rank
+            int rank = seen[key]++;
+            if (rank) {
+                key += QString("#%1").arg(rank);
+            }
+            tree.nodes.append(Node{ child, key, i, 0, 0, 1, QByteArray(), QByteArray() });
+        }
+        tree.nodes[i].childCount = tree.nodes.size() - tree.nodes[i].firstChild;
+    }
+    tree.levels.append(tree.nodes.size());
+}
+
+bool DdiDiff::HashChunks(const QString& ddbPath, DdbIndex& index, QVector<QByteArray>& hashes, QString& error)
+{
+    QFile file(ddbPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = "Cannot open " + ddbPath;
+        return false;
+    }
+    const quint64 total = file.size();
+    index.reset(total);
+    hashes.clear();
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    int next = 0;
+    // A chunk is only known once its header went through the index, so each
+    // block is hashed after the one following it has been fed
+    auto consume = [&](const QByteArray& block, quint64 pos) {
+        const auto& chunks = index.chunks();
+        quint64 at = pos;
+        const quint64 end = pos + block.size();
+        while (at < end && next < chunks.size()) {
+            const auto& chunk = chunks[next];
+            if (at < chunk.offset) {
+                at = chunk.offset;
+                continue;
+            }
+            const quint64 chunkEnd = chunk.offset + chunk.size;
+            const quint64 take = qMin(chunkEnd, end) - at;
+            hash.addData(QByteArray::fromRawData(block.constData() + (at - pos), take));
+            at += take;
+            if (at == chunkEnd) {
+                hashes.append(hash.result());
+                hash.reset();
+                next++;
+            }
+        }
+    };
+
+    QByteArray previous;
+    quint64 pos = 0, previousPos = 0;
+    while (pos < total) {
+        QByteArray block = file.read(qMin<quint64>(BlockSize, total - pos));
+        if (block.isEmpty()) {
+            error = QString("Cannot read %1 at 0x%2").arg(ddbPath).arg(pos, 0, 16);
+            return false;
+        }
+        index.feed(block.constData(), block.size());
+        consume(previous, previousPos);
+        previous = block;
+        previousPos = pos;
+        pos += block.size();
+    }
+    index.finish();
+    consume(previous, previousPos);
+    return true;
+}
+
+void DdiDiff::AddPayloads(Tree& tree, const DdiReferences& references, const DdbIndex& index,
+                          const QVector<QByteArray>& chunkHashes)
+{
+    QHash<BaseChunk*, int> nodeOf;
+    for (int i = 0; i < tree.nodes.size(); i++) {
+        nodeOf.insert(tree.nodes[i].chunk, i);
+    }
+
+    // One digest per owner over what its references point at, not where
+    const auto& refs = references.references();
+    QVector<QCryptographicHash*> digests(references.owners().size(), nullptr);
+    foreach (const auto& ref, refs) {
+        auto& digest = digests[ref.owner];
+        if (!digest) {
+            digest = new QCryptographicHash(QCryptographicHash::Md5);
+        }
+        AddLittleEndian<quint32>(*digest, ref.kind);
+        int chunk = index.find(ref.target);
+        if (chunk < 0 || chunk >= chunkHashes.size()) {
+            digest->addData(QByteArray("unresolved"));
+            AddLittleEndian<quint64>(*digest, ref.target);
+            continue;
+        }
+        digest->addData(chunkHashes[chunk]);
+        AddLittleEndian<quint64>(*digest, ref.target - index.chunks()[chunk].offset);
+    }
+
+    for (int owner = 0; owner < digests.size(); owner++) {
+        if (!digests[owner]) {
+            continue;
+        }
+        int node = nodeOf.value(references.ownerChunk(owner), -1);
+        if (node >= 0) {
+            tree.nodes[node].payload = digests[owner]->result();
+        }
+        delete digests[owner];
+    }
+}
+
+void DdiDiff::HashTree(Tree& tree)
+{
+    // Deepest level first, the nodes of one level only read their children
+    Node* nodes = tree.nodes.data();
+    for (int level = tree.levels.size() - 2; level >= 0; level--) {
+        QVector<int> indexes(tree.levels[level + 1] - tree.levels[level]);
+        std::iota(indexes.begin(), indexes.end(), tree.levels[level]);
+        QtConcurrent::blockingMap(indexes, [nodes](int& index) {
+            Node& node = nodes[index];
+            QCryptographicHash hash(QCryptographicHash::Md5);
+            hash.addData(node.chunk->GetSignature());
+
+            const auto& props = node.chunk->GetPropertiesMap();
+            for (auto it = props.cbegin(); it != props.cend(); ++it) {
+                if (IsOffsetField(it.key())) {
+                    continue;
+                }
+                AddString(hash, it.key());
+                AddLittleEndian<quint32>(hash, it->type);
+                AddLittleEndian<quint32>(hash, it->data.size());
+                hash.addData(it->data);
+            }
+            hash.addData(node.payload);
+
+            // Sorted by key, so only content and not sibling order counts
+            QVector<int> children(node.childCount);
+            std::iota(children.begin(), children.end(), node.firstChild);
+            std::sort(children.begin(), children.end(), [nodes](int a, int b) {
+                return nodes[a].key < nodes[b].key;
+            });
+            node.size = 1;
+            foreach (int child, children) {
+                AddString(hash, nodes[child].key);
+                hash.addData(nodes[child].hash);
+                node.size += nodes[child].size;
+            }
+            node.hash = hash.result();
+        });
+    }
+}
+
+bool DdiDiff::compare(BaseChunk* before, const QString& beforeDdb, BaseChunk* after, const QString& afterDdb)
+{
+    QElapsedTimer timer;
+    timer.start();
+    mEntries.clear();
+    mError.clear();
+
+    if (!before || !after) {
+        mError = "Nothing to compare";
+        return false;
+    }
+
+    // Both DDBs are streamed at the same time while the trees are flattened
+    mPayloadsCompared = !beforeDdb.isEmpty() && !afterDdb.isEmpty();
+    DdbIndex indexes[2];
+    QVector<QByteArray> chunkHashes[2];
+    QString errors[2];
+    QFuture<bool> hashing[2];
+    const QString ddbPaths[2] = { beforeDdb, afterDdb };
+    if (mPayloadsCompared) {
+        for (int side = 0; side < 2; side++) {
+            hashing[side] = QtConcurrent::run([&, side]() {
+                return HashChunks(ddbPaths[side], indexes[side], chunkHashes[side], errors[side]);
+            });
+        }
+    }
+
+    BaseChunk* roots[2] = { before, after };
+    DdiReferences references[2];
+    for (int side = 0; side < 2; side++) {
+        Flatten(roots[side], mTrees[side]);
+        if (mPayloadsCompared) {
+            references[side].collect(roots[side]);
+        }
+    }
+
+    if (mPayloadsCompared) {
+        for (int side = 0; side < 2; side++) {
+            if (!hashing[side].result()) {
+                hashing[1 - side].waitForFinished();
+                mError = errors[side];
+                return false;
+            }
+        }
+        for (int side = 0; side < 2; side++) {
+            AddPayloads(mTrees[side], references[side], indexes[side], chunkHashes[side]);
+        }
+    }
+
+    for (int side = 0; side < 2; side++) {
+        HashTree(mTrees[side]);
+    }
+
+    // Expand differing pairs breadth first until there are enough to share out
+    QVector<QPair<int, int>> pairs{ qMakePair(0, 0) };
+    while (!pairs.isEmpty() && pairs.size() < ParallelPairs) {
+        QVector<QPair<int, int>> next;
+        foreach (const auto& pair, pairs) {
+            diffPair(pair.first, pair.second, mEntries, next);
+        }
+        pairs = next;
+    }
+    auto results = QtConcurrent::blockingMapped<QVector<QVector<DdiDiffEntry>>>(pairs, [this](const QPair<int, int>& pair) {
+        QVector<DdiDiffEntry> entries;
+        diffNodes(pair.first, pair.second, entries);
+        return entries;
+    });
+    foreach (const auto& entries, results) {
+        mEntries += entries;
+    }
+
+    std::stable_sort(mEntries.begin(), mEntries.end(), [](const DdiDiffEntry& a, const DdiDiffEntry& b) {
+        return a.path < b.path;
+    });
+    mElapsedMs = timer.elapsed();
+    return true;
+}
+
+QString DdiDiff::path(int side, int node) const
+{
+    const auto& nodes = mTrees[side].nodes;
+    QStringList parts;
+    for (; node >= 0; node = nodes[node].parent) {
+        parts.prepend(nodes[node].key);
+    }
+    return parts.join('/');
+}
+
+void DdiDiff::diffPair(int before, int after, QVector<DdiDiffEntry>& entries, QVector<QPair<int, int>>& pairs) const
+{
+    const Node& a = mTrees[0].nodes[before];
+    const Node& b = mTrees[1].nodes[after];
+    if (a.hash == b.hash) {
+        return;
+    }
+
+    // Fields of the chunk itself, both maps are sorted by name
+    const auto& propsA = a.chunk->GetPropertiesMap();
+    const auto& propsB = b.chunk->GetPropertiesMap();
+    auto itA = propsA.cbegin(), itB = propsB.cbegin();
+    while (itA != propsA.cend() || itB != propsB.cend()) {
+        const bool takeA = itB == propsB.cend() || (itA != propsA.cend() && itA.key() < itB.key());
+        const bool takeB = itA == propsA.cend() || (itB != propsB.cend() && itB.key() < itA.key());
+        const QString& name = takeA ? itA.key() : itB.key();
+        if (!IsOffsetField(name)) {
+            if (takeA) {
+                entries.append(DdiDiffEntry{ DdiDiffEntry::Changed, path(0, before), name, FormatProperty(*itA), QString(), 0 });
+            } else if (takeB) {
+                entries.append(DdiDiffEntry{ DdiDiffEntry::Changed, path(1, after), name, QString(), FormatProperty(*itB), 0 });
+            } else if (itA->data != itB->data || itA->type != itB->type) {
+                entries.append(DdiDiffEntry{ DdiDiffEntry::Changed, path(1, after), name,
+                                             FormatProperty(*itA), FormatProperty(*itB), 0 });
+            }
+        }
+        if (!takeB) ++itA;
+        if (!takeA) ++itB;
+    }
+
+    if (a.payload != b.payload && !a.payload.isEmpty() && !b.payload.isEmpty()) {
+        entries.append(DdiDiffEntry{ DdiDiffEntry::PayloadChanged, path(1, after), QString(),
+                                     QString::fromLatin1(a.payload.toHex()), QString::fromLatin1(b.payload.toHex()), 0 });
+    }
+
+    QHash<QString, int> afterChildren;
+    for (int i = b.firstChild; i < b.firstChild + b.childCount; i++) {
+        afterChildren.insert(mTrees[1].nodes[i].key, i);
+    }
+    for (int i = a.firstChild; i < a.firstChild + a.childCount; i++) {
+        const Node& child = mTrees[0].nodes[i];
+        int match = afterChildren.take(child.key);
+        if (!match) {
+            // take() gives 0 for a missing key, and the root is never a child
+            entries.append(DdiDiffEntry{ DdiDiffEntry::Removed, path(0, i), QString(), QString(), QString(), child.size });
+            continue;
+        }
+        pairs.append(qMakePair(i, match));
+    }
+    for (auto it = afterChildren.cbegin(); it != afterChildren.cend(); ++it) {
+        entries.append(DdiDiffEntry{ DdiDiffEntry::Added, path(1, *it), QString(), QString(), QString(),
+                                     mTrees[1].nodes[*it].size });
+    }
+}
+
+void DdiDiff::diffNodes(int before, int after, QVector<DdiDiffEntry>& entries) const
+{
+    QVector<QPair<int, int>> pairs;
+    diffPair(before, after, entries, pairs);
+    foreach (const auto& pair, pairs) {
+        diffNodes(pair.first, pair.second, entries);
+    }
+}
+
+QString DdiDiff::KindName(DdiDiffEntry::Kind kind)
+{
+    switch (kind) {
+    case DdiDiffEntry::Added: return "Added";
+    case DdiDiffEntry::Removed: return "Removed";
+    case DdiDiffEntry::Changed: return "Changed";
+    case DdiDiffEntry::PayloadChanged: return "Payload changed";
+    }
+    return QString();
+}
+
+bool DdiDiff::writeReport(const QString& reportPath, const QString& beforePath, const QString& afterPath,
+                          const DdiDiff& diff)
+{
+    int counts[4] = { 0, 0, 0, 0 };
+    QJsonArray entries;
+    foreach (const auto& entry, diff.entries()) {
+        counts[entry.kind]++;
+        QJsonObject obj{
+            { "kind", KindName(entry.kind) },
+            { "path", entry.path },
+        };
+        if (entry.kind == DdiDiffEntry::Added || entry.kind == DdiDiffEntry::Removed) {
+            obj["nodes"] = entry.nodes;
+        } else {
+            if (!entry.field.isEmpty()) {
+                obj["field"] = entry.field;
+            }
+            obj["before"] = entry.before;
+            obj["after"] = entry.after;
+        }
+        entries.append(obj);
+    }
+
+    QJsonObject root{
+        { "before", beforePath },
+        { "after", afterPath },
+        { "nodesBefore", diff.nodeCount(0) },
+        { "nodesAfter", diff.nodeCount(1) },
+        { "payloadsCompared", diff.payloadsCompared() },
+        { "added", counts[DdiDiffEntry::Added] },
+        { "removed", counts[DdiDiffEntry::Removed] },
+        { "changed", counts[DdiDiffEntry::Changed] },
+        { "payloadChanged", counts[DdiDiffEntry::PayloadChanged] },
+        { "entries", entries },
+        { "elapsedMs", diff.elapsedMs() },
+    };
+
+    QFile file(reportPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    return file.write(QJsonDocument(root).toJson()) >= 0;
+}
@@ -0,0 +1,88 @@
+#ifndef DDIDIFF_H
+#define DDIDIFF_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QByteArray>
+#include <QPair>
+
+#include "ddbindex.h"
+
+class BaseChunk;
+class DdiReferences;
+
+struct DdiDiffEntry {
+    enum Kind { Added, Removed, Changed, PayloadChanged };
+    Kind kind;
+    QString path;
+    QString field;          // Changed: the property
+    QString before;
+    QString after;
+    int nodes;              // Added, Removed: size of the subtree
+};
+
+// Structural diff of two DDI trees, typically two versions of one voicebank.
+// Chunks are aligned by path (child names, made unique among siblings), and
+// every node gets a Merkle hash of its own fields and its children's hashes,
+// so identical subtrees are skipped whole and the diff stays linear in the
+// size of the trees. Fields holding DDB offsets are left out: when both DDBs
+// are given, each is streamed once to hash its chunks, and units are compared
+// by the hashes of the chunks they refer to instead, so a repack alone shows
+// no difference. Hashing runs level by level and the diff subtree by subtree
+// on the Qt Concurrent pool.
+class DdiDiff
+{
+public:
+    static constexpr qint64 BlockSize = 8 << 20;
+
+    // DDB paths may be empty to only compare the trees
+    bool compare(BaseChunk* before, const QString& beforeDdb, BaseChunk* after, const QString& afterDdb);
+
+    const QVector<DdiDiffEntry>& entries() const { return mEntries; }
+    int nodeCount(int side) const { return mTrees[side].nodes.size(); }
+    bool payloadsCompared() const { return mPayloadsCompared; }
+    qint64 elapsedMs() const { return mElapsedMs; }
+    QString getError() const { return mError; }
+
+    static QString KindName(DdiDiffEntry::Kind kind);
+    static bool writeReport(const QString& reportPath, const QString& beforePath, const QString& afterPath,
+                            const DdiDiff& diff);
+
+private:
+    struct Node {
+        BaseChunk* chunk;
+        QString key;            // Name, unique among its siblings
+        int parent;
+        int firstChild;         // Children are contiguous, in breadth first order
+        int childCount;
+        int size;               // Nodes in the subtree, itself included
+        QByteArray payload;     // Digest of the referenced DDB chunks, if any
+        QByteArray hash;
+    };
+    struct Tree {
+        QVector<Node> nodes;
+        QVector<int> levels;    // First node of each depth, plus the end
+    };
+
+    static void Flatten(BaseChunk* root, Tree& tree);
+    static bool HashChunks(const QString& ddbPath, DdbIndex& index, QVector<QByteArray>& hashes, QString& error);
+    static void AddPayloads(Tree& tree, const DdiReferences& references, const DdbIndex& index,
+                            const QVector<QByteArray>& chunkHashes);
+    static void HashTree(Tree& tree);
+    static bool IsOffsetField(const QString& name);
+
+    QString path(int side, int node) const;
+    void diffNodes(int before, int after, QVector<DdiDiffEntry>& entries) const;
+    // Entries of the pair itself, matched children go to pairs
+    void diffPair(int before, int after, QVector<DdiDiffEntry>& entries, QVector<QPair<int, int>>& pairs) const;
+
+private:
+    Tree mTrees[2];
+    QVector<DdiDiffEntry> mEntries;
+    bool mPayloadsCompared = false;
+    qint64 mElapsedMs = 0;
+    QString mError;
+};
+
+#endif // DDIDIFF_H
@@ -0,0 +1,390 @@
+#include "ddipatcher.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <limits>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "perftrace.h"
+
+namespace {
+    const QByteArray JournalMagic("DDIJ");
+    // 2 added the state, 1 journals are always pending
+    constexpr quint32 JournalVersion = 2;
+    constexpr int JournalHashSize = 16;
+    // Done once the DDI is synced, there is nothing left to roll back
+    enum JournalState : quint32 { JournalPending = 0, JournalDone = 1 };
+
+    // Written whole or not at all
+    bool WriteJournal(const QString& path, JournalState state, const QVector<DdiFieldEdit>& edits)
+    {
+        QByteArray journal;
+        {
+            QDataStream out(&journal, QIODevice::WriteOnly);
+            out.setByteOrder(QDataStream::LittleEndian);
+            out.writeRawData(JournalMagic.constData(), JournalMagic.size());
+            out << JournalVersion << (quint32)state << (quint32)edits.size();
+            foreach (const auto& edit, edits) {
+                out << (quint64)edit.offset << (quint32)edit.before.size();
+                out.writeRawData(edit.before.constData(), edit.before.size());
+            }
+        }
+        journal += QCryptographicHash::hash(journal, QCryptographicHash::Md5);
+
+        QSaveFile file(path);
+        return file.open(QIODevice::WriteOnly) && file.write(journal) == journal.size() && file.commit();
+    }
+
+    template<typename T> QByteArray ValueBytes(T value, int size)
+    {
+        QByteArray data((const char*)&value, sizeof(value));
+        return data.leftJustified(size, '\0', true);
+    }
+
+    bool Sync(QFile& file)
+    {
+        if (!file.flush()) {
+            return false;
+        }
+#ifdef Q_OS_UNIX
+        return ::fsync(file.handle()) == 0;
+#else
+        return true;
+#endif
+    }
+
+    bool WriteAt(QFile& file, quint64 offset, const QByteArray& data)
+    {
+#ifdef Q_OS_UNIX
+        // Positioned, without moving the file pointer back and forth
+        return ::pwrite(file.handle(), data.constData(), data.size(), offset) == data.size();
+#else
+        return file.seek(offset) && file.write(data) == data.size();
+#endif
+    }
+
+    bool ReadAt(QFile& file, quint64 offset, QByteArray& data)
+    {
+#ifdef Q_OS_UNIX
+        return ::pread(file.handle(), data.data(), data.size(), offset) == data.size();
+#else
+        return file.seek(offset) && file.read(data.data(), data.size()) == data.size();
+#endif
+    }
+}
+
+DdiPatcher::DdiPatcher(const QString& ddiPath) :
+    mDdiPath(ddiPath),
+    mElapsedMs(0)
+{
+}
+
+bool DdiPatcher::Encode(PropertyType type, const QString& text, int size, QByteArray& data, QString& error)
+{
+    const QString value = text.trimmed();
+    bool ok = true;
+
+    auto unsignedValue = [&](int base, quint64 max) {
+        const quint64 x = value.toULongLong(&ok, base);
+        if (ok && x > max) {
+            ok = false;
+        }
+        return x;
+    };
+    auto signedValue = [&](qint64 min, qint64 max) {
+        const qint64 x = value.toLongLong(&ok);
+        if (ok && (x < min || x > max)) {
+            ok = false;
+        }
+        return x;
+    };
+
+    switch (type) {
+    case PropU8Int:  data = ValueBytes<quint8>(unsignedValue(10, 0xFF), size); break;
+    case PropHex8:   data = ValueBytes<quint8>(unsignedValue(16, 0xFF), size); break;
+    case PropS8Int:  data = ValueBytes<qint8>(signedValue(-0x80, 0x7F), size); break;
+    case PropU16Int: data = ValueBytes<quint16>(unsignedValue(10, 0xFFFF), size); break;
+    case PropHex16:  data = ValueBytes<quint16>(unsignedValue(16, 0xFFFF), size); break;
+    case PropS16Int: data = ValueBytes<qint16>(signedValue(-0x8000, 0x7FFF), size); break;
+    case PropU32Int: data = ValueBytes<quint32>(unsignedValue(10, 0xFFFFFFFFu), size); break;
+    case PropHex32:  data = ValueBytes<quint32>(unsignedValue(16, 0xFFFFFFFFu), size); break;
+    case PropS32Int: data = ValueBytes<qint32>(signedValue(-0x80000000ll, 0x7FFFFFFF), size); break;
+    case PropU64Int: data = ValueBytes<quint64>(unsignedValue(10, std::numeric_limits<quint64>::max()), size); break;
+    case PropHex64:  data = ValueBytes<quint64>(unsignedValue(16, std::numeric_limits<quint64>::max()), size); break;
+    case PropS64Int:
+        data = ValueBytes<qint64>(signedValue(std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max()), size);
+        break;
+    case PropF32: data = ValueBytes<float>(value.toFloat(&ok), size); break;
+    case PropF64: data = ValueBytes<double>(value.toDouble(&ok), size); break;
+    case PropString: {
+        data = value.toUtf8();
+        if (data.size() > size) {
+            error = QString("Text takes %1 bytes, the field only has %2").arg(data.size()).arg(size);
+            return false;
+        }
+        data = data.leftJustified(size, '\0');
+        return true;
+    }
+    default: {
+        QByteArray hex = value.toLatin1();
+        hex.replace(' ', "");
+        data = QByteArray::fromHex(hex);
+        if (hex.size() != data.size() * 2 || data.size() != size) {
+            error = QString("Expected %1 bytes of hex").arg(size);
+            return false;
+        }
+        return true;
+    }
+    }
+
+    if (!ok) {
+        error = QString("\"%1\" is not a valid %2").arg(value, PropertyTypeNames[type]);
+    }
+    return ok;
+}
+
+bool DdiPatcher::stage(BaseChunk* chunk, const QString& name, const QByteArray& data)
+{
+    mError.clear();
+    const auto& props = chunk->GetPropertiesMap();
+    auto prop = props.constFind(name);
+    if (prop == props.cend() || !prop->sourceSize) {
+        mError = name + " is not a field read from the DDI, it cannot be edited in place";
+        return false;
+    }
+    // Lengths are the writer's business, they have to agree with the chunks
+    if (name == "Chunk length") {
+        mError = "Chunk lengths cannot be edited in place";
+        return false;
+    }
+    if ((size_t)data.size() != prop->sourceSize || prop->data.size() != data.size()) {
+        mError = QString("%1 takes %2 bytes, cannot write %3 in place").arg(name).arg(prop->sourceSize).arg(data.size());
+        return false;
+    }
+
+    auto edit = std::find_if(mStaged.begin(), mStaged.end(), [&](const DdiFieldEdit& i) {
+        return i.offset == prop->offset;
+    });
+    if (edit == mStaged.end()) {
+        mStaged.append(DdiFieldEdit { prop->offset, prop->data, data, chunk, name });
+    } else {
+        edit->after = data;
+    }
+
+    ChunkProperty changed = *prop;
+    changed.data = data;
+    chunk->SetProperty(name, changed);
+    return true;
+}
+
+void DdiPatcher::discard()
+{
+    SetValues(mStaged, false);
+    mStaged.clear();
+}
+
+void DdiPatcher::SetValues(const QVector<DdiFieldEdit>& edits, bool after)
+{
+    foreach (const auto& edit, edits) {
+        ChunkProperty prop = edit.chunk->GetProperty(edit.name);
+        prop.data = after ? edit.after : edit.before;
+        edit.chunk->SetProperty(edit.name, prop);
+    }
+}
+
+bool DdiPatcher::save()
+{
+    mError.clear();
+    if (mStaged.isEmpty()) {
+        return true;
+    }
+    QVector<DdiFieldEdit> edits;
+    foreach (const auto& edit, mStaged) {
+        if (edit.before != edit.after) {
+            edits.append(edit);
+        }
+    }
+    if (!write(edits)) {
+        return false;
+    }
+    mSaved = edits;
+    mStaged.clear();
+    return true;
+}
+
+bool DdiPatcher::undo()
+{
+    mError.clear();
+    if (!mStaged.isEmpty()) {
+        mError = "Save or discard the pending edits first";
+        return false;
+    }
+    QVector<DdiFieldEdit> reverts = mSaved;
+    for (auto& edit : reverts) {
+        std::swap(edit.before, edit.after);
+    }
+    if (!write(reverts)) {
+        return false;
+    }
+    SetValues(reverts, true);
+    mSaved.clear();
+    return true;
+}
+
+bool DdiPatcher::write(const QVector<DdiFieldEdit>& edits)
+{
+    PERF_SCOPE("Patch DDI fields");
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<DdiFieldEdit> sorted = edits;
+    std::sort(sorted.begin(), sorted.end(), [](const DdiFieldEdit& a, const DdiFieldEdit& b) {
+        return a.offset < b.offset;
+    });
+    for (int i = 1; i < sorted.size(); i++) {
+        if (sorted[i].offset < sorted[i - 1].offset + sorted[i - 1].before.size()) {
+            mError = QString("Edits overlap at 0x%1").arg(sorted[i].offset, 0, 16);
+            return false;
+        }
+    }
+
+    QFile file(mDdiPath);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        mError = "Cannot open " + mDdiPath + " for writing";
+        return false;
+    }
+    // Someone else writing the file would have the journal restore stale bytes
+    foreach (const auto& edit, sorted) {
+        QByteArray current(edit.before.size(), 0);
+        if (!ReadAt(file, edit.offset, current) || current != edit.before) {
+            mError = QString("%1 changed on disk at 0x%2, reopen it first").arg(mDdiPath).arg(edit.offset, 0, 16);
+            return false;
+        }
+    }
+
+    const QString journalPath = JournalPath(mDdiPath);
+    if (!WriteJournal(journalPath, JournalPending, sorted)) {
+        mError = "Cannot write the journal " + journalPath;
+        return false;
+    }
+
+    foreach (const auto& edit, sorted) {
+        if (!WriteAt(file, edit.offset, edit.after)) {
+            mError = QString("Cannot write %1 at 0x%2, it is restored from the journal on the next open")
+                         .arg(mDdiPath).arg(edit.offset, 0, 16);
+            return false;
+        }
+    }
+    if (!Sync(file)) {
+        mError = "Cannot flush " + mDdiPath + ", it is restored from the journal on the next open";
+        return false;
+    }
+    // A journal left pending would roll this save back on the next open
+    const bool marked = WriteJournal(journalPath, JournalDone, QVector<DdiFieldEdit>());
+    if (!QFile::remove(journalPath) && !marked) {
+        mError = QString("%1 is saved, but %2 can neither be removed nor marked done. "
+                         "Remove it before opening the DDI again, or the save is rolled back").arg(mDdiPath, journalPath);
+        return false;
+    }
+
+    mElapsedMs = timer.elapsed();
+    return true;
+}
+
+bool DdiPatcher::Recover(const QString& ddiPath, bool& recovered, QString& error)
+{
+    recovered = false;
+    QFile journalFile(JournalPath(ddiPath));
+    if (!journalFile.exists()) {
+        return true;
+    }
+    if (!journalFile.open(QIODevice::ReadOnly)) {
+        error = "Cannot open " + journalFile.fileName();
+        return false;
+    }
+    QByteArray journal = journalFile.readAll();
+    journalFile.close();
+
+    const QByteArray body = journal.left(journal.size() - JournalHashSize);
+    if (journal.size() < JournalHashSize ||
+        QCryptographicHash::hash(body, QCryptographicHash::Md5) != journal.right(JournalHashSize)) {
+        error = journalFile.fileName() + " is damaged, the DDI may hold a partly saved edit";
+        return false;
+    }
+
+    QDataStream in(body);
+    in.setByteOrder(QDataStream::LittleEndian);
+    QByteArray magic(JournalMagic.size(), 0);
+    quint32 version = 0, state = JournalPending, count = 0;
+    in.readRawData(magic.data(), magic.size());
+    in >> version;
+    if (magic != JournalMagic || version < 1 || version > JournalVersion) {
+        error = journalFile.fileName() + " is not a journal this version can replay";
+        return false;
+    }
+    if (version >= 2) {
+        in >> state;
+    }
+    in >> count;
+
+    // The save it belonged to finished, only removing it did not
+    if (state == JournalDone) {
+        if (!QFile::remove(journalFile.fileName())) {
+            error = "Cannot remove " + journalFile.fileName();
+            return false;
+        }
+        return true;
+    }
+
+    QFile file(ddiPath);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        error = "Cannot open " + ddiPath + " for writing";
+        return false;
+    }
+
+    // Every entry is checked before any is written back
+    const quint64 fileSize = file.size();
+    QVector<DdiFieldEdit> entries;
+    for (quint32 i = 0; i < count; i++) {
+        quint64 offset = 0;
+        quint32 size = 0;
+        in >> offset >> size;
+        if (in.status() != QDataStream::Ok || size > (quint64)body.size()) {
+            error = journalFile.fileName() + " is truncated";
+            return false;
+        }
+        if (offset > fileSize || size > fileSize - offset) {
+            error = QString("%1 restores %2 bytes at 0x%3, past the end of %4")
+                        .arg(journalFile.fileName()).arg(size).arg(offset, 0, 16).arg(ddiPath);
+            return false;
+        }
+        QByteArray before(size, 0);
+        if (in.readRawData(before.data(), size) != (int)size) {
+            error = journalFile.fileName() + " is truncated";
+            return false;
+        }
+        entries.append(DdiFieldEdit { offset, before, QByteArray(), nullptr, QString() });
+    }
+    foreach (const auto& entry, entries) {
+        if (!WriteAt(file, entry.offset, entry.before)) {
+            error = QString("Cannot restore %1 at 0x%2").arg(ddiPath).arg(entry.offset, 0, 16);
+            return false;
+        }
+    }
+    if (!Sync(file)) {
+        error = "Cannot flush " + ddiPath;
+        return false;
+    }
+    recovered = true;
+    if (!QFile::remove(journalFile.fileName())) {
+        error = "Fields restored, but " + journalFile.fileName() + " cannot be removed";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef DDIPATCHER_H
+#define DDIPATCHER_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+
+#include "chunk/basechunk.h"
+
+// One property rewritten in place, same size as before
+struct DdiFieldEdit {
+    quint64 offset;
+    QByteArray before, after;
+    BaseChunk* chunk;
+    QString name;
+};
+
+// Edits fields of an opened DDI where they are, without rewriting the file.
+// Edits are staged in memory (the tree shows them right away), then saved
+// as one batch of positioned writes in offset order. The bytes they replace
+// go to "<ddi>.journal" first, which is marked done and removed once the DDI
+// is synced, so an interrupted save is rolled back by Recover() on the next open.
+// Only the DDI is touched, the DDB and so the HashStore stay as they are.
+class DdiPatcher
+{
+public:
+    explicit DdiPatcher(const QString& ddiPath);
+
+    // Parses text as a value of type taking size bytes
+    static bool Encode(PropertyType type, const QString& text, int size, QByteArray& data, QString& error);
+
+    // Stages a new value for a property read from the DDI, and shows it in the tree
+    bool stage(BaseChunk* chunk, const QString& name, const QByteArray& data);
+    // Puts the staged values back in the tree
+    void discard();
+    const QVector<DdiFieldEdit>& staged() const { return mStaged; }
+
+    // Writes the staged edits, which then become the ones undo() reverts
+    bool save();
+    bool canUndo() const { return !mSaved.isEmpty(); }
+    // Writes back what the last save replaced
+    bool undo();
+
+    qint64 elapsedMs() const { return mElapsedMs; }
+    QString getError() const { return mError; }
+
+    static QString JournalPath(const QString& ddiPath) { return ddiPath + ".journal"; }
+    // Rolls back a save interrupted before it finished. recovered tells
+    // whether there was one, false is returned only if that failed
+    static bool Recover(const QString& ddiPath, bool& recovered, QString& error);
+
+private:
+    bool write(const QVector<DdiFieldEdit>& edits);
+    static void SetValues(const QVector<DdiFieldEdit>& edits, bool after);
+
+private:
+    QString mDdiPath;
+    QVector<DdiFieldEdit> mStaged, mSaved;
+    qint64 mElapsedMs;
+    QString mError;
+};
+
+#endif // DDIPATCHER_H
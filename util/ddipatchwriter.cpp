@@ -0,0 +1,54 @@
+#include "ddipatchwriter.h"
+
+#include <QFile>
+#include <cstring>
+
+bool DdiPatchWriter::write(QFile& source, QFileDevice& target, const QVector<DdiPatch>& patches, QString& error,
+                           quint64 insertAt, const QByteArray& insert)
+{
+    if (insertAt != NoInsert && (quint64)source.size() < insertAt) {
+        error = "Insertion offset is outside of " + source.fileName();
+        return false;
+    }
+
+    int nextPatch = 0;
+    quint64 pos = 0;
+    while (true) {
+        if (pos == insertAt && target.write(insert) != insert.size()) {
+            break;
+        }
+        qint64 length = BlockSize;
+        if (pos < insertAt) {
+            length = qMin<quint64>(length, insertAt - pos);
+        }
+        QByteArray buffer = source.read(length);
+        if (buffer.isEmpty()) {
+            if (source.atEnd() && target.flush()) {
+                return true;
+            }
+            break;
+        }
+
+        const quint64 end = pos + buffer.size();
+        while (nextPatch < patches.size() && patches[nextPatch].ddiOffset < end) {
+            const auto& patch = patches[nextPatch];
+            const quint64 patchEnd = patch.ddiOffset + patch.data.size();
+            const quint64 from = qMax(patch.ddiOffset, pos), to = qMin(patchEnd, end);
+            if (from < to) {
+                memcpy(buffer.data() + (from - pos), patch.data.constData() + (from - patch.ddiOffset), to - from);
+            }
+            if (patchEnd > end) {
+                break;  // Continues in the next block
+            }
+            nextPatch++;
+        }
+
+        if (target.write(buffer) != buffer.size()) {
+            break;
+        }
+        pos = end;
+    }
+
+    error = "Cannot write " + target.fileName() + ": " + target.errorString();
+    return false;
+}
@@ -0,0 +1,32 @@
+#ifndef DDIPATCHWRITER_H
+#define DDIPATCHWRITER_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+
+class QFile;
+class QFileDevice;
+
+// Bytes to write into the DDI at a given offset
+struct DdiPatch {
+    quint64 ddiOffset;
+    QByteArray data;
+};
+
+// Streams a DDI (or the tree it is made from) into another file with fixed
+// size patches applied, and optionally a segment inserted, in one pass of
+// large blocks. Neither side is ever held in memory as a whole.
+class DdiPatchWriter
+{
+public:
+    static constexpr qint64 BlockSize = 1 << 20;
+    static constexpr quint64 NoInsert = ~0ull;
+
+    // Patches must be sorted by offset and not overlap, offsets are in source.
+    // insert is written before the source byte at insertAt
+    static bool write(QFile& source, QFileDevice& target, const QVector<DdiPatch>& patches, QString& error,
+                      quint64 insertAt = NoInsert, const QByteArray& insert = QByteArray());
+};
+
+#endif // DDIPATCHWRITER_H
@@ -0,0 +1,75 @@
+#include "ddireferences.h"
+
+#include <QtEndian>
+
+#include "chunk/basechunk.h"
+#include "chunk/item_audioframerefs.h"
+
+void DdiReferences::collect(BaseChunk* root)
+{
+    mReferences.clear();
+    mOwners.clear();
+    mOwnerChunks.clear();
+    if (root) {
+        collect(root, root->GetName());
+    }
+}
+
+void DdiReferences::collect(BaseChunk* chunk, const QString& path)
+{
+    const auto& props = chunk->GetPropertiesMap();
+    int owner = -1;
+    auto addReference = [&](DdiReference::Kind kind, quint64 target, quint64 field) {
+        if (owner < 0) {
+            owner = mOwners.size();
+            mOwners.append(path);
+            mOwnerChunks.append(chunk);
+        }
+        mReferences.append(DdiReference{ kind, target, field, owner });
+    };
+    auto addHex64 = [&](DdiReference::Kind kind, const ChunkProperty& prop) {
+        if (prop.type == PropHex64 && prop.data.size() >= 8) {
+            addReference(kind, qFromLittleEndian<quint64>(prop.data.constData()), prop.offset);
+        }
+    };
+
+    auto it = props.constFind("SND Sample offset");
+    if (it != props.cend()) {
+        addHex64(DdiReference::Sound, *it);
+    }
+    it = props.constFind("SND Sample offset+800");
+    if (it != props.cend()) {
+        addHex64(DdiReference::SoundPlayback, *it);
+    }
+    // VQMp keeps its frame offsets as one packed array
+    it = props.constFind("FrameRefs");
+    if (it != props.cend()) {
+        for (int i = 0; i + 8 <= it->data.size(); i += 8) {
+            addReference(DdiReference::Frame, qFromLittleEndian<quint64>(it->data.constData() + i), it->offset + i);
+        }
+    }
+
+    foreach (auto child, chunk->Children) {
+        if (!child) {
+            continue;
+        }
+        if (auto frames = dynamic_cast<ItemAudioFrameRefs*>(child)) {
+            const auto& offsets = frames->Offsets();
+            for (int i = 0; i < offsets.size(); i++) {
+                addReference(DdiReference::Frame, offsets[i], frames->FieldOffset(i));
+            }
+            continue;
+        }
+        collect(child, path + '/' + child->GetName());
+    }
+}
+
+QString DdiReferences::KindName(DdiReference::Kind kind)
+{
+    switch (kind) {
+    case DdiReference::Sound: return "SND Sample offset";
+    case DdiReference::SoundPlayback: return "SND Sample offset+800";
+    case DdiReference::Frame: return "Frame";
+    }
+    return QString();
+}
@@ -0,0 +1,43 @@
+#ifndef DDIREFERENCES_H
+#define DDIREFERENCES_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class BaseChunk;
+
+// A DDB offset stored in the DDI
+struct DdiReference {
+    enum Kind { Sound, SoundPlayback, Frame };
+    Kind kind;
+    quint64 target;         // DDB offset
+    quint64 field;          // DDI offset of the 8 byte field holding it
+    int owner;              // Index into DdiReferences::owners()
+};
+
+// Every DDB reference of a loaded DDI tree: "SND Sample offset" and
+// "SND Sample offset+800" of the unit parts, and their frames, either
+// <Frames> entries or the packed FrameRefs array of VQM parts.
+class DdiReferences
+{
+public:
+    void collect(BaseChunk* root);
+
+    const QVector<DdiReference>& references() const { return mReferences; }
+    // Tree path of the chunk holding each group of references
+    const QStringList& owners() const { return mOwners; }
+    BaseChunk* ownerChunk(int owner) const { return mOwnerChunks[owner]; }
+
+    static QString KindName(DdiReference::Kind kind);
+
+private:
+    void collect(BaseChunk* chunk, const QString& path);
+
+private:
+    QVector<DdiReference> mReferences;
+    QStringList mOwners;
+    QVector<BaseChunk*> mOwnerChunks;
+};
+
+#endif // DDIREFERENCES_H
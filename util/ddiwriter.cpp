@@ -0,0 +1,239 @@
+#include "ddiwriter.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <algorithm>
+
+#include "perftrace.h"
+
+DdiWriter::DdiWriter(BaseChunk* root) :
+    mRoot(root),
+    mResizedChunks(0),
+    mOutputSize(0),
+    mElapsedMs(0)
+{
+}
+
+void DdiWriter::collect(BaseChunk* chunk)
+{
+    chunk->WriteSpans(mSpans);
+
+    // The length counts from the signature in front of it to the chunk end
+    auto length = chunk->GetProperty("Chunk length");
+    if (length.sourceSize == 4 && length.offset >= 4) {
+        mLengths.append(LengthField{ length.offset, length.offset - 4, length.offset - 4 + chunk->GetSize() });
+    }
+
+    foreach (auto child, chunk->Children) {
+        if (child) {
+            collect(child);
+        }
+    }
+}
+
+bool DdiWriter::checkSpans(quint64 sourceSize)
+{
+    std::stable_sort(mSpans.begin(), mSpans.end(), [](const ChunkSpan& a, const ChunkSpan& b) {
+        return a.offset < b.offset;
+    });
+
+    quint64 end = 0;
+    foreach (const auto& span, mSpans) {
+        // Two chunks claiming the same bytes would write them twice
+        if (span.offset < end) {
+            mError = QString("Chunks overlap at 0x%1, cannot write them back").arg(span.offset, 0, 16);
+            return false;
+        }
+        end = span.offset + span.sourceSize;
+        if (end > sourceSize) {
+            mError = QString("Data at 0x%1 lies past the end of the source").arg(span.offset, 0, 16);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DdiWriter::resolveLengths()
+{
+    // Size change of every span before a given one
+    QVector<qint64> delta(mSpans.size() + 1, 0);
+    for (int i = 0; i < mSpans.size(); i++) {
+        delta[i + 1] = delta[i] + (qint64)mSpans[i].data.size() - (qint64)mSpans[i].sourceSize;
+    }
+    auto spanAt = [this](quint64 offset) {
+        return std::lower_bound(mSpans.begin(), mSpans.end(), offset, [](const ChunkSpan& span, quint64 at) {
+            return span.offset < at;
+        }) - mSpans.begin();
+    };
+
+    foreach (const auto& length, mLengths) {
+        const int field = spanAt(length.offset);
+        // Chunks writing their header as part of a larger span keep it as is
+        if (field == mSpans.size() || mSpans[field].offset != length.offset || mSpans[field].sourceSize != 4) {
+            continue;
+        }
+        const qint64 change = delta[spanAt(length.end)] - delta[spanAt(length.begin)];
+        if (!change) {
+            continue;
+        }
+
+        auto& data = mSpans[field].data;
+        if (data.size() != 4) {
+            mError = QString("Chunk length at 0x%1 is not 4 bytes").arg(length.offset, 0, 16);
+            return false;
+        }
+        const qint64 size = (qint64)qFromLittleEndian<quint32>(data.constData()) + change;
+        if (size < 8 || size > 0xFFFFFFFFll) {
+            mError = QString("Chunk at 0x%1 would be %2 bytes long").arg(length.begin, 0, 16).arg(size);
+            return false;
+        }
+        qToLittleEndian<quint32>(size, data.data());
+        mResizedChunks++;
+    }
+    return true;
+}
+
+bool DdiWriter::write(const QString& sourcePath, const QString& targetPath, const Progress& progress)
+{
+    PERF_SCOPE("Write DDI");
+    QElapsedTimer timer;
+    timer.start();
+    mSpans.clear();
+    mLengths.clear();
+    mResizedChunks = 0;
+    mOutputSize = 0;
+    mError.clear();
+
+    if (!mRoot) {
+        mError = "Nothing to write";
+        return false;
+    }
+    if (QFileInfo(sourcePath).absoluteFilePath() == QFileInfo(targetPath).absoluteFilePath()) {
+        mError = "Cannot write a DDI onto the file it is read from";
+        return false;
+    }
+
+    QFile source(sourcePath);
+    if (!source.open(QIODevice::ReadOnly)) {
+        mError = "Cannot open " + sourcePath;
+        return false;
+    }
+    const quint64 total = source.size();
+
+    collect(mRoot);
+    if (!checkSpans(total) || !resolveLengths()) {
+        return false;
+    }
+
+    QSaveFile out(targetPath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        mError = "Cannot write " + targetPath;
+        return false;
+    }
+    // Mapped when possible, the bytes in between are then appended in place
+    const uchar* mapped = total > 0 ? source.map(0, total) : nullptr;
+
+    QByteArray buffer;
+    buffer.reserve(BlockSize * 2);
+    auto flush = [&](quint64 done, bool force) {
+        if (buffer.size() < BlockSize && !force) {
+            return true;
+        }
+        if (out.write(buffer) != buffer.size()) {
+            mError = "Cannot write " + targetPath + ": " + out.errorString();
+            return false;
+        }
+        mOutputSize += buffer.size();
+        buffer.clear();
+        if (progress && !progress(done, total)) {
+            mError = "Writing cancelled";
+            return false;
+        }
+        return true;
+    };
+    auto copy = [&](quint64 from, quint64 to) {
+        if (!mapped && from < to && !source.seek(from)) {
+            mError = QString("Cannot read %1 at 0x%2").arg(sourcePath).arg(from, 0, 16);
+            return false;
+        }
+        while (from < to) {
+            const qint64 size = qMin<quint64>(BlockSize, to - from);
+            if (mapped) {
+                buffer.append((const char*)mapped + from, size);
+            } else {
+                QByteArray block = source.read(size);
+                if (block.size() != size) {
+                    mError = QString("Cannot read %1 at 0x%2").arg(sourcePath).arg(from, 0, 16);
+                    return false;
+                }
+                buffer.append(block);
+            }
+            from += size;
+            if (!flush(from, false)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    quint64 pos = 0;
+    foreach (const auto& span, mSpans) {
+        if (!copy(pos, span.offset)) {
+            out.cancelWriting();
+            return false;
+        }
+        buffer.append(span.data);
+        pos = span.offset + span.sourceSize;
+        if (!flush(pos, false)) {
+            out.cancelWriting();
+            return false;
+        }
+    }
+    if (!copy(pos, total) || !flush(total, true)) {
+        out.cancelWriting();
+        return false;
+    }
+
+    if (!out.commit()) {
+        mError = "Cannot write " + targetPath;
+        return false;
+    }
+    mElapsedMs = timer.elapsed();
+    return true;
+}
+
+bool DdiWriter::Compare(const QString& pathA, const QString& pathB, qint64& firstDifference, QString& error)
+{
+    QFile a(pathA), b(pathB);
+    if (!a.open(QIODevice::ReadOnly)) {
+        error = "Cannot open " + pathA;
+        return false;
+    }
+    if (!b.open(QIODevice::ReadOnly)) {
+        error = "Cannot open " + pathB;
+        return false;
+    }
+
+    firstDifference = -1;
+    qint64 pos = 0;
+    while (true) {
+        QByteArray blockA = a.read(BlockSize), blockB = b.read(BlockSize);
+        const int common = qMin(blockA.size(), blockB.size());
+        auto mismatch = std::mismatch(blockA.cbegin(), blockA.cbegin() + common, blockB.cbegin());
+        if (mismatch.first != blockA.cbegin() + common) {
+            firstDifference = pos + (mismatch.first - blockA.cbegin());
+            return true;
+        }
+        if (blockA.size() != blockB.size()) {
+            firstDifference = pos + common;   // One is a prefix of the other
+            return true;
+        }
+        if (blockA.isEmpty()) {
+            return true;
+        }
+        pos += common;
+    }
+}
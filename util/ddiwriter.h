@@ -0,0 +1,62 @@
+#ifndef DDIWRITER_H
+#define DDIWRITER_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <functional>
+
+#include "chunk/basechunk.h"
+
+// Writes a parsed DDI back out. Every chunk hands in the spans it owns
+// (its properties, plus frame offsets, samples and frames where it keeps
+// them), the bytes no chunk claims are copied from the source unchanged,
+// so anything the parser skips or does not understand survives as is.
+// A property may change size: the "Chunk length" of every chunk around it
+// is worked out from the spans it encloses before anything is written, and
+// the output is streamed front to back through one buffer, never seeking
+// back to patch.
+class DdiWriter
+{
+public:
+    // Return false to cancel
+    typedef std::function<bool(quint64 done, quint64 total)> Progress;
+
+    static constexpr qint64 BlockSize = 4 << 20;
+
+    explicit DdiWriter(BaseChunk* root);
+
+    // sourcePath is the file root was parsed from
+    bool write(const QString& sourcePath, const QString& targetPath, const Progress& progress = Progress());
+
+    // First offset at which two files differ, -1 if they are identical
+    static bool Compare(const QString& pathA, const QString& pathB, qint64& firstDifference, QString& error);
+
+    int spanCount() const { return mSpans.size(); }
+    int resizedChunks() const { return mResizedChunks; }
+    quint64 outputSize() const { return mOutputSize; }
+    qint64 elapsedMs() const { return mElapsedMs; }
+    QString getError() const { return mError; }
+
+private:
+    // Chunk length field and the source range it measures
+    struct LengthField {
+        quint64 offset;
+        quint64 begin, end;
+    };
+
+    void collect(BaseChunk* chunk);
+    bool checkSpans(quint64 sourceSize);
+    bool resolveLengths();
+
+private:
+    BaseChunk* mRoot;
+    QVector<ChunkSpan> mSpans;
+    QVector<LengthField> mLengths;
+    int mResizedChunks;
+    quint64 mOutputSize;
+    qint64 mElapsedMs;
+    QString mError;
+};
+
+#endif // DDIWRITER_H
@@ -0,0 +1,148 @@
+#include "devdbchecker.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <cstdio>
+#include <cerrno>
+
+#include "chunk/chunkreaderguards.h"
+#include "chunk/dbvstationaryphupart_devdb.h"
+#include "chunk/dbvarticulationphu_devdb.h"
+#include "chunk/dbvarticulationphupart_devdb.h"
+#include "perftrace.h"
+
+void DevDbChecker::check(DevDbCheckJob& job)
+{
+    PERF_SCOPE("Check DevDB unit");
+    const DevDbUnit& unit = *job.unit;
+    job.issues.clear();
+
+    job.path = DevDbPacker::resolvePath(unit);
+    if (job.path.isEmpty()) {
+        job.path = unit.path;
+        job.issues.append(DevDbIssue{ DevDbIssue::MissingFile });
+        return;
+    }
+
+    FILE* f = fopen(job.path.toLatin1(), "rb");
+    if (!f) {
+        DevDbIssue issue{ DevDbIssue::Unreadable };
+        issue.actual = errno;
+        job.issues.append(issue);
+        return;
+    }
+
+    // Structure only, frame and sample payloads are skipped
+    LeadingQwordGuard qwg(false);
+    HeaderOnlyGuard hog(true);
+
+    auto checkFrames = [&job](int pitch, quint32 expected, size_t actual) {
+        if (expected != actual) {
+            DevDbIssue issue{ DevDbIssue::FrameCountMismatch, pitch };
+            issue.expected = expected;
+            issue.actual = actual;
+            job.issues.append(issue);
+        }
+    };
+
+    if (unit.kind == DevDbUnit::Stationary) {
+        ChunkDBVStationaryPhUPart_DevDB STAp;
+        STAp.Read(f);
+        fclose(f);
+        checkFrames(0, unit.pitches.first().frameCount, STAp.frameCount);
+        return;
+    }
+
+    ChunkDBVArticulationPhU_DevDB ARTu;
+    ARTu.Read(f);
+    fclose(f);
+
+    // Diphonemes must match exactly, triphonemes only need every indexed pitch
+    if ((unit.kind == DevDbUnit::Articulation && ARTu.Children.count() != unit.pitches.count()) ||
+        ARTu.Children.count() < unit.pitches.count()) {
+        DevDbIssue issue{ DevDbIssue::ChildCountMismatch };
+        issue.expected = unit.pitches.count();
+        issue.actual = ARTu.Children.count();
+        job.issues.append(issue);
+    }
+
+    const int pitches = qMin(unit.pitches.count(), ARTu.Children.count());
+    for (int pitch = 0; pitch < pitches; pitch++) {
+        auto ARTp = (ChunkDBVArticulationPhUPart_DevDB*)(ARTu.Children[pitch]);
+        checkFrames(pitch, unit.pitches[pitch].frameCount, ARTp->frameCount);
+    }
+}
+
+QString DevDbChecker::kindName(DevDbIssue::Kind kind)
+{
+    switch (kind) {
+    case DevDbIssue::MissingFile: return "missingFile";
+    case DevDbIssue::Unreadable: return "unreadable";
+    case DevDbIssue::ChildCountMismatch: return "childCountMismatch";
+    case DevDbIssue::FrameCountMismatch: return "frameCountMismatch";
+    }
+    return QString();
+}
+
+QString DevDbChecker::describe(const DevDbCheckJob& job, const DevDbIssue& issue)
+{
+    const QString& label = job.unit->label;
+    switch (issue.kind) {
+    case DevDbIssue::MissingFile:
+        return "Cannot find " + job.path;
+    case DevDbIssue::Unreadable:
+        return QString("Cannot open %1, error %2").arg(job.path).arg(issue.actual);
+    case DevDbIssue::ChildCountMismatch:
+        return QString("%1 inconsistent sample count (Tree %2 Item %3)").arg(label).arg(issue.expected).arg(issue.actual);
+    case DevDbIssue::FrameCountMismatch:
+        return QString("%1 %2 frame count mismatch (Tree %3 Item %4)")
+            .arg(label).arg(issue.pitch).arg(issue.expected).arg(issue.actual);
+    }
+    return QString();
+}
+
+bool DevDbChecker::writeReport(const QString& reportPath, const QString& treePath,
+                               const QVector<DevDbCheckJob>& jobs, qint64 wallMs)
+{
+    QJsonArray issues;
+    int checked = 0;
+    foreach (const auto& job, jobs) {
+        if (!job.path.isEmpty()) {
+            checked++;
+        }
+        foreach (const auto& issue, job.issues) {
+            QJsonObject obj{
+                { "kind", kindName(issue.kind) },
+                { "unit", job.unit->label },
+                { "path", job.path },
+            };
+            if (issue.pitch >= 0) {
+                obj["pitch"] = issue.pitch;
+            }
+            if (issue.kind != DevDbIssue::MissingFile) {
+                obj[issue.kind == DevDbIssue::Unreadable ? "errno" : "actual"] = issue.actual;
+            }
+            if (issue.kind == DevDbIssue::ChildCountMismatch || issue.kind == DevDbIssue::FrameCountMismatch) {
+                obj["expected"] = issue.expected;
+            }
+            issues.append(obj);
+        }
+    }
+
+    QJsonObject root{
+        { "tree", treePath },
+        { "units", jobs.size() },
+        { "checked", checked },
+        { "issueCount", issues.size() },
+        { "elapsedMs", wallMs },
+        { "issues", issues },
+    };
+
+    QFile file(reportPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    return file.write(QJsonDocument(root).toJson()) >= 0;
+}
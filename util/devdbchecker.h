@@ -0,0 +1,43 @@
+#ifndef DEVDBCHECKER_H
+#define DEVDBCHECKER_H
+
+#include <QString>
+#include <QVector>
+
+#include "devdbpacker.h"
+
+// One inconsistency between the DevDB tree and its part files
+struct DevDbIssue {
+    enum Kind { MissingFile, Unreadable, ChildCountMismatch, FrameCountMismatch };
+    Kind kind;
+    int pitch = -1;         // Pitch segment in the unit, -1 for the whole unit
+    qint64 expected = 0;    // As indexed by the tree
+    qint64 actual = 0;      // As found in the part file
+};
+
+// Check of a single unit
+struct DevDbCheckJob {
+    const DevDbUnit* unit = nullptr;
+    QString path;           // Part file that was read
+    QVector<DevDbIssue> issues;
+};
+
+// Verifies that every part file of a DevDB exists and matches the tree.
+// Part files are parsed header only (frame and sample payloads are seeked
+// over), and every issue is collected instead of stopping at the first one.
+class DevDbChecker
+{
+public:
+    // Thread safe, meant to be run from QtConcurrent::map
+    static void check(DevDbCheckJob& job);
+
+    static QString kindName(DevDbIssue::Kind kind);
+    // One line per issue, for message boxes
+    static QString describe(const DevDbCheckJob& job, const DevDbIssue& issue);
+
+    // Machine readable report of every job
+    static bool writeReport(const QString& reportPath, const QString& treePath,
+                            const QVector<DevDbCheckJob>& jobs, qint64 wallMs);
+};
+
+#endif // DEVDBCHECKER_H
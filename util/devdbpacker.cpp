@@ -0,0 +1,588 @@
+#include "devdbpacker.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFuture>
+#include <QCryptographicHash>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <deque>
+#include <cassert>
+#include <numeric>
+#include <cerrno>
+#include <cstring>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#include "chunk/chunkcreator.h"
+#include "chunk/chunkreaderguards.h"
+#include "chunk/dbvstationaryphupart_devdb.h"
+#include "chunk/dbvarticulationphu_devdb.h"
+#include "chunk/dbvarticulationphupart_devdb.h"
+#include "chunk/soundchunk.h"
+#include "chunk/smsframe.h"
+#include "chunk/item_audioframerefs.h"
+#include "common.h"
+#include "mappedfile.h"
+#include "perftrace.h"
+
+namespace {
+    // Samples kept around the played range of a SND
+    constexpr int64_t SND_PADDING = 0x400;
+    // SND chunk header before the samples
+    constexpr int64_t SND_HEADER_SIZE = 0x12;
+    // Read size for copies
+    constexpr qint64 CopyBlockSize = 1 << 20;
+    // Hex MD4 of the DDB, zero padded, after the phoneme dictionary
+    constexpr int HASH_SEGMENT_SIZE = 260;
+    // Replaces the first 12 bytes of the tree
+    const QByteArray DDI_HEADER("\0\0\0\0\0\0\0\0DBSe", 12);
+
+    template<typename T> QByteArray LittleEndianBytes(T value)
+    {
+        value = qToLittleEndian(value);
+        return QByteArray((const char*)&value, sizeof(value));
+    }
+
+    // Copy up to size bytes of the file from at offset to the end of to in
+    // kernel, or share them outright on filesystems with reflinks. Returns
+    // how many were copied, to must be flushed and is left where it was
+    quint64 KernelCopy(int from, quint64 offset, quint64 size, QFile& to)
+    {
+        quint64 copied = 0;
+#ifdef Q_OS_LINUX
+        loff_t in = offset, out = to.pos();
+        while (copied < size) {
+            ssize_t n = copy_file_range(from, &in, to.handle(), &out, size - copied, 0);
+            if (n <= 0) {
+                break;  // Not supported across these files, finish below
+            }
+            copied += n;
+        }
+#else
+        Q_UNUSED(from);
+        Q_UNUSED(offset);
+        Q_UNUSED(size);
+        Q_UNUSED(to);
+#endif
+        return copied;
+    }
+
+    // Append size bytes of from at offset to the end of to, hashing them on the way
+    bool CopyRange(QFile& from, quint64 offset, quint64 size, QFile& to, QCryptographicHash& hash)
+    {
+        if (!to.flush() || !from.seek(offset)) {
+            return false;
+        }
+        const quint64 target = to.pos();
+        const quint64 copied = KernelCopy(from.handle(), offset, size, to);
+        // The hash needs the bytes anyway: what the kernel copied is only
+        // read back, the rest is read and written
+        if (!to.seek(target + copied)) {
+            return false;
+        }
+        QByteArray buffer;
+        for (quint64 done = 0; done < size; done += buffer.size()) {
+            buffer = from.read(qMin<quint64>(size - done, CopyBlockSize));
+            if (buffer.isEmpty()) {
+                return false;
+            }
+            hash.addData(buffer);
+            qint64 skip = qMin<quint64>(copied - qMin(copied, done), buffer.size());
+            if (skip < buffer.size() && to.write(buffer.constData() + skip, buffer.size() - skip) != buffer.size() - skip) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Same for a range of a mapped file, which the hash reads in place
+    bool CopyMapped(const MappedFile& from, quint64 offset, quint64 size, QFile& to, QCryptographicHash& hash)
+    {
+        if (!from.contains(offset, size) || !to.flush()) {
+            return false;
+        }
+        const char* data = (const char*)from.data() + offset;
+        hash.addData(QByteArray::fromRawData(data, size));
+        const quint64 target = to.pos();
+        const quint64 copied = KernelCopy(from.handle(), offset, size, to);
+        if (!to.seek(target + copied)) {
+            return false;
+        }
+        return to.write(data + copied, size - copied) == (qint64)(size - copied);
+    }
+}
+
+DevDbPacker::DevDbPacker(const QString& devDbFsRoot) :
+    mRoot(devDbFsRoot),
+    mMaxInFlight(0),
+    mPrevious(nullptr),
+    mPreviousDdb(nullptr),
+    mDdbSize(0),
+    mReused(0)
+{
+}
+
+bool DevDbPacker::addPitchRefs(DevDbUnit& unit, BaseChunk* pitchSeg)
+{
+    auto framesDir = dynamic_cast<ItemAudioFrameRefs*>(pitchSeg->GetChildByName("<Frames>"));
+    if (!framesDir) {
+        mError = QString("%1 %2 has no <Frames> in the tree").arg(unit.label, pitchSeg->GetName());
+        return false;
+    }
+
+    DevDbPitchRefs refs;
+    refs.frameFields.reserve(framesDir->Offsets().size());
+    for (int i = 0; i < framesDir->Offsets().size(); i++) {
+        refs.frameFields.append(framesDir->FieldOffset(i));
+    }
+    refs.sndOffsetField = pitchSeg->GetProperty("SND Sample offset").offset;
+    refs.sndCountField = pitchSeg->GetProperty("SND Sample count").offset;
+    auto frameCount = pitchSeg->GetProperty("Frame count").data;
+    if (frameCount.size() >= 4) {
+        refs.frameCount = qFromLittleEndian<quint32>(frameCount.constData());
+    }
+    if (unit.kind != DevDbUnit::Stationary) {
+        refs.sndPlaybackField = pitchSeg->GetProperty("SND Sample offset+800").offset;
+    }
+    unit.pitches.append(refs);
+    return true;
+}
+
+bool DevDbPacker::addStationaries(BaseChunk* stationaryRoot)
+{
+    PERF_SCOPE("Index DevDB stationaries");
+    // Iterate voice colors, stationary segments, then each pitch of the segment
+    foreach(auto voiceColor, stationaryRoot->Children) {
+        foreach(auto staSeg, voiceColor->Children) {
+            foreach(auto pitchSeg, staSeg->Children) {
+                DevDbUnit unit;
+                unit.kind = DevDbUnit::Stationary;
+                unit.path = mRoot + QString("voice/stationary/%1/%2/%3")
+                                        .arg(voiceColor->GetName(),
+                                             Common::devDbDirEncode(staSeg->GetName()),
+                                             Common::devDbDirEncode(pitchSeg->GetName()));
+                unit.label = staSeg->GetName();
+                if (!addPitchRefs(unit, pitchSeg)) {
+                    return false;
+                }
+                mUnits.append(unit);
+            }
+        }
+    }
+    return true;
+}
+
+bool DevDbPacker::addArticulations(BaseChunk* articulationRoot)
+{
+    PERF_SCOPE("Index DevDB articulations");
+    // Iterate begin phonemes, then end phonemes
+    foreach(auto beginPhoneme, articulationRoot->Children) {
+        foreach(auto endPhoneme, beginPhoneme->Children) {
+            // Triphonemes
+            if (endPhoneme->ObjectSignature() == "ART ") {
+                foreach(auto thirdPhoneme, endPhoneme->Children) {
+                    DevDbUnit unit;
+                    unit.kind = DevDbUnit::Triphoneme;
+                    unit.path = mRoot + QString("voice/articulation/%1/%2/%3")
+                                            .arg(Common::devDbDirEncode(beginPhoneme->GetName()),
+                                                 Common::devDbDirEncode(endPhoneme->GetName()),
+                                                 Common::devDbDirEncode(thirdPhoneme->GetName()));
+                    unit.label = QString("%1-%2-%3").arg(beginPhoneme->GetName(),
+                                                         endPhoneme->GetName(),
+                                                         thirdPhoneme->GetName());
+                    foreach(auto pitchSeg, thirdPhoneme->Children) {
+                        if (!addPitchRefs(unit, pitchSeg)) {
+                            return false;
+                        }
+                    }
+                    mUnits.append(unit);
+                }
+                continue;
+            }
+
+            DevDbUnit unit;
+            unit.kind = DevDbUnit::Articulation;
+            unit.path = mRoot + QString("voice/articulation/%1/%2")
+                                    .arg(Common::devDbDirEncode(beginPhoneme->GetName()),
+                                         Common::devDbDirEncode(endPhoneme->GetName()));
+            unit.label = QString("%1-%2").arg(beginPhoneme->GetName(), endPhoneme->GetName());
+            foreach(auto pitchSeg, endPhoneme->Children) {
+                if (!addPitchRefs(unit, pitchSeg)) {
+                    return false;
+                }
+            }
+            mUnits.append(unit);
+        }
+    }
+    return true;
+}
+
+bool DevDbPacker::pack(QFile& ddb, const Progress& progress)
+{
+    PERF_SCOPE("Pack DevDB");
+    mPatches.clear();
+    mRecords.clear();
+    mWarnings.clear();
+    mError.clear();
+    mReused = 0;
+    mDdbHash.clear();
+
+    // Reader flags are thread local but the factory is a lazy singleton,
+    // create it before any worker asks for it
+    ChunkCreator::Get();
+
+    // Units left unchanged since the previous pack, empty path for the ones to parse
+    QVector<DevDbPackUnit> reuse(mUnits.size());
+    if (mPrevious && mPreviousDdb) {
+        QVector<int> indices(mUnits.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        DevDbPackUnit* reuseData = reuse.data();
+        QtConcurrent::blockingMap(indices, [this, reuseData](int i) {
+            reuseData[i] = checkReusable(mUnits[i]);
+        });
+    }
+
+    const int maxInFlight = mMaxInFlight > 0 ? mMaxInFlight : qMax(2, QThread::idealThreadCount() * 2);
+    std::deque<QFuture<PackedUnit>> inFlight;
+    int submitted = 0;
+    quint64 ddbPos = ddb.pos();
+    bool ok = true;
+    // Fed with every byte as it is written, the DDB is never read back
+    QCryptographicHash md4(QCryptographicHash::Md4);
+
+    for (int i = 0; i < mUnits.size() && ok; i++) {
+        // Keep the pool busy, but never hold more than maxInFlight parsed units
+        while (submitted < mUnits.size() && (int)inFlight.size() < maxInFlight) {
+            const DevDbUnit* unit = mUnits.constData() + submitted++;
+            if (reuse[unit - mUnits.constData()].path.isEmpty()) {
+                inFlight.push_back(QtConcurrent::run([this, unit]() { return parseUnit(*unit); }));
+            }
+        }
+
+        if (progress && !progress(i, mUnits[i].path)) {
+            mError = "Packing cancelled";
+            ok = false;
+            break;
+        }
+
+        DevDbPackUnit record;
+        if (!reuse[i].path.isEmpty()) {
+            // Same bytes as last time, only the DDB offset moves
+            record = reuse[i];
+            if (!CopyRange(*mPreviousDdb, record.ddbOffset, record.ddbSize, ddb, md4)) {
+                mError = "Cannot copy " + record.path + " from " + mPreviousDdb->fileName();
+                ok = false;
+                break;
+            }
+            record.ddbOffset = ddbPos;
+            foreach (const auto& ref, record.refs) {
+                mPatches.append(DdiPatch{ ref.first, LittleEndianBytes<quint64>(ddbPos + ref.second) });
+            }
+            mPatches.append(record.patches);
+            ddbPos += record.ddbSize;
+            mRecords.append(record);
+            mReused++;
+            continue;
+        }
+
+        PackedUnit packed = inFlight.front().result();
+        inFlight.pop_front();
+
+        mWarnings.append(packed.warnings);
+        if (!packed.error.isEmpty()) {
+            mError = packed.error;
+            ok = false;
+            break;
+        }
+
+        record = packed.source;
+        record.ddbOffset = ddbPos;
+        foreach (const auto& block, packed.blocks) {
+            if (ddb.write(block.data) != block.data.size()) {
+                mError = "Cannot write " + ddb.fileName() + ": " + ddb.errorString();
+                ok = false;
+                break;
+            }
+            md4.addData(block.data);
+            if (block.sourceSize && !CopyMapped(*block.source, block.sourceOffset, block.sourceSize, ddb, md4)) {
+                mError = "Cannot copy " + record.path + " from " + block.source->path() + " to " + ddb.fileName();
+                ok = false;
+                break;
+            }
+            foreach (const auto& ref, block.refs) {
+                mPatches.append(DdiPatch{ ref.ddiField, LittleEndianBytes<quint64>(ddbPos + ref.addend) });
+                record.refs.append(qMakePair(ref.ddiField, ddbPos + ref.addend - record.ddbOffset));
+            }
+            ddbPos += block.data.size() + block.sourceSize;
+        }
+        mPatches.append(packed.patches);
+        record.ddbSize = ddbPos - record.ddbOffset;
+        record.patches = packed.patches;
+        mRecords.append(record);
+    }
+
+    // Jobs still running point into mUnits
+    for (auto& future : inFlight) {
+        future.waitForFinished();
+    }
+
+    if (!ok) {
+        mPatches.clear();
+        mRecords.clear();
+        return false;
+    }
+
+    // Drop whatever a previous file had past the end, it is not in the hash
+    if (!ddb.flush() || !ddb.resize(ddbPos)) {
+        mError = "Cannot write " + ddb.fileName() + ": " + ddb.errorString();
+        mPatches.clear();
+        mRecords.clear();
+        return false;
+    }
+    mDdbSize = ddbPos;
+    mDdbHash = md4.result().toHex();
+    std::stable_sort(mPatches.begin(), mPatches.end(), [](const DdiPatch& a, const DdiPatch& b) {
+        return a.ddiOffset < b.ddiOffset;
+    });
+    return true;
+}
+
+DevDbPackManifest DevDbPacker::manifest(const QByteArray& treeHash) const
+{
+    DevDbPackManifest manifest;
+    manifest.treeHash = treeHash;
+    manifest.ddbSize = mDdbSize;
+    foreach (const auto& record, mRecords) {
+        manifest.units[record.path] = record;
+    }
+    return manifest;
+}
+
+QString DevDbPacker::resolvePath(const DevDbUnit& unit)
+{
+    if (QFile::exists(unit.path)) {
+        return unit.path;
+    }
+    if (unit.kind != DevDbUnit::Stationary && QFile::exists(unit.path + ".part")) {
+        return unit.path + ".part";
+    }
+    return QString();
+}
+
+DevDbPackUnit DevDbPacker::checkReusable(const DevDbUnit& unit) const
+{
+    auto previous = mPrevious->units.constFind(unit.path.mid(mRoot.size()));
+    if (previous == mPrevious->units.cend() || previous->hash.isEmpty()) {
+        return DevDbPackUnit();
+    }
+
+    QFileInfo info(resolvePath(unit));
+    if (!info.exists() || info.filePath().mid(mRoot.size()) != previous->file || info.size() != previous->size) {
+        return DevDbPackUnit();
+    }
+
+    DevDbPackUnit reused = *previous;
+    qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+    if (mtime != previous->mtime) {
+        // Touched, only rehash to tell whether it really changed
+        if (DevDbPackManifest::hashFile(info.filePath()) != previous->hash) {
+            return DevDbPackUnit();
+        }
+        reused.mtime = mtime;
+    }
+    return reused;
+}
+
+bool DevDbPacker::writeDdi(const QString& treePath, QFile& ddi, quint64 hashOffset)
+{
+    PERF_SCOPE("Write packed DDI");
+    QFile tree(treePath);
+    if (!tree.open(QIODevice::ReadOnly)) {
+        mError = "Cannot open " + treePath;
+        return false;
+    }
+    if ((quint64)tree.size() < hashOffset || hashOffset < (quint64)DDI_HEADER.size()) {
+        mError = "Hash segment offset is outside of " + treePath;
+        return false;
+    }
+
+    const QByteArray hashSegment = mDdbHash.leftJustified(HASH_SEGMENT_SIZE, '\0', true);
+
+    // One pass over the tree, patches are sorted and never overlap
+    QVector<DdiPatch> patches;
+    patches.append(DdiPatch{ 0, DDI_HEADER });
+    patches.append(mPatches);
+    return DdiPatchWriter::write(tree, ddi, patches, mError, hashOffset, hashSegment);
+}
+
+DevDbPacker::PackedUnit DevDbPacker::parseUnit(const DevDbUnit& unit) const
+{
+    PackedUnit packed;
+    // Part files have no leading qwords
+    LeadingQwordGuard qwg(false);
+
+    QString path = resolvePath(unit);
+    if (path.isEmpty()) {
+        packed.error = "Cannot find " + unit.path;
+        return packed;
+    }
+
+    // Stats for the next incremental pack, an empty hash makes it parse again
+    QFileInfo info(path);
+    packed.source.path = unit.path.mid(mRoot.size());
+    packed.source.file = path.mid(mRoot.size());
+    packed.source.size = info.size();
+    packed.source.mtime = info.lastModified().toMSecsSinceEpoch();
+
+    FILE* f = fopen(path.toLatin1(), "rb");
+    if (!f) {
+        packed.warnings.append(QString("Cannot open %1, error %2").arg(path).arg(errno));
+        return packed;
+    }
+    // SND samples are left in the mapping and copied from it to the DDB
+    // without passing through a buffer, read them if it cannot be made
+    QString mapError;
+    auto mapping = MappedFile::Open(path, mapError);
+    if (!mapping) {
+        packed.warnings.append(mapError + ", its samples are read instead");
+    }
+    MappingGuard mg(mapping.data());
+
+    // The mapping already holds the whole file, do not read it a second time
+    packed.source.hash = mapping ? DevDbPackManifest::hashBytes(mapping->data(), mapping->size())
+                                 : DevDbPackManifest::hashFile(path);
+
+    // Within a scope a damaged part file stops with an error instead of
+    // reading past its end
+    QString readError;
+    if (unit.kind == DevDbUnit::Stationary) {
+        ChunkDBVStationaryPhUPart_DevDB STAp;
+        {
+            ChunkReadScope scope(f, path);
+            STAp.Read(f);
+            readError = scope.Error();
+        }
+        fclose(f);
+        if (!readError.isEmpty()) {
+            packed.error = readError;
+            return packed;
+        }
+
+        const auto& refs = unit.pitches.first();
+        if (!packFrames(STAp.framesToWrite, refs, packed)) {
+            packed.error = unit.label + " has fewer frames than the tree";
+            return packed;
+        }
+        if (!STAp.GetChildBySignature("SND ")) {
+            packed.warnings.append("Cannot find SND chunk in " + path);
+            return packed;
+        }
+        packSound(&STAp, STAp.frameCount, STAp.allFramesCount, STAp.skipFrameCount, refs, true, packed);
+        return packed;
+    }
+
+    ChunkDBVArticulationPhU_DevDB ARTu;
+    {
+        ChunkReadScope scope(f, path);
+        ARTu.Read(f);
+        readError = scope.Error();
+    }
+    fclose(f);
+    if (!readError.isEmpty()) {
+        packed.error = readError;
+        return packed;
+    }
+
+    if ((unit.kind == DevDbUnit::Articulation && ARTu.Children.count() != unit.pitches.count()) ||
+        ARTu.Children.count() < unit.pitches.count()) {
+        packed.error = QString("%1 inconsistent sample count (Tree %2 Item %3)")
+                           .arg(unit.label)
+                           .arg(unit.pitches.count())
+                           .arg(ARTu.Children.count());
+        return packed;
+    }
+
+    for (int pitch = 0; pitch < unit.pitches.size(); pitch++) {
+        auto ARTp = (ChunkDBVArticulationPhUPart_DevDB*)(ARTu.Children[pitch]);
+        const auto& refs = unit.pitches[pitch];
+        if (!packFrames(ARTp->framesToWrite, refs, packed)) {
+            packed.error = QString("%1 %2 has fewer frames than the tree").arg(unit.label).arg(pitch);
+            return packed;
+        }
+        if (!ARTp->GetChildBySignature("SND ")) {
+            packed.warnings.append(QString("Missing SND chunk in %1 %2").arg(unit.label).arg(pitch));
+            continue;
+        }
+        packSound(ARTp, ARTp->frameCount, ARTp->allFramesCount, ARTp->skipFrameCount, refs, false, packed);
+    }
+    return packed;
+}
+
+bool DevDbPacker::packFrames(QVector<BaseChunk*>& frames, const DevDbPitchRefs& refs, PackedUnit& packed)
+{
+    foreach (auto field, refs.frameFields) {
+        if (frames.isEmpty()) {
+            return false;
+        }
+        auto frame = frames.takeFirst(); assert(frame->ObjectSignature() == "FRM2");
+        Block block;
+        block.data = ((ChunkSMSFrameChunk*)frame)->rawData;
+        block.refs.append(BlockRef{ field, 0 });
+        packed.blocks.append(block);
+    }
+    return true;
+}
+
+void DevDbPacker::packSound(BaseChunk* part, size_t frameCount, size_t allFramesCount, size_t skipFrameCount,
+                            const DevDbPitchRefs& refs, bool stationary, PackedUnit& packed)
+{
+    auto snd = (ChunkSoundChunk*)(part->GetChildBySignature("SND "));
+    if (allFramesCount == 0) {
+        packed.warnings.append(part->GetName() + " has no frames, SND skipped");
+        return;
+    }
+
+    double samplePerFrame = (double)snd->sampleCount / (double)allFramesCount;
+    int64_t playbackStart = samplePerFrame * skipFrameCount;
+    int64_t sndFrom = qMax<int64_t>(0, playbackStart - SND_PADDING);
+    int64_t sndTo = qMin<int64_t>(snd->sampleCount, playbackStart + samplePerFrame * frameCount + SND_PADDING);
+    int64_t actualSampleCount = sndTo - sndFrom;
+    int64_t paddingBefore = playbackStart - sndFrom;       // Samples before playback start
+    int64_t samplesAfterPlayback = sndTo - playbackStart;  // Samples from playback start to end
+
+    if (paddingBefore < SND_PADDING) {
+        qWarning() << (stationary ? "STAp" : "ARTp") << "EDGE CASE:" << part->GetName()
+                   << "paddingBefore:" << paddingBefore << "(expected 1024)";
+    }
+
+    Block block;
+    if (snd->mapping) {
+        block.data = snd->GetTruncatedHeader(sndFrom, sndTo);
+        block.source = snd->mapping;
+        const auto range = snd->SampleBytes(sndFrom, sndTo);
+        block.sourceOffset = range.first;
+        block.sourceSize = range.second;
+    } else {
+        block.data = snd->GetTruncatedChunk(sndFrom, sndTo);
+    }
+    if (stationary) {
+        // Only one offset field exists, it points to playback start.
+        // The engine adds 2*sampleIndex to this offset, so sample 0 reads from here
+        block.refs.append(BlockRef{ refs.sndOffsetField, SND_HEADER_SIZE + paddingBefore * 2 });
+        // Samples available from playback start, for boundary checking
+        packed.patches.append(DdiPatch{ refs.sndCountField, LittleEndianBytes<quint32>(samplesAfterPlayback) });
+    } else {
+        // "SND Sample offset" (offset 440) is the boundary and points to the data start,
+        // "SND Sample offset+800" (offset 448) is the playback start
+        block.refs.append(BlockRef{ refs.sndOffsetField, SND_HEADER_SIZE });
+        block.refs.append(BlockRef{ refs.sndPlaybackField, SND_HEADER_SIZE + paddingBefore * 2 });
+        packed.patches.append(DdiPatch{ refs.sndCountField, LittleEndianBytes<quint32>(actualSampleCount) });
+    }
+    packed.blocks.append(block);
+}
@@ -0,0 +1,135 @@
+#ifndef DEVDBPACKER_H
+#define DEVDBPACKER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <functional>
+
+#include "devdbpackmanifest.h"
+
+class BaseChunk;
+class QFile;
+class MappedFile;
+
+// DDI fields of one pitch segment that receive DDB offsets, resolved from
+// the tree up front so workers never touch it
+struct DevDbPitchRefs {
+    QVector<quint64> frameFields;   // "<Frames>" entries, in frame order
+    quint64 sndOffsetField = 0;     // "SND Sample offset"
+    quint64 sndPlaybackField = 0;   // "SND Sample offset+800", articulations only
+    quint64 sndCountField = 0;      // "SND Sample count"
+    quint32 frameCount = 0;         // "Frame count" as indexed by the tree
+};
+
+// One DevDB part file and the tree entries it fills
+struct DevDbUnit {
+    enum Kind { Stationary, Articulation, Triphoneme };
+    Kind kind;
+    QString path;                   // Articulations may carry an extra ".part" suffix on disk
+    QString label;                  // Phoneme names for messages
+    QVector<DevDbPitchRefs> pitches;
+};
+
+// Packs DevDB part files into a DDB.
+// Part files are parsed on the global thread pool with a bounded number of
+// jobs in flight, while the calling thread consumes the results in tree
+// order and appends them to the DDB, so the output is identical to a serial
+// pack. The DDB is hashed as it is written, and DDI offset fields are
+// collected as patches, which are applied in one ascending pass while the
+// final DDI is streamed from the tree.
+// Given the manifest and DDB of a previous pack of the same tree, units whose
+// part file did not change are copied over from the old DDB instead of being
+// parsed again, with their DDI fields rebased to the new position.
+class DevDbPacker
+{
+public:
+    // Return false to cancel
+    typedef std::function<bool(int unitIndex, const QString& path)> Progress;
+
+    explicit DevDbPacker(const QString& devDbFsRoot);
+
+    // Collect units from the DDI tree, in pack order
+    bool addStationaries(BaseChunk* stationaryRoot);
+    bool addArticulations(BaseChunk* articulationRoot);
+    const QVector<DevDbUnit>& units() const { return mUnits; }
+
+    // 0 picks twice the ideal thread count
+    void setMaxInFlight(int jobs) { mMaxInFlight = jobs; }
+
+    // Both must outlive pack(). The manifest must come from the same tree
+    void setPrevious(const DevDbPackManifest* manifest, QFile* ddb) { mPrevious = manifest; mPreviousDdb = ddb; }
+
+    // Append every unit to ddb at its current position
+    bool pack(QFile& ddb, const Progress& progress = Progress());
+
+    // Sorted by DDI offset once pack() succeeded
+    const QVector<DdiPatch>& patches() const { return mPatches; }
+    // Hex MD4 of the whole DDB written by pack()
+    QByteArray ddbHash() const { return mDdbHash; }
+
+    // Write the packed DDI from the tree it was indexed from: patches applied,
+    // header replaced and the DDB hash segment inserted at hashOffset (the end
+    // of the phoneme dictionary). Reads and writes sequentially in fixed blocks.
+    bool writeDdi(const QString& treePath, QFile& ddi, quint64 hashOffset);
+
+    // Path of the unit's part file on disk, empty when missing. Thread safe
+    static QString resolvePath(const DevDbUnit& unit);
+
+    // Units or pitches skipped without aborting
+    const QStringList& warnings() const { return mWarnings; }
+    int reusedCount() const { return mReused; }
+
+    // Describes the last successful pack() for the next incremental one
+    DevDbPackManifest manifest(const QByteArray& treeHash) const;
+    QString getError() const { return mError; }
+
+private:
+    struct BlockRef {
+        quint64 ddiField;
+        qint64 addend;              // Added to the block's DDB offset
+    };
+    struct Block {
+        QByteArray data;
+        // Then sourceSize bytes of source at sourceOffset, copied without a buffer
+        QSharedPointer<MappedFile> source;
+        quint64 sourceOffset = 0;
+        quint64 sourceSize = 0;
+        QVector<BlockRef> refs;
+    };
+    // Parsed unit, ready to be appended
+    struct PackedUnit {
+        QVector<Block> blocks;
+        QVector<DdiPatch> patches;    // Not depending on DDB offsets
+        QStringList warnings;
+        QString error;                  // Aborts the pack
+        DevDbPackUnit source;           // File stats, no DDB range yet
+    };
+
+    bool addPitchRefs(DevDbUnit& unit, BaseChunk* pitchSeg);
+
+    // Thread safe
+    DevDbPackUnit checkReusable(const DevDbUnit& unit) const;
+    PackedUnit parseUnit(const DevDbUnit& unit) const;
+    static bool packFrames(QVector<BaseChunk*>& frames, const DevDbPitchRefs& refs, PackedUnit& packed);
+    static void packSound(BaseChunk* part, size_t frameCount, size_t allFramesCount, size_t skipFrameCount,
+                          const DevDbPitchRefs& refs, bool stationary, PackedUnit& packed);
+
+private:
+    QString mRoot;
+    QVector<DevDbUnit> mUnits;
+    int mMaxInFlight;
+    const DevDbPackManifest* mPrevious;
+    QFile* mPreviousDdb;
+    QVector<DdiPatch> mPatches;
+    QVector<DevDbPackUnit> mRecords;
+    quint64 mDdbSize;
+    QByteArray mDdbHash;
+    int mReused;
+    QStringList mWarnings;
+    QString mError;
+};
+
+#endif // DEVDBPACKER_H
@@ -0,0 +1,141 @@
+#include "devdbpackmanifest.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QVariant>
+
+namespace {
+    // QJsonValue::toInteger() is Qt 6 only, and the variant keeps all 64 bits
+    qint64 ToInt64(const QJsonValue& value, qint64 defaultValue = 0)
+    {
+        return value.isUndefined() ? defaultValue : value.toVariant().toLongLong();
+    }
+
+    quint64 ToUInt64(const QJsonValue& value)
+    {
+        return value.toVariant().toULongLong();
+    }
+}
+
+bool DevDbPackManifest::load(const QString& path)
+{
+    treeHash.clear();
+    ddbSize = 0;
+    units.clear();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        mError = "Cannot open " + path;
+        return false;
+    }
+
+    QJsonParseError parseError;
+    auto doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (doc.isNull()) {
+        mError = path + ": " + parseError.errorString();
+        return false;
+    }
+
+    auto root = doc.object();
+    if (root["version"].toInt() != Version) {
+        mError = path + ": unsupported manifest version";
+        return false;
+    }
+    treeHash = root["tree"].toString().toLatin1();
+    ddbSize = ToUInt64(root["ddbSize"]);
+
+    foreach (const auto& value, root["units"].toArray()) {
+        auto obj = value.toObject();
+        DevDbPackUnit unit;
+        unit.path = obj["path"].toString();
+        unit.file = obj["file"].toString();
+        unit.size = ToInt64(obj["size"], -1);
+        unit.mtime = ToInt64(obj["mtime"]);
+        unit.hash = obj["hash"].toString().toLatin1();
+        unit.ddbOffset = ToUInt64(obj["offset"]);
+        unit.ddbSize = ToUInt64(obj["length"]);
+        foreach (const auto& ref, obj["refs"].toArray()) {
+            auto pair = ref.toArray();
+            unit.refs.append({ ToUInt64(pair[0]), ToUInt64(pair[1]) });
+        }
+        foreach (const auto& patch, obj["patches"].toArray()) {
+            auto pair = patch.toArray();
+            unit.patches.append(DdiPatch{ ToUInt64(pair[0]), QByteArray::fromHex(pair[1].toString().toLatin1()) });
+        }
+        units[unit.path] = unit;
+    }
+    return true;
+}
+
+bool DevDbPackManifest::save(const QString& path) const
+{
+    QJsonArray unitsArray;
+    foreach (const auto& unit, units) {
+        QJsonArray refs, patches;
+        foreach (const auto& ref, unit.refs) {
+            refs.append(QJsonArray{ (qint64)ref.first, (qint64)ref.second });
+        }
+        foreach (const auto& patch, unit.patches) {
+            patches.append(QJsonArray{ (qint64)patch.ddiOffset, QString::fromLatin1(patch.data.toHex()) });
+        }
+        unitsArray.append(QJsonObject{
+            { "path", unit.path },
+            { "file", unit.file },
+            { "size", unit.size },
+            { "mtime", unit.mtime },
+            { "hash", QString::fromLatin1(unit.hash) },
+            { "offset", (qint64)unit.ddbOffset },
+            { "length", (qint64)unit.ddbSize },
+            { "refs", refs },
+            { "patches", patches },
+        });
+    }
+
+    QJsonObject root{
+        { "version", Version },
+        { "tree", QString::fromLatin1(treeHash) },
+        { "ddbSize", (qint64)ddbSize },
+        { "units", unitsArray },
+    };
+
+    // Never leave a truncated manifest behind, it would be trusted next time
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        mError = "Cannot write " + path;
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        mError = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+QByteArray DevDbPackManifest::hashFile(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    if (!hash.addData(&file)) {
+        return QByteArray();
+    }
+    return hash.result().toHex();
+}
+
+QByteArray DevDbPackManifest::hashBytes(const uchar* data, qint64 size)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    // Qt 5 takes the length as an int
+    constexpr qint64 Step = 1 << 30;
+    for (qint64 done = 0; done < size; done += Step) {
+        hash.addData(QByteArray::fromRawData((const char*)data + done, qMin(Step, size - done)));
+    }
+    return hash.result().toHex();
+}
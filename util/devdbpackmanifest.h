@@ -0,0 +1,49 @@
+#ifndef DEVDBPACKMANIFEST_H
+#define DEVDBPACKMANIFEST_H
+
+#include <QString>
+#include <QVector>
+#include <QMap>
+#include <QPair>
+#include <QByteArray>
+
+#include "ddipatchwriter.h"
+
+// Where one DevDB part file ended up in the DDB
+struct DevDbPackUnit {
+    QString path;           // Relative to the DevDB root, as named by the tree
+    QString file;           // Relative path actually read, may end with ".part"
+    qint64 size = -1;
+    qint64 mtime = 0;       // ms since epoch
+    QByteArray hash;        // Md5 hex of the file, empty when it could not be read
+    quint64 ddbOffset = 0;
+    quint64 ddbSize = 0;
+    QVector<QPair<quint64, quint64>> refs;  // DDI field, DDB offset relative to ddbOffset
+    QVector<DdiPatch> patches;              // Patches not depending on the DDB offset
+};
+
+// Record of a DevDB pack, saved next to the DDB as JSON so the next pack of
+// the same tree only has to parse the part files changed since.
+class DevDbPackManifest
+{
+public:
+    static constexpr int Version = 1;
+
+    bool load(const QString& path);
+    bool save(const QString& path) const;
+    QString getError() const { return mError; }
+
+    // Md5 hex of a whole file, empty on error
+    static QByteArray hashFile(const QString& path);
+    // The same of bytes already in memory, such as a mapped file
+    static QByteArray hashBytes(const uchar* data, qint64 size);
+
+    QByteArray treeHash;            // The .tree the DDI was copied from
+    quint64 ddbSize = 0;
+    QMap<QString, DevDbPackUnit> units;
+
+private:
+    mutable QString mError;
+};
+
+#endif // DEVDBPACKMANIFEST_H
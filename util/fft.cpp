@@ -0,0 +1,65 @@
+#include "fft.h"
+
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+Fft::Fft(int size) :
+    mSize(IsPowerOfTwo(size) ? size : 2)
+{
+    int bits = 0;
+    while ((1 << bits) < mSize) bits++;
+
+    mBitReverse.resize(mSize);
+    for (int i = 0; i < mSize; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        }
+        mBitReverse[i] = r;
+    }
+
+    mTwiddles.resize(mSize / 2);
+    for (int i = 0; i < mSize / 2; i++) {
+        double angle = -2.0 * M_PI * i / mSize;
+        mTwiddles[i] = std::complex<float>((float)cos(angle), (float)sin(angle));
+    }
+}
+
+void Fft::forward(std::complex<float>* data) const
+{
+    for (int i = 0; i < mSize; i++) {
+        int j = mBitReverse[i];
+        if (j > i) std::swap(data[i], data[j]);
+    }
+
+    for (int len = 2; len <= mSize; len <<= 1) {
+        int half = len / 2;
+        int step = mSize / len;
+        for (int start = 0; start < mSize; start += len) {
+            for (int k = 0; k < half; k++) {
+                std::complex<float> t = mTwiddles[k * step] * data[start + k + half];
+                std::complex<float> u = data[start + k];
+                data[start + k] = u + t;
+                data[start + k + half] = u - t;
+            }
+        }
+    }
+}
+
+void Fft::magnitudes(const float* in, float* out) const
+{
+    mScratch.resize(mSize);
+    std::complex<float>* data = mScratch.data();
+    for (int i = 0; i < mSize; i++) {
+        data[i] = std::complex<float>(in[i], 0.0f);
+    }
+
+    forward(data);
+
+    for (int i = 0; i <= mSize / 2; i++) {
+        out[i] = std::abs(data[i]);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <QVector>
+#include <complex>
+
+// In place iterative radix-2 FFT of a fixed power of two size.
+// Twiddles and the bit reversal table are computed once per instance,
+// so keep one around per worker instead of recreating it per frame.
+class Fft
+{
+public:
+    explicit Fft(int size);
+
+    int size() const { return mSize; }
+
+    // Forward complex transform, data must hold size() values
+    void forward(std::complex<float>* data) const;
+
+    // Magnitude spectrum of size() real samples, out receives size() / 2 + 1 bins.
+    // The input is copied, apply any window beforehand.
+    void magnitudes(const float* in, float* out) const;
+
+    static bool IsPowerOfTwo(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+private:
+    int mSize;
+    QVector<int> mBitReverse;
+    QVector<std::complex<float>> mTwiddles;
+    mutable QVector<std::complex<float>> mScratch;
+};
+
+#endif // FFT_H
@@ -0,0 +1,28 @@
+#include "mappedfile.h"
+
+QSharedPointer<MappedFile> MappedFile::Open(const QString& path, QString& error)
+{
+    QSharedPointer<MappedFile> file(new MappedFile);
+    file->mFile.setFileName(path);
+    if (!file->mFile.open(QIODevice::ReadOnly)) {
+        error = "Cannot open " + path + ": " + file->mFile.errorString();
+        return QSharedPointer<MappedFile>();
+    }
+    file->mSize = file->mFile.size();
+    // An empty file cannot be mapped, but has nothing to point into either
+    if (file->mSize) {
+        file->mData = file->mFile.map(0, file->mSize);
+        if (!file->mData) {
+            error = "Cannot map " + path + ": " + file->mFile.errorString();
+            return QSharedPointer<MappedFile>();
+        }
+    }
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+    if (mData) {
+        mFile.unmap(mData);
+    }
+}
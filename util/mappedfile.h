@@ -0,0 +1,36 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <QSharedPointer>
+
+// A whole file mapped read only. Chunks leaving their payload in the file
+// keep a shared pointer to it, the mapping goes with the last of them
+class MappedFile : public QEnableSharedFromThis<MappedFile>
+{
+public:
+    // nullptr with error set when the file cannot be opened or mapped
+    static QSharedPointer<MappedFile> Open(const QString& path, QString& error);
+    ~MappedFile();
+
+    const uchar* data() const { return mData; }
+    qint64 size() const { return mSize; }
+    // Descriptor of the open file, for copies left to the kernel
+    int handle() const { return mFile.handle(); }
+    QString path() const { return mFile.fileName(); }
+
+    // Whether length bytes at offset are mapped
+    bool contains(quint64 offset, quint64 length) const {
+        return mData && offset <= (quint64)mSize && length <= (quint64)mSize - offset;
+    }
+
+private:
+    MappedFile() = default;
+
+private:
+    QFile mFile;
+    uchar* mData = nullptr;
+    qint64 mSize = 0;
+};
+
+#endif // MAPPEDFILE_H
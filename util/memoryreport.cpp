@@ -0,0 +1,197 @@
+#include "memoryreport.h"
+
+#include <QTreeWidgetItem>
+#include <algorithm>
+
+#include "chunk/basechunk.h"
+#include "chunk/soundchunk.h"
+#include "chunk/smsframe.h"
+#include "chunk/item_audioframerefs.h"
+#include "chunk/dbvstationaryphupart_devdb.h"
+#include "chunk/dbvarticulationphupart_devdb.h"
+
+namespace {
+    // Red-black tree links and colour, then the key and value held in place
+    constexpr quint64 MapNodeBytes = 4 * sizeof(void*) + sizeof(QString) + sizeof(ChunkProperty);
+    // Qt keeps item data privately as display values and (role, value) pairs per column
+    constexpr quint64 ItemDataBytes = sizeof(QVariant) + sizeof(void*);
+
+    const int ItemRoles[] = { BaseChunk::ItemChunkRole, BaseChunk::ItemPropDataRole,
+                              BaseChunk::ItemPropNameRole, BaseChunk::DdbSoundReferredOffsetRole };
+}
+
+const quint64 MemoryReport::BlockHeader = sizeof(QArrayData);
+
+void MemoryReport::addTree(BaseChunk* root)
+{
+    if (!root) {
+        return;
+    }
+    addChunk(root, false);
+    foreach (auto child, root->Children) {
+        addTree(child);
+    }
+}
+
+void MemoryReport::addDdbChunk(BaseChunk* chunk)
+{
+    if (chunk) {
+        addChunk(chunk, true);
+    }
+}
+
+void MemoryReport::addChunk(BaseChunk* chunk, bool ddb)
+{
+    const QString signature = QString::fromLatin1(chunk->ObjectSignature());
+    const QString objects = ddb ? "DDB index entries" : "Chunk objects";
+    add(objects, signature, 1,
+        chunk->ObjectSize() + byteArrayBytes(chunk->GetSignature()) + stringBytes(chunk->GetName()));
+
+    const auto& props = chunk->GetPropertiesMap();
+    quint64 keys = 0, payloads = 0;
+    for (auto i = props.cbegin(); i != props.cend(); i++) {
+        keys += stringBytes(i.key());
+        payloads += byteArrayBytes(i->data);
+    }
+    const quint64 nodes = props.size() * MapNodeBytes;
+    if (ddb) {
+        add(objects, signature, 0, keys + payloads + nodes);
+    } else {
+        add("Property keys", QString(), props.size(), keys);
+        add("Property payloads", QString(), props.size(), payloads);
+        add("Property map nodes", QString(), props.size(), nodes);
+    }
+
+    if (!chunk->Children.isEmpty()) {
+        add(ddb ? objects : "Child vectors", ddb ? signature : "Children", ddb ? 0 : 1, vectorBytes(chunk->Children));
+    }
+
+    if (auto sound = dynamic_cast<ChunkSoundChunk*>(chunk)) {
+        add("Raw frame buffers", "SND sampleData", 1, byteArrayBytes(sound->sampleData));
+    } else if (auto frame = dynamic_cast<ChunkSMSFrameChunk*>(chunk)) {
+        add("Raw frame buffers", "FRM2 rawData", 1, byteArrayBytes(frame->rawData));
+    } else if (auto refs = dynamic_cast<ItemAudioFrameRefs*>(chunk)) {
+        add("Frame reference arrays", QString(), refs->Offsets().size(), vectorBytes(refs->Offsets()));
+    } else if (auto part = dynamic_cast<ChunkDBVStationaryPhUPart_DevDB*>(chunk)) {
+        add("Child vectors", "Frames to write", 1, vectorBytes(part->framesToWrite));
+    } else if (auto part = dynamic_cast<ChunkDBVArticulationPhUPart_DevDB*>(chunk)) {
+        add("Child vectors", "Frames to write", 1, vectorBytes(part->framesToWrite));
+    }
+}
+
+void MemoryReport::addTreeItems(const QString& detail, QTreeWidgetItem* item)
+{
+    quint64 count = 0, bytes = 0;
+    QVector<QTreeWidgetItem*> pending { item };
+    while (!pending.isEmpty()) {
+        auto parent = pending.takeLast();
+        if (parent->childCount()) {
+            bytes += BlockHeader + parent->childCount() * sizeof(void*);
+        }
+        for (int i = 0; i < parent->childCount(); i++) {
+            auto child = parent->child(i);
+            pending.append(child);
+            count++;
+            bytes += sizeof(QTreeWidgetItem);
+            for (int column = 0; column < child->columnCount(); column++) {
+                bytes += ItemDataBytes + stringBytes(child->text(column));
+            }
+            for (auto role : ItemRoles) {
+                if (child->data(0, role).isValid()) {
+                    bytes += ItemDataBytes;
+                }
+            }
+        }
+    }
+    add("Tree widget items", detail, count, bytes);
+}
+
+void MemoryReport::add(const QString& category, const QString& detail, quint64 count, quint64 bytes)
+{
+    if (!count && !bytes) {
+        return;
+    }
+    const auto key = qMakePair(category, detail);
+    auto found = mIndex.constFind(key);
+    if (found == mIndex.cend()) {
+        found = mIndex.insert(key, mRows.size());
+        mRows.append(MemoryReportRow { category, detail, 0, 0 });
+    }
+    mRows[*found].count += count;
+    mRows[*found].bytes += bytes;
+    mTotal += bytes;
+}
+
+QVector<MemoryReportRow> MemoryReport::rows() const
+{
+    QHash<QString, int> order;
+    foreach (const auto& row, mRows) {
+        if (!order.contains(row.category)) {
+            order.insert(row.category, order.size());
+        }
+    }
+    auto rows = mRows;
+    std::stable_sort(rows.begin(), rows.end(), [&](const MemoryReportRow& a, const MemoryReportRow& b) {
+        if (a.category != b.category) {
+            return order[a.category] < order[b.category];
+        }
+        return a.bytes > b.bytes;
+    });
+    return rows;
+}
+
+QString MemoryReport::text() const
+{
+    QString text;
+    QString category;
+    foreach (const auto& row, rows()) {
+        if (row.category != category) {
+            category = row.category;
+            quint64 count = 0, bytes = 0;
+            foreach (const auto& other, mRows) {
+                if (other.category == category) {
+                    count += other.count;
+                    bytes += other.bytes;
+                }
+            }
+            text += category.leftJustified(34) + QString::number(count).rightJustified(14)
+                    + FormatBytes(bytes).rightJustified(12) + '\n';
+        }
+        if (!row.detail.isEmpty()) {
+            text += ("  " + row.detail).leftJustified(34) + QString::number(row.count).rightJustified(14)
+                    + FormatBytes(row.bytes).rightJustified(12) + '\n';
+        }
+    }
+    text += QString("Total").leftJustified(48) + FormatBytes(mTotal).rightJustified(12) + '\n';
+    return text;
+}
+
+QString MemoryReport::FormatBytes(quint64 bytes)
+{
+    if (bytes >= 1 << 20) {
+        return QString("%1 MB").arg(bytes / double(1 << 20), 0, 'f', 2);
+    }
+    if (bytes >= 1 << 10) {
+        return QString("%1 KB").arg(bytes / double(1 << 10), 0, 'f', 1);
+    }
+    return QString("%1 B").arg(bytes);
+}
+
+quint64 MemoryReport::byteArrayBytes(const QByteArray& data)
+{
+    return claim(data.constData(), data.capacity()) ? BlockHeader + data.capacity() + 1 : 0;
+}
+
+quint64 MemoryReport::stringBytes(const QString& string)
+{
+    return claim(string.constData(), string.capacity()) ? BlockHeader + (string.capacity() + 1) * sizeof(QChar) : 0;
+}
+
+bool MemoryReport::claim(const void* block, qsizetype capacity)
+{
+    if (!capacity || mBlocks.contains(block)) {
+        return false;
+    }
+    mBlocks.insert(block);
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef MEMORYREPORT_H
+#define MEMORYREPORT_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+
+class BaseChunk;
+class QTreeWidgetItem;
+
+struct MemoryReportRow {
+    QString category;
+    QString detail;         // Signature or owner, may be empty
+    quint64 count;
+    quint64 bytes;
+};
+
+// Bytes held by a loaded bank, counted by walking it rather than by hooking
+// the allocator: the sizeof of every object plus the heap blocks behind its
+// containers, at their capacity. A block shared by implicitly shared copies
+// is counted once. Allocator headers and padding are left out, so the
+// totals are a lower bound.
+class MemoryReport
+{
+public:
+    // DDI chunks under root, root included
+    void addTree(BaseChunk* root);
+    // A chunk read from the DDB, all of it under DDB index entries but its frame bytes
+    void addDdbChunk(BaseChunk* chunk);
+    // Items under item, item excluded, QTreeWidget::invisibleRootItem() for a whole tree
+    void addTreeItems(const QString& detail, QTreeWidgetItem* item);
+    // Anything else, such as caches of the views
+    void add(const QString& category, const QString& detail, quint64 count, quint64 bytes);
+
+    // Categories in the order first added, largest detail first
+    QVector<MemoryReportRow> rows() const;
+    quint64 totalBytes() const { return mTotal; }
+    // Aligned table for the command line
+    QString text() const;
+
+    static QString FormatBytes(quint64 bytes);
+
+    // Heap bytes of a block not counted yet, 0 for raw data and empty containers
+    quint64 byteArrayBytes(const QByteArray& data);
+    quint64 stringBytes(const QString& string);
+    template<typename T>
+    quint64 vectorBytes(const QVector<T>& vector) {
+        return claim(vector.constData(), vector.capacity()) ? BlockHeader + vector.capacity() * sizeof(T) : 0;
+    }
+
+private:
+    static const quint64 BlockHeader;
+
+    void addChunk(BaseChunk* chunk, bool ddb);
+    bool claim(const void* block, qsizetype capacity);
+
+private:
+    QVector<MemoryReportRow> mRows;
+    QHash<QPair<QString, QString>, int> mIndex;
+    QSet<const void*> mBlocks;
+    quint64 mTotal = 0;
+};
+
+#endif // MEMORYREPORT_H
@@ -0,0 +1,204 @@
+#include "perftrace.h"
+
+#ifdef DDIVIEW_PERF_TRACE
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QHash>
+#include <QPair>
+#include <QFile>
+#include <QAtomicInt>
+#include <algorithm>
+
+namespace {
+    // Past this many events only the aggregates grow
+    constexpr int MaxEvents = 4 << 20;
+    constexpr int FlushSize = 1 << 20;
+
+    struct Event {
+        const char* name;
+        uint32_t tag;
+        int thread;
+        qint64 start, duration;
+        quint64 bytes;
+    };
+
+    struct Total {
+        quint64 count = 0;
+        qint64 totalNs = 0, selfNs = 0;
+        quint64 bytes = 0;
+    };
+
+    struct State {
+        QMutex mutex;
+        QElapsedTimer clock;
+        QVector<Event> events;
+        QHash<QPair<quintptr, uint32_t>, Total> totals;    // by name pointer and tag
+        bool dropped = false;
+
+        State() { clock.start(); }
+    };
+
+    State& GetState()
+    {
+        static State state;
+        return state;
+    }
+
+    thread_local PerfTrace::Scope* CurrentScope = nullptr;
+    thread_local int ThreadIndex = -1;
+    QAtomicInt ThreadCount;
+
+    int CurrentThread()
+    {
+        if (ThreadIndex < 0) {
+            ThreadIndex = ThreadCount.fetchAndAddRelaxed(1) + 1;
+        }
+        return ThreadIndex;
+    }
+
+    // Tags are FourCCs, first character in the low byte
+    QByteArray Label(const char* name, uint32_t tag)
+    {
+        QByteArray label(name);
+        if (tag) {
+            label += ' ';
+            for (int i = 0; i < 4; i++) {
+                const char c = (tag >> (8 * i)) & 0xFF;
+                label += (c >= 0x20 && c < 0x7F && c != '"' && c != '\\') ? c : '?';
+            }
+        }
+        return label;
+    }
+}
+
+PerfTrace::Scope::Scope(const char* name, uint32_t tag) :
+    mName(name),
+    mTag(tag),
+    mStart(GetState().clock.nsecsElapsed()),
+    mChildren(0),
+    mBytes(0),
+    mParent(CurrentScope)
+{
+    CurrentScope = this;
+}
+
+PerfTrace::Scope::~Scope()
+{
+    auto& state = GetState();
+    const qint64 duration = state.clock.nsecsElapsed() - mStart;
+    CurrentScope = mParent;
+    if (mParent) {
+        mParent->mChildren += duration;
+    }
+    const int thread = CurrentThread();
+
+    QMutexLocker lock(&state.mutex);
+    auto& total = state.totals[qMakePair((quintptr)mName, mTag)];
+    total.count++;
+    total.totalNs += duration;
+    total.selfNs += duration - mChildren;
+    total.bytes += mBytes;
+    if (state.events.size() < MaxEvents) {
+        state.events.append(Event { mName, mTag, thread, mStart, duration, mBytes });
+    } else {
+        state.dropped = true;
+    }
+}
+
+QVector<PerfTrace::Summary> PerfTrace::Summarize()
+{
+    auto& state = GetState();
+    QMutexLocker lock(&state.mutex);
+
+    // The same name from two translation units may be two pointers
+    QHash<QByteArray, Summary> merged;
+    for (auto i = state.totals.cbegin(); i != state.totals.cend(); i++) {
+        const QByteArray label = Label((const char*)i.key().first, i.key().second);
+        auto& summary = merged[label];
+        summary.name = QString::fromLatin1(label);
+        summary.count += i->count;
+        summary.totalNs += i->totalNs;
+        summary.selfNs += i->selfNs;
+        summary.bytes += i->bytes;
+    }
+
+    QVector<Summary> summaries;
+    for (const auto& summary : merged) {
+        summaries.append(summary);
+    }
+    std::sort(summaries.begin(), summaries.end(), [](const Summary& a, const Summary& b) {
+        return a.totalNs > b.totalNs;
+    });
+    return summaries;
+}
+
+quint64 PerfTrace::EventCount()
+{
+    auto& state = GetState();
+    QMutexLocker lock(&state.mutex);
+    return state.events.size();
+}
+
+bool PerfTrace::EventsDropped()
+{
+    auto& state = GetState();
+    QMutexLocker lock(&state.mutex);
+    return state.dropped;
+}
+
+void PerfTrace::Clear()
+{
+    auto& state = GetState();
+    QMutexLocker lock(&state.mutex);
+    state.events.clear();
+    state.totals.clear();
+    state.dropped = false;
+}
+
+bool PerfTrace::WriteChromeTrace(const QString& path, QString& error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = "Cannot write " + path;
+        return false;
+    }
+
+    auto& state = GetState();
+    QMutexLocker lock(&state.mutex);
+
+    QByteArray buffer;
+    buffer.reserve(FlushSize + 4096);
+    buffer += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& event : state.events) {
+        if (!first) {
+            buffer += ",\n";
+        }
+        first = false;
+        // Complete events, times in microseconds
+        buffer += "{\"name\":\"" + Label(event.name, event.tag) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                  + QByteArray::number(event.thread)
+                  + ",\"ts\":" + QByteArray::number(event.start / 1000.0, 'f', 3)
+                  + ",\"dur\":" + QByteArray::number(event.duration / 1000.0, 'f', 3);
+        if (event.bytes) {
+            buffer += ",\"args\":{\"bytes\":" + QByteArray::number(event.bytes) + "}";
+        }
+        buffer += "}";
+        if (buffer.size() >= FlushSize) {
+            if (file.write(buffer) != buffer.size()) {
+                error = "Cannot write " + path + ": " + file.errorString();
+                return false;
+            }
+            buffer.clear();
+        }
+    }
+    buffer += "\n]}\n";
+    if (file.write(buffer) != buffer.size()) {
+        error = "Cannot write " + path + ": " + file.errorString();
+        return false;
+    }
+    return true;
+}
+
+#endif
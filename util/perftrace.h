@@ -0,0 +1,66 @@
+#ifndef PERFTRACE_H
+#define PERFTRACE_H
+
+// Scoped timers for parsing and long actions, built in with the
+// DDIVIEW_PERF_TRACE CMake option. Without it every macro expands to
+// nothing, arguments included.
+//
+//   PERF_SCOPE("Parse DDI");                   // until the end of the block
+//   PERF_SCOPE_TAGGED(perf, "Read", sig);      // sig: FourCC told apart per value
+//   PERF_BYTES(perf, size);                    // bytes handled by that scope
+//
+// Every scope is aggregated by name and tag (count, total and self time,
+// bytes) and kept as an event for the Chrome trace export.
+
+#ifdef DDIVIEW_PERF_TRACE
+
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+namespace PerfTrace {
+    struct Summary {
+        QString name;
+        quint64 count;
+        qint64 totalNs, selfNs;     // self leaves out nested scopes
+        quint64 bytes;
+    };
+
+    class Scope {
+    public:
+        explicit Scope(const char* name, uint32_t tag = 0);
+        ~Scope();
+        void addBytes(quint64 bytes) { mBytes += bytes; }
+
+    private:
+        const char* mName;
+        uint32_t mTag;
+        qint64 mStart, mChildren;
+        quint64 mBytes;
+        Scope* mParent;
+    };
+
+    // Sorted by total time, longest first
+    QVector<Summary> Summarize();
+    quint64 EventCount();
+    bool EventsDropped();
+    void Clear();
+    // Trace event JSON, as read by chrome://tracing and Perfetto
+    bool WriteChromeTrace(const QString& path, QString& error);
+}
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+#define PERF_SCOPE(name) PerfTrace::Scope PERF_CONCAT(perfScope, __LINE__)(name)
+#define PERF_SCOPE_TAGGED(var, name, tag) PerfTrace::Scope var(name, tag)
+#define PERF_BYTES(var, bytes) var.addBytes(bytes)
+
+#else
+
+#define PERF_SCOPE(name)
+#define PERF_SCOPE_TAGGED(var, name, tag)
+#define PERF_BYTES(var, bytes)
+
+#endif
+
+#endif // PERFTRACE_H
@@ -0,0 +1,168 @@
+#include "resampler.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+    // Kaiser window shape, ~85 dB stopband
+    constexpr double KAISER_BETA = 8.6;
+    // Passband edge relative to the lower Nyquist
+    constexpr double ROLLOFF = 0.95;
+
+    // Zeroth order modified Bessel function of the first kind
+    double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        double half = x / 2.0;
+        for (int k = 1; k < 50; k++) {
+            term *= (half / k) * (half / k);
+            sum += term;
+            if (term < sum * 1e-12) break;
+        }
+        return sum;
+    }
+}
+
+Resampler::Resampler(int inRate, int outRate, int halfTaps) :
+    mL(1),
+    mM(1),
+    mTaps(0),
+    mPhases(0),
+    mHistoryBase(0),
+    mInputCount(0),
+    mOutputIndex(0)
+{
+    if (inRate <= 0 || outRate <= 0 || inRate == outRate) {
+        return;
+    }
+
+    int g = std::gcd(inRate, outRate);
+    mL = outRate / g;
+    mM = inRate / g;
+
+    buildTable(halfTaps);
+
+    // Center output sample 0 on input sample 0
+    int half = mTaps / 2;
+    mHistory.fill(0.0f, half);
+    mHistoryBase = -half;
+}
+
+void Resampler::buildTable(int halfTaps)
+{
+    // Lowpass at the lower of the two Nyquist frequencies, measured in input samples
+    double cutoff = ROLLOFF * qMin(1.0, (double)mL / mM);
+    // Widen the kernel when downsampling so it keeps the same number of zero crossings
+    int half = (int)ceil(halfTaps / cutoff);
+    mTaps = half * 2;
+    mPhases = (int)qMin<qint64>(mL, MaxPhases);
+
+    double i0Beta = besselI0(KAISER_BETA);
+    mTable.resize((mPhases + 1) * mTaps);
+    for (int p = 0; p <= mPhases; p++) {
+        double frac = (double)p / mPhases;
+        float* row = mTable.data() + p * mTaps;
+        for (int t = 0; t < mTaps; t++) {
+            // Distance between the output instant and input tap t
+            double d = frac + half - 1 - t;
+            double x = cutoff * d;
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double r = d / half;
+            double window = fabs(r) >= 1.0 ? 0.0 : besselI0(KAISER_BETA * sqrt(1.0 - r * r)) / i0Beta;
+            row[t] = (float)(cutoff * sinc * window);
+        }
+    }
+}
+
+void Resampler::process(const float* in, qint64 count, QVector<float>& out)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    if (isPassthrough()) {
+        qsizetype size = out.size();
+        out.resize(size + count);
+        memcpy(out.data() + size, in, count * sizeof(float));
+        return;
+    }
+
+    qsizetype size = mHistory.size();
+    mHistory.resize(size + count);
+    memcpy(mHistory.data() + size, in, count * sizeof(float));
+    mInputCount += count;
+
+    produce(out, std::numeric_limits<qint64>::max());
+}
+
+void Resampler::flush(QVector<float>& out)
+{
+    if (isPassthrough()) {
+        return;
+    }
+
+    // Pad with enough zeros to evaluate the last outputs, then stop at the input length
+    int half = mTaps / 2;
+    mHistory.resize(mHistory.size() + half + 1);
+    memset(mHistory.data() + mHistory.size() - half - 1, 0, (half + 1) * sizeof(float));
+
+    produce(out, mInputCount);
+}
+
+void Resampler::produce(QVector<float>& out, qint64 limit)
+{
+    const int half = mTaps / 2;
+    const qint64 available = mHistoryBase + mHistory.size();
+    const bool exactPhases = mPhases == mL;
+
+    out.reserve(out.size() + (qsizetype)((available - mHistoryBase) * mL / mM) + 1);
+
+    forever {
+        qint64 pos = mOutputIndex * mM;
+        qint64 ipos = pos / mL;
+        if (ipos >= limit || ipos + half >= available) {
+            break;
+        }
+        qint64 frac = pos % mL;
+
+        const float* x = mHistory.constData() + (ipos - half + 1 - mHistoryBase);
+        float value;
+        if (exactPhases) {
+            const float* c = mTable.constData() + frac * mTaps;
+            float sum = 0.0f;
+            for (int t = 0; t < mTaps; t++) {
+                sum += x[t] * c[t];
+            }
+            value = sum;
+        } else {
+            // Blend the two nearest tabulated phases
+            double phase = (double)frac * mPhases / mL;
+            int row = (int)phase;
+            float w = (float)(phase - row);
+            const float* c0 = mTable.constData() + row * mTaps;
+            const float* c1 = c0 + mTaps;
+            float s0 = 0.0f, s1 = 0.0f;
+            for (int t = 0; t < mTaps; t++) {
+                s0 += x[t] * c0[t];
+                s1 += x[t] * c1[t];
+            }
+            value = s0 + w * (s1 - s0);
+        }
+        out.append(value);
+        mOutputIndex++;
+    }
+
+    // Drop input no longer reachable by any future output
+    qint64 keepFrom = (mOutputIndex * mM) / mL - half + 1;
+    qint64 drop = qBound<qint64>(0, keepFrom - mHistoryBase, mHistory.size());
+    if (drop > 0) {
+        mHistory.remove(0, drop);
+        mHistoryBase += drop;
+    }
+}
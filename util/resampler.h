@@ -0,0 +1,45 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QVector>
+#include <cstdint>
+
+// Streaming polyphase sample rate converter.
+// Kaiser windowed sinc, rational ratio L/M reduced by gcd. When L is
+// larger than MaxPhases the filter phases are linearly interpolated.
+// Output sample 0 is aligned with input sample 0 and the output length
+// is ceil(inputLength * outRate / inRate) once flush() was called.
+class Resampler
+{
+public:
+    Resampler(int inRate, int outRate, int halfTaps = 32);
+
+    // No conversion needed, process() just copies
+    bool isPassthrough() const { return mL == mM; }
+
+    // Push count input samples, converted samples are appended to out
+    void process(const float* in, qint64 count, QVector<float>& out);
+
+    // Push the trailing zeros and emit the remaining output
+    void flush(QVector<float>& out);
+
+    static constexpr int MaxPhases = 512;
+
+private:
+    void buildTable(int halfTaps);
+    void produce(QVector<float>& out, qint64 limit);
+
+private:
+    qint64 mL;              // Upsampling factor
+    qint64 mM;              // Downsampling factor
+    int mTaps;              // Taps per phase
+    int mPhases;            // Rows in mTable (minus the guard row)
+    QVector<float> mTable;  // (mPhases + 1) * mTaps coefficients
+
+    QVector<float> mHistory;// Pending input, mHistory[0] is input sample mHistoryBase
+    qint64 mHistoryBase;
+    qint64 mInputCount;     // Real input samples received
+    qint64 mOutputIndex;    // Next output sample
+};
+
+#endif // RESAMPLER_H
@@ -0,0 +1,426 @@
+#include "smsframeview.h"
+#include "smsgenerator.h"
+#include "chunk/basechunk.h"
+#include "chunk/item_audioframerefs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // FRM2 header: magic, chunk size, version, time position, flags
+    constexpr qint64 FRAME_HEADER_SIZE = 4 + 4 + 4 + 8 + 8;
+
+    // Element count of a growl array bit
+    int growlArrayLength(int bit)
+    {
+        switch (bit) {
+        case 10: case 11: return 40;
+        case 12: case 13: return 20;
+        default: return 1;
+        }
+    }
+}
+
+SmsFrameView::SmsFrameView() :
+    mData(nullptr),
+    mSize(0)
+{
+}
+
+SmsFrameView::SmsFrameView(const char* data, qint64 size) :
+    mData(nullptr),
+    mSize(0)
+{
+    if (data && size >= FRAME_HEADER_SIZE && !strncmp(data, "FRM2", 4)) {
+        // Trust the chunk's own size when it is smaller than the span handed in
+        qint64 chunkSize = qFromLittleEndian<quint32>(data + 4);
+        mData = data;
+        mSize = qBound(FRAME_HEADER_SIZE, chunkSize, size);
+    }
+}
+
+uint32_t SmsFrameView::version() const
+{
+    return mData ? qFromLittleEndian<quint32>(mData + 8) : 0;
+}
+
+double SmsFrameView::timePosition() const
+{
+    return mData ? qFromLittleEndian<double>(mData + 12) : 0.0;
+}
+
+uint64_t SmsFrameView::flags() const
+{
+    return mData ? qFromLittleEndian<quint64>(mData + 20) : 0;
+}
+
+void SmsFrameView::ensureLayout() const
+{
+    if (mLayout.resolved || !mData) {
+        return;
+    }
+    mLayout.resolved = true;
+
+    const uint64_t f = flags();
+    const uint32_t lo = (uint32_t)f;
+    const uint32_t hi = (uint32_t)(f >> 32);
+    qint64 pos = FRAME_HEADER_SIZE;
+
+    // Advance over n bytes, false if that runs past the chunk
+    auto take = [&](qint64 n) {
+        if (n < 0 || pos + n > mSize) return false;
+        pos += n;
+        return true;
+    };
+    auto readU32 = [&](uint32_t& v) {
+        if (pos + 4 > mSize) return false;
+        v = qFromLittleEndian<quint32>(mData + pos);
+        pos += 4;
+        return true;
+    };
+    // Nested CChunk, its size field covers the 8 byte header
+    auto takeChunk = [&](qint64& at) {
+        qint64 start = pos;
+        if (pos + 8 > mSize) return false;
+        qint64 size = qFromLittleEndian<quint32>(mData + pos + 4);
+        if (size < 8 || !take(size)) return false;
+        at = start;
+        return true;
+    };
+
+    if (lo & FRAME_FLAG_COMPRESSED) {
+        // Compressed harmonic/noise layout is not documented
+        return;
+    }
+
+    if (lo & (FRAME_FLAG_AMPLITUDE | FRAME_FLAG_FREQUENCY | FRAME_FLAG_PHASE)) {
+        uint32_t count;
+        if (!readU32(count)) return;
+        mLayout.harmonicCount = count;
+        if (lo & FRAME_FLAG_FREQUENCY) { mLayout.freq = pos;  if (!take(count * 4ll)) return; }
+        if (lo & FRAME_FLAG_AMPLITUDE) { mLayout.amp = pos;   if (!take(count * 4ll)) return; }
+        if (lo & FRAME_FLAG_PHASE)     { mLayout.phase = pos; if (!take(count * 4ll)) return; }
+    }
+
+    if (lo & (FRAME_FLAG_NOISE_AMP | FRAME_FLAG_NOISE_PHASE)) {
+        uint32_t count;
+        if (!readU32(count)) return;
+        mLayout.noiseCount = count;
+        if (lo & FRAME_FLAG_NOISE_AMP)   { mLayout.noiseAmp = pos;   if (!take(count * 4ll)) return; }
+        if (lo & FRAME_FLAG_NOISE_PHASE) { mLayout.noisePhase = pos; if (!take(count * 4ll)) return; }
+    }
+
+    if (lo & 0x40) {
+        // Transients
+        uint32_t count;
+        if (!readU32(count) || !take(count * 2ll)) return;
+    }
+
+    if (lo & FRAME_FLAG_F0) { mLayout.f0 = pos; if (!take(4)) return; }
+    if (lo & 0x100000) { if (!take(4)) return; }
+    if (lo & 0x400) { if (!take(4)) return; }
+    if (lo & 0x800) { if (!take(4)) return; }
+    if (lo & 0x1000) { if (!take(4)) return; }
+
+    if (lo & FRAME_FLAG_GROWL_PARAMS) {
+        uint32_t subFlags;
+        mLayout.growl = pos;
+        if (!readU32(subFlags)) { mLayout.growl = -1; return; }
+        qint64 blockSize = 0;
+        for (int bit = 0; bit < 20; bit++) {
+            if (subFlags & (1u << bit)) blockSize += growlArrayLength(bit) * 4;
+        }
+        // Growl block is followed by a marker byte
+        if (!take(blockSize + 1)) return;
+    }
+
+    if (hi & 0x08) { if (!take(0x34)) return; }
+    if (hi & 0x20) { qint64 at; if (!takeChunk(at)) return; }
+    if (lo & 0x8000000) { if (!take(0x174 + 0x4C + 0x4C)) return; }
+    if (lo & 0x4000) { if (!take(0x23)) return; }
+
+    // Layouts of these are unknown
+    if (hi & (0x01 | 0x02 | 0x04)) return;
+
+    if (lo & 0x10000) {
+        uint32_t count;
+        if (!readU32(count) || !take(count * 4ll)) return;
+    }
+    if (lo & FRAME_FLAG_EXTRA_BYTE)  { mLayout.extraByte = pos;  if (!take(1)) return; }
+    if (lo & FRAME_FLAG_EXTRA_FLOAT) { mLayout.extraFloat = pos; if (!take(4)) return; }
+
+    // Frequency envelope sets are unknown
+    if (lo & (0x200000 | 0x400000)) return;
+
+    if (lo & FRAME_FLAG_ENVELOPE)  { if (!takeChunk(mLayout.env[Env1])) return; }
+    if (lo & FRAME_FLAG_ENVELOPE2) { if (!takeChunk(mLayout.env[Env2])) return; }
+    if (lo & FRAME_FLAG_ENVELOPE3) { if (!takeChunk(mLayout.env[Env3])) return; }
+    // 0x800000 is listed as a complex frequency envelope set, its layout is unknown
+    if (lo & 0x800000) return;
+
+    mLayout.complete = true;
+}
+
+bool SmsFrameView::isFullyDecoded() const
+{
+    ensureLayout();
+    return mLayout.complete;
+}
+
+int SmsFrameView::harmonicCount() const
+{
+    ensureLayout();
+    return mLayout.harmonicCount;
+}
+
+SmsSpan<float> SmsFrameView::frequencies() const
+{
+    ensureLayout();
+    return mLayout.freq < 0 ? SmsSpan<float>() : SmsSpan<float>(mData + mLayout.freq, mLayout.harmonicCount);
+}
+
+SmsSpan<float> SmsFrameView::amplitudes() const
+{
+    ensureLayout();
+    return mLayout.amp < 0 ? SmsSpan<float>() : SmsSpan<float>(mData + mLayout.amp, mLayout.harmonicCount);
+}
+
+SmsSpan<float> SmsFrameView::phases() const
+{
+    ensureLayout();
+    return mLayout.phase < 0 ? SmsSpan<float>() : SmsSpan<float>(mData + mLayout.phase, mLayout.harmonicCount);
+}
+
+int SmsFrameView::noiseCount() const
+{
+    ensureLayout();
+    return mLayout.noiseCount;
+}
+
+SmsSpan<float> SmsFrameView::noiseAmplitudes() const
+{
+    ensureLayout();
+    return mLayout.noiseAmp < 0 ? SmsSpan<float>() : SmsSpan<float>(mData + mLayout.noiseAmp, mLayout.noiseCount);
+}
+
+SmsSpan<float> SmsFrameView::noisePhases() const
+{
+    ensureLayout();
+    return mLayout.noisePhase < 0 ? SmsSpan<float>() : SmsSpan<float>(mData + mLayout.noisePhase, mLayout.noiseCount);
+}
+
+bool SmsFrameView::hasF0() const
+{
+    ensureLayout();
+    return mLayout.f0 >= 0;
+}
+
+float SmsFrameView::f0() const
+{
+    return hasF0() ? qFromLittleEndian<float>(mData + mLayout.f0) : 0.0f;
+}
+
+float SmsFrameView::f0Hz() const
+{
+    float value = f0();
+    if (flags() & FRAME_FLAG_F0_CENTS) {
+        // Inverse of cents = 1200 * log2(f0 / 440)
+        return 440.0f * powf(2.0f, value / 1200.0f);
+    }
+    return value;
+}
+
+bool SmsFrameView::hasGrowl() const
+{
+    ensureLayout();
+    return mLayout.growl >= 0;
+}
+
+uint32_t SmsFrameView::growlSubFlags() const
+{
+    return hasGrowl() ? qFromLittleEndian<quint32>(mData + mLayout.growl) : 0;
+}
+
+qint64 SmsFrameView::growlOffset(int bit) const
+{
+    uint32_t subFlags = growlSubFlags();
+    if (bit < 0 || bit >= 20 || !(subFlags & (1u << bit))) {
+        return -1;
+    }
+    qint64 pos = mLayout.growl + 4;
+    for (int b = 0; b < bit; b++) {
+        if (subFlags & (1u << b)) pos += growlArrayLength(b) * 4;
+    }
+    return pos + growlArrayLength(bit) * 4 <= mSize ? pos : -1;
+}
+
+float SmsFrameView::growlParam(int bit) const
+{
+    qint64 pos = growlArrayLength(bit) == 1 ? growlOffset(bit) : -1;
+    return pos < 0 ? 0.0f : qFromLittleEndian<float>(mData + pos);
+}
+
+SmsSpan<float> SmsFrameView::growlArray(int bit) const
+{
+    qint64 pos = growlArrayLength(bit) > 1 ? growlOffset(bit) : -1;
+    return pos < 0 ? SmsSpan<float>() : SmsSpan<float>(mData + pos, growlArrayLength(bit));
+}
+
+bool SmsFrameView::hasExtraByte() const
+{
+    ensureLayout();
+    return mLayout.extraByte >= 0;
+}
+
+uint8_t SmsFrameView::extraByte() const
+{
+    return hasExtraByte() ? (uint8_t)mData[mLayout.extraByte] : 0;
+}
+
+bool SmsFrameView::hasExtraFloat() const
+{
+    ensureLayout();
+    return mLayout.extraFloat >= 0;
+}
+
+float SmsFrameView::extraFloat() const
+{
+    return hasExtraFloat() ? qFromLittleEndian<float>(mData + mLayout.extraFloat) : 0.0f;
+}
+
+SmsEnvelopeView SmsFrameView::envelope(Envelope which) const
+{
+    SmsEnvelopeView env;
+    ensureLayout();
+    if (which < 0 || which >= EnvCount || mLayout.env[which] < 0) {
+        return env;
+    }
+
+    // [ENV ][size][env_flags][data_length][min][max][default][data...]
+    const char* p = mData + mLayout.env[which];
+    qint64 chunkSize = qFromLittleEndian<quint32>(p + 4);
+    if (strncmp(p, "ENV ", 4) != 0 || chunkSize < 28) {
+        return env;
+    }
+    uint32_t dataLength = qFromLittleEndian<quint32>(p + 12);
+    dataLength = qMin<qint64>(dataLength, chunkSize - 28);
+
+    env.valid = true;
+    env.flags = qFromLittleEndian<quint32>(p + 8);
+    env.rangeMin = qFromLittleEndian<float>(p + 16);
+    env.rangeMax = qFromLittleEndian<float>(p + 20);
+    env.defaultValue = qFromLittleEndian<float>(p + 24);
+    env.data = SmsSpan<float>(p + 28, dataLength / 4);
+    return env;
+}
+
+SmsFrameSet::SmsFrameSet() :
+    mFile(nullptr)
+{
+}
+
+SmsFrameSet::~SmsFrameSet()
+{
+    clear();
+}
+
+void SmsFrameSet::clear()
+{
+    mFrames.clear();
+    if (mFile) {
+        for (uchar* map : mMaps) {
+            mFile->unmap(map);
+        }
+    }
+    mFile = nullptr;
+    mMaps.clear();
+}
+
+QVector<quint64> SmsFrameSet::FrameOffsets(BaseChunk* part)
+{
+    QVector<quint64> offsets;
+    if (!part) {
+        return offsets;
+    }
+
+    if (auto frames = dynamic_cast<ItemAudioFrameRefs*>(part->GetChildByName("<Frames>"))) {
+        offsets = frames->Offsets();
+    } else {
+        // VQMp keeps its frame offsets as one packed array
+        QByteArray refs = part->GetProperty("FrameRefs").data;
+        for (int i = 0; i + 8 <= refs.size(); i += 8) {
+            offsets.append(qFromLittleEndian<quint64>(refs.constData() + i));
+        }
+    }
+    return offsets;
+}
+
+bool SmsFrameSet::load(QFile& ddb, BaseChunk* part)
+{
+    return load(ddb, FrameOffsets(part));
+}
+
+bool SmsFrameSet::load(QFile& ddb, const QVector<quint64>& offsets)
+{
+    clear();
+    if (offsets.isEmpty()) {
+        return true;
+    }
+
+    // Byte range of every frame, from its own CChunk header
+    struct Range {
+        quint64 offset;
+        quint64 end;
+        int index;
+    };
+    QVector<Range> ranges;
+    ranges.reserve(offsets.size());
+    for (int i = 0; i < offsets.size(); i++) {
+        char header[8];
+        quint64 offset = offsets[i];
+        if (!ddb.seek(offset) || ddb.read(header, 8) != 8 || strncmp(header, "FRM2", 4) != 0
+                || qFromLittleEndian<quint32>(header + 4) < 8) {
+            mError = QString("No FRM2 chunk at 0x%1").arg(offset, 0, 16);
+            return false;
+        }
+        quint64 end = qMin<quint64>(offset + qFromLittleEndian<quint32>(header + 4), ddb.size());
+        ranges.append(Range { offset, end, i });
+    }
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+        return a.offset < b.offset;
+    });
+
+    // Frames of one part are usually stored next to each other, map each
+    // contiguous run once rather than the whole span between scattered frames
+    mFile = &ddb;
+    mFrames.resize(offsets.size());
+    for (int i = 0; i < ranges.size();) {
+        quint64 first = ranges[i].offset, end = ranges[i].end;
+        int next = i + 1;
+        while (next < ranges.size() && ranges[next].offset <= end) {
+            end = qMax(end, ranges[next].end);
+            next++;
+        }
+
+        uchar* map = ddb.map(first, end - first);
+        if (!map) {
+            mError = "Cannot map DDB: " + ddb.errorString();
+            clear();
+            return false;
+        }
+        mMaps.append(map);
+
+        for (; i < next; i++) {
+            const Range& range = ranges[i];
+            SmsFrameView view((const char*)map + (range.offset - first), range.end - range.offset);
+            if (!view.isValid()) {
+                mError = QString("No FRM2 chunk at 0x%1").arg(range.offset, 0, 16);
+                clear();
+                return false;
+            }
+            mFrames[range.index] = view;
+        }
+    }
+    return true;
+}
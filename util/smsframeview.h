@@ -0,0 +1,152 @@
+#ifndef SMSFRAMEVIEW_H
+#define SMSFRAMEVIEW_H
+
+#include <QtEndian>
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+#include <QFile>
+#include <cstdint>
+
+class BaseChunk;
+
+// Read-only array of little endian values at an arbitrary (unaligned) address.
+// Values are converted on access, nothing is copied.
+template <typename T> class SmsSpan
+{
+public:
+    SmsSpan() : mData(nullptr), mCount(0) {}
+    SmsSpan(const char* data, int count) : mData(data), mCount(count) {}
+
+    int size() const { return mCount; }
+    bool isEmpty() const { return mCount == 0; }
+    T operator[](int i) const { return qFromLittleEndian<T>(mData + i * sizeof(T)); }
+    const char* rawData() const { return mData; }
+
+    QVector<T> toVector() const {
+        QVector<T> result(mCount);
+        for (int i = 0; i < mCount; i++) result[i] = (*this)[i];
+        return result;
+    }
+
+private:
+    const char* mData;
+    int mCount;
+};
+
+// ENV CChunk nested in a frame (see docs/SMS_FORMAT.md section 8)
+struct SmsEnvelopeView {
+    bool valid = false;
+    uint32_t flags = 0;
+    float rangeMin = 0, rangeMax = 0, defaultValue = 0;
+    SmsSpan<float> data;    // Control points as (position, value) float pairs
+
+    int pointCount() const { return data.size() / 2; }
+    float position(int i) const { return data[i * 2]; }
+    float value(int i) const { return data[i * 2 + 1]; }
+};
+
+// Zero copy decoder of one FRM2 chunk.
+// The view only keeps a pointer to the chunk bytes (including the 8 byte
+// CChunk header), which must outlive it. Field offsets are resolved on the
+// first access past the header by walking the flags in the order
+// CSMSFrame::Read uses; the walk stops at the first field whose size is not
+// known, later fields then report as absent.
+class SmsFrameView
+{
+public:
+    enum Envelope { Env1 = 0, Env2, Env3, EnvCount };
+
+    SmsFrameView();
+    SmsFrameView(const char* data, qint64 size);
+
+    bool isValid() const { return mData != nullptr; }
+    qint64 size() const { return mSize; }
+
+    uint32_t version() const;
+    double timePosition() const;
+    uint64_t flags() const;
+
+    // Harmonic arrays, empty when the matching flag is not set
+    int harmonicCount() const;
+    SmsSpan<float> frequencies() const;
+    SmsSpan<float> amplitudes() const;
+    SmsSpan<float> phases() const;
+
+    int noiseCount() const;
+    SmsSpan<float> noiseAmplitudes() const;
+    SmsSpan<float> noisePhases() const;
+
+    bool hasF0() const;
+    float f0() const;           // As stored, cents if FRAME_FLAG_F0_CENTS is set
+    float f0Hz() const;
+
+    // Growl parameter block (flag 0x2000)
+    bool hasGrowl() const;
+    uint32_t growlSubFlags() const;
+    float growlParam(int bit) const;        // Scalar bits 0..9 and 14..19
+    SmsSpan<float> growlArray(int bit) const; // Array bits 10..13
+
+    bool hasExtraByte() const;
+    uint8_t extraByte() const;
+    bool hasExtraFloat() const;
+    float extraFloat() const;
+
+    SmsEnvelopeView envelope(Envelope which) const;
+
+    // False when the walk stopped at an undocumented field
+    bool isFullyDecoded() const;
+
+private:
+    void ensureLayout() const;
+    qint64 growlOffset(int bit) const;
+
+private:
+    const char* mData;
+    qint64 mSize;
+
+    // Resolved lazily, -1 when the field is absent or past an unknown field
+    struct Layout {
+        bool resolved = false;
+        bool complete = false;
+        int harmonicCount = 0;
+        qint64 freq = -1, amp = -1, phase = -1;
+        int noiseCount = 0;
+        qint64 noiseAmp = -1, noisePhase = -1;
+        qint64 f0 = -1;
+        qint64 growl = -1;
+        qint64 extraByte = -1, extraFloat = -1;
+        qint64 env[EnvCount] = { -1, -1, -1 };
+    };
+    mutable Layout mLayout;
+};
+
+// All frames of one phonetic unit part, decoded from one mapping per
+// contiguous run of frames in the DDB.
+class SmsFrameSet
+{
+public:
+    SmsFrameSet();
+    ~SmsFrameSet();
+
+    // Frame offsets of a STAp/ARTp (the <Frames> child) or VQMp (FrameRefs)
+    static QVector<quint64> FrameOffsets(BaseChunk* part);
+
+    bool load(QFile& ddb, BaseChunk* part);
+    bool load(QFile& ddb, const QVector<quint64>& offsets);
+    void clear();
+
+    int count() const { return mFrames.size(); }
+    const SmsFrameView& at(int i) const { return mFrames[i]; }
+    const QVector<SmsFrameView>& frames() const { return mFrames; }
+
+    QString getError() const { return mError; }
+
+private:
+    QFile* mFile;
+    QVector<uchar*> mMaps;     // One per contiguous run of frames
+    QVector<SmsFrameView> mFrames;
+    QString mError;
+};
+
+#endif // SMSFRAMEVIEW_H
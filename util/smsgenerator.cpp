@@ -1,4 +1,6 @@
 #include "smsgenerator.h"
+#include "wavreader.h"
+#include "resampler.h"
 
 #include <QFile>
 #include <QDataStream>
@@ -6,6 +8,7 @@
 #include <QDir>
 #include <QPair>
 #include <QTextStream>
+#include <QSet>
 #include <cmath>
 
 #ifndef M_PI
@@ -19,17 +22,26 @@ SmsGenerator::SmsGenerator()
 bool SmsGenerator::analyzeWav(const QString& wavPath, int frameRate, int maxHarmonics,
                                double beginTime, double endTime)
 {
-    QVector<float> samples;
-    int sampleRate;
-
-    if (!readWav(wavPath, samples, sampleRate, beginTime, endTime)) {
+    WavReader reader;
+    if (!reader.open(wavPath)) {
+        mError = reader.getError();
         return false;
     }
 
-    if (samples.isEmpty()) {
+    // Calculate sample range in source frames
+    qint64 totalSamples = reader.frameCount();
+    qint64 startSample = (qint64)(beginTime * reader.sampleRate());
+    qint64 endSample = (endTime < 0) ? totalSamples : (qint64)(endTime * reader.sampleRate());
+
+    if (startSample >= totalSamples) startSample = 0;
+    if (endSample > totalSamples) endSample = totalSamples;
+    if (endSample <= startSample) endSample = totalSamples;
+
+    if (endSample - startSample <= 0) {
         mError = "No samples to analyze";
         return false;
     }
+    reader.seekFrame(startSample);
 
     // Calculate frame parameters
     // CRITICAL: The DSE4 engine hardcodes frame access at 256 samples per frame.
@@ -37,164 +49,82 @@ bool SmsGenerator::analyzeWav(const QString& wavPath, int frameRate, int maxHarm
     // and directly indexes the SMS frame array. The SMS MUST have one frame
     // per 256 audio samples, regardless of the user-requested frame rate.
     // The user's frameRate is ignored; we always use sampleRate/256.
-    int samplesPerFrame = 256;
-    int windowSize = samplesPerFrame * 2; // Overlap
-    int totalFrames = samples.size() / samplesPerFrame;
-
-    if (totalFrames <= 0) {
-        mError = "Audio too short for analysis";
-        return false;
-    }
+    // Other input rates are converted to 44100 on the fly so this holds.
+    const int sampleRate = SMS_SAMPLE_RATE;
+    const int samplesPerFrame = SMS_SAMPLES_PER_FRAME;
+    const int windowSize = samplesPerFrame * 2; // Overlap
 
-    double duration = (double)samples.size() / sampleRate;
+    Resampler resampler(reader.sampleRate(), sampleRate);
 
     // Initialize track
     mTrack.trackIndex = 0;
     mTrack.sampleRate = sampleRate;
-    mTrack.duration = duration;
     mTrack.frameRate = sampleRate / samplesPerFrame;
     mTrack.precision = 11;
     mTrack.regions.clear();
 
     // Create single region
     SMSRegion region;
-    region.duration = duration;
     region.regionType = 0;
 
-    // Analyze each frame
-    for (int i = 0; i < totalFrames; i++) {
-        int startSample = i * samplesPerFrame;
-
-        SMSFrame frame;
-        frame.index = i;
-        // offset 320 in CSMSFrame is the frame's absolute time position, not duration
-        frame.duration = (double)startSample / sampleRate;
-
-        analyzeFrame(samples, startSample, windowSize, sampleRate, maxHarmonics, frame);
-
-        region.frames.append(frame);
-    }
-
-    mTrack.regions.append(region);
-
-    return true;
-}
-
-bool SmsGenerator::readWav(const QString& path, QVector<float>& samples, int& sampleRate,
-                            double beginTime, double endTime)
-{
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) {
-        mError = "Cannot open WAV file";
-        return false;
-    }
-
-    QDataStream stream(&file);
-    stream.setByteOrder(QDataStream::LittleEndian);
-
-    // Read RIFF header
-    char riff[4];
-    file.read(riff, 4);
-    if (strncmp(riff, "RIFF", 4) != 0) {
-        mError = "Invalid WAV: missing RIFF";
-        return false;
-    }
-
-    quint32 fileSize;
-    stream >> fileSize;
-
-    char wave[4];
-    file.read(wave, 4);
-    if (strncmp(wave, "WAVE", 4) != 0) {
-        mError = "Invalid WAV: missing WAVE";
-        return false;
-    }
-
-    // Find chunks
-    int channels = 0;
-    int bitsPerSample = 0;
-    qint64 dataOffset = 0;
-    quint32 dataSize = 0;
-
-    while (!file.atEnd()) {
-        char chunkId[4];
-        quint32 chunkSize;
-        file.read(chunkId, 4);
-        stream >> chunkSize;
+    // Stream the input: decode a block, resample it into the sliding window,
+    // then analyze every frame whose full window is available.
+    // window[0] is analysis sample windowBase.
+    QVector<float> block(WavReader::BlockFrames);
+    QVector<float> window;
+    qint64 windowBase = 0;
+    qint64 remaining = endSample - startSample;
+    bool atEnd = false;
+    int frameIndex = 0;
+
+    while (!atEnd) {
+        qint64 got = reader.readMono(block.data(), qMin<qint64>(remaining, WavReader::BlockFrames));
+        remaining -= got;
+        resampler.process(block.constData(), got, window);
+        if (got == 0 || remaining == 0) {
+            resampler.flush(window);
+            atEnd = true;
+        }
 
-        if (strncmp(chunkId, "fmt ", 4) == 0) {
-            quint16 audioFormat, numChannels;
-            quint32 sr, byteRate;
-            quint16 blockAlign, bits;
+        qint64 windowEnd = windowBase + window.size();
+        forever {
+            qint64 frameStart = (qint64)frameIndex * samplesPerFrame;
+            // Before the end only full windows, afterwards one frame per 256 samples
+            // with the window truncated by analyzeFrame
+            qint64 needed = atEnd ? samplesPerFrame : windowSize;
+            if (frameStart + needed > windowEnd) {
+                break;
+            }
 
-            stream >> audioFormat >> numChannels >> sr >> byteRate >> blockAlign >> bits;
+            SMSFrame frame;
+            frame.index = frameIndex;
+            // offset 320 in CSMSFrame is the frame's absolute time position, not duration
+            frame.duration = (double)frameStart / sampleRate;
 
-            if (audioFormat != 1) {
-                mError = "Only PCM WAV supported";
-                return false;
-            }
+            analyzeFrame(window, frameStart - windowBase, windowSize, sampleRate, maxHarmonics, frame);
 
-            sampleRate = sr;
-            channels = numChannels;
-            bitsPerSample = bits;
+            region.frames.append(frame);
+            frameIndex++;
+        }
 
-            if (chunkSize > 16) {
-                file.seek(file.pos() + chunkSize - 16);
-            }
-        } else if (strncmp(chunkId, "data", 4) == 0) {
-            dataOffset = file.pos();
-            dataSize = chunkSize;
-            break;
-        } else {
-            file.seek(file.pos() + chunkSize);
+        // Discard samples behind the next frame so memory stays bounded
+        qint64 drop = (qint64)frameIndex * samplesPerFrame - windowBase;
+        if (drop > 0 && !atEnd) {
+            window.remove(0, drop);
+            windowBase += drop;
         }
     }
 
-    if (dataSize == 0 || channels == 0) {
-        mError = "Invalid WAV structure";
+    if (region.frames.isEmpty()) {
+        mError = "Audio too short for analysis";
         return false;
     }
 
-    // Calculate sample range
-    int bytesPerSample = bitsPerSample / 8;
-    int frameSize = channels * bytesPerSample;
-    int totalSamples = dataSize / frameSize;
-
-    int startSample = (int)(beginTime * sampleRate);
-    int endSample = (endTime < 0) ? totalSamples : (int)(endTime * sampleRate);
-
-    if (startSample >= totalSamples) startSample = 0;
-    if (endSample > totalSamples) endSample = totalSamples;
-    if (endSample <= startSample) endSample = totalSamples;
+    double duration = (double)(windowBase + window.size()) / sampleRate;
+    mTrack.duration = duration;
+    region.duration = duration;
 
-    int numSamples = endSample - startSample;
-    samples.resize(numSamples);
-
-    // Seek to start position
-    file.seek(dataOffset + startSample * frameSize);
-
-    // Read samples (convert to mono float)
-    for (int i = 0; i < numSamples; i++) {
-        float sum = 0.0f;
-        for (int ch = 0; ch < channels; ch++) {
-            if (bitsPerSample == 16) {
-                qint16 sample;
-                stream >> sample;
-                sum += sample / 32768.0f;
-            } else if (bitsPerSample == 8) {
-                quint8 sample;
-                stream >> sample;
-                sum += (sample - 128) / 128.0f;
-            } else if (bitsPerSample == 24) {
-                quint8 b1, b2, b3;
-                stream >> b1 >> b2 >> b3;
-                qint32 sample = (b3 << 24) | (b2 << 16) | (b1 << 8);
-                sample >>= 8; // Sign extend
-                sum += sample / 8388608.0f;
-            }
-        }
-        samples[i] = sum / channels;
-    }
+    mTrack.regions.append(region);
 
     return true;
 }
@@ -729,6 +659,11 @@ void SmsGenerator::writeSpectralEnvelope(QDataStream& stream,
 
 bool SmsGenerator::writeVqmIni(const QString& iniPath, const QString& sampleName,
                                 double begin, double end, double pitch, const QString& wavFilename)
+{
+    return writeVqmIni(iniPath, QVector<VqmIniEntry> { { sampleName, begin, end, pitch, wavFilename } });
+}
+
+bool SmsGenerator::writeVqmIni(const QString& iniPath, const QVector<VqmIniEntry>& entries)
 {
     QFile file(iniPath);
 
@@ -742,17 +677,26 @@ bool SmsGenerator::writeVqmIni(const QString& iniPath, const QString& sampleName
         }
     }
 
-    // Check if section already exists
-    QString sectionHeader = QString("[%1]").arg(sampleName);
-    if (existingContent.contains(sectionHeader)) {
-        // Remove existing section
+    // Remove sections that are about to be rewritten
+    QSet<QString> sectionHeaders;
+    for (const VqmIniEntry& entry : entries) {
+        sectionHeaders.insert(QString("[%1]").arg(entry.sampleName));
+    }
+    bool hasExisting = false;
+    for (const QString& header : sectionHeaders) {
+        if (existingContent.contains(header)) {
+            hasExisting = true;
+            break;
+        }
+    }
+    if (hasExisting) {
         QStringList lines = existingContent.split('\n');
         QStringList newLines;
         bool inSection = false;
 
         for (const QString& line : lines) {
             if (line.trimmed().startsWith('[')) {
-                inSection = (line.trimmed() == sectionHeader);
+                inSection = sectionHeaders.contains(line.trimmed());
             }
             if (!inSection) {
                 newLines.append(line);
@@ -761,7 +705,7 @@ bool SmsGenerator::writeVqmIni(const QString& iniPath, const QString& sampleName
         existingContent = newLines.join('\n');
     }
 
-    // Append new section
+    // Append new sections
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
         return false;
     }
@@ -774,11 +718,13 @@ bool SmsGenerator::writeVqmIni(const QString& iniPath, const QString& sampleName
         }
     }
 
-    out << QString("[%1]\n").arg(sampleName);
-    out << QString("begin=%1\n").arg(begin, 0, 'f', 6);
-    out << QString("end=%1\n").arg(end, 0, 'f', 6);
-    out << QString("pitch=%1\n").arg(pitch, 0, 'f', 1);
-    out << QString("file=%1\n").arg(wavFilename);
+    for (const VqmIniEntry& entry : entries) {
+        out << QString("[%1]\n").arg(entry.sampleName);
+        out << QString("begin=%1\n").arg(entry.begin, 0, 'f', 6);
+        out << QString("end=%1\n").arg(entry.end, 0, 'f', 6);
+        out << QString("pitch=%1\n").arg(entry.pitch, 0, 'f', 1);
+        out << QString("file=%1\n").arg(entry.wavFilename);
+    }
 
     file.close();
     return true;
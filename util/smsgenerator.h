@@ -41,6 +41,10 @@ constexpr uint64_t FRAME_FLAGS_GROWL = FRAME_FLAG_AMPLITUDE | FRAME_FLAG_FREQUEN
 // Standard harmonic slot count in VOCALOID SMS
 constexpr int SMS_HARMONIC_SLOTS = 350;
 
+// DSE4 indexes SMS frames as time * 44100 / 256, input at other rates is resampled
+constexpr int SMS_SAMPLE_RATE = 44100;
+constexpr int SMS_SAMPLES_PER_FRAME = 256;
+
 // Track flags
 constexpr uint32_t TRACK_FLAG_SAMPLERATE = 0x01;
 constexpr uint32_t TRACK_FLAG_DURATION   = 0x02;
@@ -68,6 +72,15 @@ struct SMSRegion {
     QVector<SMSFrame> frames;
 };
 
+// One [section] of vqm.ini
+struct VqmIniEntry {
+    QString sampleName;
+    double begin;
+    double end;
+    double pitch;
+    QString wavFilename;
+};
+
 struct SMSTrack {
     int trackIndex;
     uint32_t sampleRate;
@@ -93,6 +106,9 @@ public:
     static bool writeVqmIni(const QString& iniPath, const QString& sampleName,
                             double begin, double end, double pitch, const QString& wavFilename);
 
+    // Write several VQM.ini sections with a single rewrite of the file
+    static bool writeVqmIni(const QString& iniPath, const QVector<VqmIniEntry>& entries);
+
     // Copy WAV file to output directory
     static bool copyWav(const QString& srcPath, const QString& dstPath);
 
@@ -103,10 +119,6 @@ public:
     QString getError() const { return mError; }
 
 private:
-    // Read WAV file
-    bool readWav(const QString& path, QVector<float>& samples, int& sampleRate,
-                 double beginTime, double endTime);
-
     // Perform FFT-based harmonic analysis on a frame
     void analyzeFrame(const QVector<float>& samples, int startSample, int windowSize,
                       int sampleRate, int maxHarmonics, SMSFrame& frame);
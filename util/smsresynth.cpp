@@ -0,0 +1,239 @@
+#include "smsresynth.h"
+
+#include <QFile>
+#include <QDataStream>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+    constexpr float TWO_PI = 6.28318531f;
+
+    // Polynomial sine, ~1e-4 absolute error over the phase range of one hop.
+    // Branch free so the compiler can vectorize the oscillator loop.
+    inline float FastSin(float x)
+    {
+        const float pi = 3.14159265f;
+        // Reduce to [-pi, pi]
+        float k = x * (1.0f / TWO_PI);
+        k = (float)(int)(k + (k >= 0.0f ? 0.5f : -0.5f));
+        x -= k * TWO_PI;
+        // Fold to [-pi/2, pi/2]
+        x = std::min(x, pi - x);
+        x = std::max(x, -pi - x);
+        float x2 = x * x;
+        return x * (1.0f + x2 * (-0.16666667f + x2 * (0.0083333310f + x2 * (-0.00019840874f + x2 * 2.7525562e-6f))));
+    }
+
+    inline float WrapPhase(float x)
+    {
+        return x - TWO_PI * floorf((x + (float)M_PI) / TWO_PI);
+    }
+
+    inline float DbToLinear(float db)
+    {
+        // Analysis writes -100 dB for silent slots
+        return db <= -90.0f ? 0.0f : powf(10.0f, db / 20.0f);
+    }
+}
+
+SmsResynth::SmsResynth(int sampleRate) :
+    mSampleRate(sampleRate),
+    mHarmonics(true),
+    mNoise(true),
+    mFft(NoiseFftSize),
+    mRandomState(0x9E3779B9u)
+{
+    // Periodic Hann, sums to one at 50% overlap
+    mWindow.resize(NoiseFftSize);
+    for (int i = 0; i < NoiseFftSize; i++) {
+        mWindow[i] = 0.5f * (1.0f - cosf(TWO_PI * i / NoiseFftSize));
+    }
+}
+
+void SmsResynth::render(const SmsFrameSet& frames, QVector<float>& out)
+{
+    out.clear();
+    const int count = frames.count();
+    if (count == 0) {
+        return;
+    }
+
+    // Noise grains reach half a window before their frame, keep room for that
+    const int lead = NoiseFftSize / 2;
+    QVector<float> buffer(count * HopSize + NoiseFftSize, 0.0f);
+    mPhases.clear();
+
+    for (int i = 0; i < count; i++) {
+        const SmsFrameView& from = frames.at(i);
+        const SmsFrameView& to = frames.at(qMin(i + 1, count - 1));
+        if (mHarmonics) {
+            renderHarmonics(from, to, i == 0, buffer.data() + lead + i * HopSize);
+        }
+        if (mNoise) {
+            renderNoise(from, buffer.data() + i * HopSize);
+        }
+    }
+
+    out = buffer.mid(lead, count * HopSize);
+}
+
+void SmsResynth::renderHarmonics(const SmsFrameView& from, const SmsFrameView& to, bool first, float* out)
+{
+    const SmsSpan<float> freqA = from.frequencies(), ampA = from.amplitudes();
+    const SmsSpan<float> freqB = to.frequencies(), ampB = to.amplitudes();
+    const int count = qMax(qMin(freqA.size(), ampA.size()), qMin(freqB.size(), ampB.size()));
+    const float nyquist = mSampleRate / 2.0f;
+    const float radPerHz = TWO_PI / mSampleRate;
+
+    if (mPhases.size() < count) {
+        mPhases.resize(count);
+    }
+    if (first) {
+        // Start from the analyzed phases when the frame has them
+        const SmsSpan<float> phases = from.phases();
+        for (int h = 0; h < count; h++) {
+            mPhases[h] = h < phases.size() ? phases[h] : 0.0f;
+        }
+    }
+
+    for (int h = 0; h < count; h++) {
+        float fa = h < freqA.size() ? freqA[h] : 0.0f;
+        float fb = h < freqB.size() ? freqB[h] : 0.0f;
+        float aa = h < ampA.size() ? DbToLinear(ampA[h]) : 0.0f;
+        float ab = h < ampB.size() ? DbToLinear(ampB[h]) : 0.0f;
+
+        // Partials that appear or vanish fade at a constant frequency
+        if (fa <= 0.0f && fb <= 0.0f) continue;
+        if (fa <= 0.0f) { fa = fb; aa = 0.0f; }
+        if (fb <= 0.0f) { fb = fa; ab = 0.0f; }
+        if (fa >= nyquist) aa = 0.0f;
+        if (fb >= nyquist) ab = 0.0f;
+
+        const float p0 = mPhases[h];
+        const float w0 = fa * radPerHz;
+        const float dw = (fb - fa) * radPerHz / HopSize;
+        mPhases[h] = WrapPhase(p0 + HopSize * w0 + dw * (HopSize * (HopSize - 1) * 0.5f));
+
+        if (aa == 0.0f && ab == 0.0f) {
+            continue;
+        }
+
+        // Phase of sample n for a linear frequency ramp: p0 + n*w0 + dw*n*(n-1)/2
+        const float da = (ab - aa) / HopSize;
+        for (int n = 0; n < HopSize; n++) {
+            float fn = (float)n;
+            float phase = p0 + fn * w0 + dw * (fn * (fn - 1.0f) * 0.5f);
+            out[n] += (aa + fn * da) * FastSin(phase);
+        }
+    }
+}
+
+void SmsResynth::renderNoise(const SmsFrameView& frame, float* out)
+{
+    const SmsSpan<float> bands = frame.noiseAmplitudes();
+    if (bands.isEmpty()) {
+        return;
+    }
+
+    // Band magnitudes with random phase, bands split the range up to Nyquist evenly
+    const int N = NoiseFftSize;
+    const int bins = N / 2;
+    std::complex<float> spectrum[NoiseFftSize];
+    spectrum[0] = spectrum[bins] = 0.0f;
+    for (int k = 1; k < bins; k++) {
+        int band = qMin(bands.size() - 1, k * bands.size() / bins);
+        float magnitude = DbToLinear(bands[band]) * N / 2;
+        float phase = nextRandom() * TWO_PI;
+        // Conjugated, so the forward transform below acts as the inverse
+        spectrum[k] = std::complex<float>(magnitude * cosf(phase), -magnitude * sinf(phase));
+        spectrum[N - k] = std::conj(spectrum[k]);
+    }
+
+    mFft.forward(spectrum);
+
+    const float scale = 1.0f / N;
+    for (int n = 0; n < N; n++) {
+        out[n] += spectrum[n].real() * scale * mWindow[n];
+    }
+}
+
+float SmsResynth::nextRandom()
+{
+    // xorshift32
+    mRandomState ^= mRandomState << 13;
+    mRandomState ^= mRandomState >> 17;
+    mRandomState ^= mRandomState << 5;
+    return (mRandomState >> 8) * (1.0f / 16777216.0f);
+}
+
+SmsResynthMetrics SmsResynth::compare(const QVector<float>& reference, const QVector<float>& synth)
+{
+    SmsResynthMetrics metrics;
+    const int n = qMin(reference.size(), synth.size());
+    metrics.samples = n;
+    if (n == 0) {
+        return metrics;
+    }
+
+    double refEnergy = 0.0, synthEnergy = 0.0, cross = 0.0, errorEnergy = 0.0;
+    for (int i = 0; i < n; i++) {
+        double r = reference[i], s = synth[i];
+        refEnergy += r * r;
+        synthEnergy += s * s;
+        cross += r * s;
+        errorEnergy += (r - s) * (r - s);
+    }
+
+    auto snr = [](double signal, double noise) {
+        return noise > 0.0 ? 10.0 * log10(signal / noise) : 999.0;
+    };
+
+    metrics.referenceRms = sqrt(refEnergy / n);
+    metrics.errorRms = sqrt(errorEnergy / n);
+    metrics.snrDb = snr(refEnergy, errorEnergy);
+
+    // Residual energy after scaling by g = <r,s>/<s,s>
+    metrics.matchedGain = synthEnergy > 0.0 ? cross / synthEnergy : 0.0;
+    double matchedError = refEnergy - 2.0 * metrics.matchedGain * cross + metrics.matchedGain * metrics.matchedGain * synthEnergy;
+    metrics.matchedSnrDb = snr(refEnergy, qMax(matchedError, 0.0));
+    return metrics;
+}
+
+bool SmsResynth::writeWav(const QString& path, const QVector<float>& samples, int sampleRate)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 dataBytes = samples.size() * 2;
+    stream.writeRawData("RIFF", 4);
+    stream << (quint32)(36 + dataBytes);
+    stream.writeRawData("WAVE", 4);
+    stream.writeRawData("fmt ", 4);
+    stream << (quint32)16;              // fmt chunk size
+    stream << (quint16)1;               // PCM
+    stream << (quint16)1;               // Mono
+    stream << (quint32)sampleRate;
+    stream << (quint32)(sampleRate * 2);// Byte rate
+    stream << (quint16)2;               // Block align
+    stream << (quint16)16;              // Bits per sample
+    stream.writeRawData("data", 4);
+    stream << dataBytes;
+
+    QVector<qint16> pcm(samples.size());
+    for (int i = 0; i < samples.size(); i++) {
+        pcm[i] = qToLittleEndian((qint16)qBound(-32768.0f, samples[i] * 32768.0f, 32767.0f));
+    }
+    stream.writeRawData((const char*)pcm.constData(), pcm.size() * 2);
+
+    return stream.status() == QDataStream::Ok;
+}
@@ -0,0 +1,225 @@
+#include "vqmbatch.h"
+#include "smsgenerator.h"
+#include "perftrace.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+
+bool VqmBatch::readManifest(const QString& path, QVector<VqmBatchEntry>& entries, QString& error)
+{
+    entries.clear();
+    bool ok = path.endsWith(".json", Qt::CaseInsensitive)
+            ? readJsonManifest(path, entries, error)
+            : readCsvManifest(path, entries, error);
+    if (!ok) {
+        return false;
+    }
+
+    if (entries.isEmpty()) {
+        error = "Manifest contains no entries";
+        return false;
+    }
+
+    // Resolve relative WAV paths against the manifest and refuse duplicated names,
+    // as they would overwrite each other's output
+    QDir manifestDir = QFileInfo(path).absoluteDir();
+    QStringList names;
+    for (VqmBatchEntry& entry : entries) {
+        if (QFileInfo(entry.wavPath).isRelative()) {
+            entry.wavPath = manifestDir.absoluteFilePath(entry.wavPath);
+        }
+        if (names.contains(entry.sampleName)) {
+            error = QString("Sample name \"%1\" appears more than once").arg(entry.sampleName);
+            return false;
+        }
+        names << entry.sampleName;
+    }
+
+    return true;
+}
+
+bool VqmBatch::readCsvManifest(const QString& path, QVector<VqmBatchEntry>& entries, QString& error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        error = "Cannot open manifest";
+        return false;
+    }
+
+    QTextStream in(&file);
+    int lineNo = 0;
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        lineNo++;
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        QStringList cols = line.split(',');
+        for (QString& col : cols) {
+            col = col.trimmed();
+        }
+        // Optional header line
+        if (lineNo == 1 && cols[0].compare("wav", Qt::CaseInsensitive) == 0) {
+            continue;
+        }
+        if (cols.size() < 3) {
+            error = QString("Line %1: expected wav,name,pitch[,begin[,end]]").arg(lineNo);
+            return false;
+        }
+
+        VqmBatchEntry entry;
+        bool okPitch, okBegin = true, okEnd = true;
+        entry.wavPath = cols[0];
+        entry.sampleName = cols[1];
+        entry.pitch = cols[2].toDouble(&okPitch);
+        entry.beginTime = (cols.size() > 3 && !cols[3].isEmpty()) ? cols[3].toDouble(&okBegin) : 0.0;
+        entry.endTime = (cols.size() > 4 && !cols[4].isEmpty()) ? cols[4].toDouble(&okEnd) : -1.0;
+        if (!okPitch || !okBegin || !okEnd || entry.wavPath.isEmpty() || entry.sampleName.isEmpty()) {
+            error = QString("Line %1: malformed entry").arg(lineNo);
+            return false;
+        }
+        entries.append(entry);
+    }
+
+    return true;
+}
+
+bool VqmBatch::readJsonManifest(const QString& path, QVector<VqmBatchEntry>& entries, QString& error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = "Cannot open manifest";
+        return false;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (doc.isNull()) {
+        error = "Invalid JSON: " + parseError.errorString();
+        return false;
+    }
+
+    QJsonArray array = doc.isArray() ? doc.array() : doc.object().value("entries").toArray();
+    for (int i = 0; i < array.size(); i++) {
+        QJsonObject obj = array[i].toObject();
+        VqmBatchEntry entry;
+        entry.wavPath = obj.value("wav").toString();
+        entry.sampleName = obj.value("name").toString();
+        entry.pitch = obj.value("pitch").toDouble(60.0);
+        entry.beginTime = obj.value("begin").toDouble(0.0);
+        entry.endTime = obj.value("end").toDouble(-1.0);
+        if (entry.wavPath.isEmpty() || entry.sampleName.isEmpty()) {
+            error = QString("Entry %1: \"wav\" and \"name\" are required").arg(i);
+            return false;
+        }
+        entries.append(entry);
+    }
+
+    return true;
+}
+
+void VqmBatch::process(VqmBatchResult& job, const QString& outputDir, int frameRate, int maxHarmonics)
+{
+    PERF_SCOPE("Generate VQM");
+    QElapsedTimer total, step;
+    total.start();
+
+    const VqmBatchEntry& entry = job.entry;
+    QString vqmDir = outputDir + "/VQM";
+
+    // Step 1: Analyze WAV
+    step.start();
+    SmsGenerator generator;
+    bool ok = generator.analyzeWav(entry.wavPath, frameRate, maxHarmonics, entry.beginTime, entry.endTime);
+    job.analyzeMs = step.elapsed();
+    if (!ok) {
+        job.error = "Analysis failed: " + generator.getError();
+        job.totalMs = total.elapsed();
+        return;
+    }
+
+    const SMSTrack& track = generator.getTrack();
+    for (const SMSRegion& region : track.regions) {
+        job.frameCount += region.frames.size();
+    }
+    // Open ended entries get their real end time written into the INI
+    job.actualEndTime = entry.endTime < 0 ? entry.beginTime + track.duration : entry.endTime;
+
+    // Step 2: Write SMS file
+    step.start();
+    job.smsPath = vqmDir + "/" + entry.sampleName + ".sms";
+    ok = generator.writeSms(job.smsPath);
+    job.writeSmsMs = step.elapsed();
+    if (!ok) {
+        job.error = "SMS write failed: " + generator.getError();
+        job.totalMs = total.elapsed();
+        return;
+    }
+
+    // Step 3: Copy WAV file
+    step.start();
+    job.wavPath = vqmDir + "/" + entry.sampleName + ".wav";
+    ok = SmsGenerator::copyWav(entry.wavPath, job.wavPath);
+    job.copyWavMs = step.elapsed();
+    if (!ok) {
+        job.error = "Failed to copy WAV file";
+        job.totalMs = total.elapsed();
+        return;
+    }
+
+    job.ok = true;
+    job.totalMs = total.elapsed();
+}
+
+bool VqmBatch::writeIni(const QString& iniPath, const QVector<VqmBatchResult>& jobs)
+{
+    QVector<VqmIniEntry> iniEntries;
+    for (const VqmBatchResult& job : jobs) {
+        if (!job.ok) {
+            continue;
+        }
+        iniEntries.append({ job.entry.sampleName, job.entry.beginTime, job.actualEndTime,
+                            job.entry.pitch, job.entry.sampleName + ".wav" });
+    }
+    if (iniEntries.isEmpty()) {
+        return true;
+    }
+    return SmsGenerator::writeVqmIni(iniPath, iniEntries);
+}
+
+bool VqmBatch::writeReport(const QString& reportPath, const QVector<VqmBatchResult>& jobs, qint64 wallMs)
+{
+    QFile file(reportPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    QTextStream out(&file);
+    qint64 sumAnalyze = 0, sumSms = 0, sumWav = 0, sumTotal = 0;
+    out << "name,status,frames,analyze_ms,write_sms_ms,copy_wav_ms,total_ms,error\n";
+    for (const VqmBatchResult& job : jobs) {
+        out << job.entry.sampleName << ','
+            << (job.ok ? "ok" : "failed") << ','
+            << job.frameCount << ','
+            << job.analyzeMs << ','
+            << job.writeSmsMs << ','
+            << job.copyWavMs << ','
+            << job.totalMs << ','
+            << QString(job.error).replace(',', ';') << '\n';
+        sumAnalyze += job.analyzeMs;
+        sumSms += job.writeSmsMs;
+        sumWav += job.copyWavMs;
+        sumTotal += job.totalMs;
+    }
+    out << "<sum>,," << ',' << sumAnalyze << ',' << sumSms << ',' << sumWav << ',' << sumTotal << ",\n";
+    out << "<wall clock>,,,,,," << wallMs << ",\n";
+
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef VQMBATCH_H
+#define VQMBATCH_H
+
+#include <QString>
+#include <QVector>
+
+// One line of a batch manifest
+struct VqmBatchEntry {
+    QString wavPath;
+    QString sampleName;
+    double pitch;
+    double beginTime;
+    double endTime;     // < 0 means "until end of file"
+};
+
+// Result and timing of a single batch entry (milliseconds)
+struct VqmBatchResult {
+    VqmBatchEntry entry;
+    bool ok = false;
+    QString error;
+    QString smsPath, wavPath;
+    double actualEndTime = 0.0;
+    int frameCount = 0;
+    qint64 analyzeMs = 0, writeSmsMs = 0, copyWavMs = 0, totalMs = 0;
+};
+
+class VqmBatch
+{
+public:
+    // Manifest is either CSV (wav,name,pitch,begin,end) or JSON
+    // (an array of {"wav","name","pitch","begin","end"} objects, or {"entries": [...]}).
+    // Relative WAV paths are resolved against the manifest's directory.
+    static bool readManifest(const QString& path, QVector<VqmBatchEntry>& entries, QString& error);
+
+    // Analyze one entry and write its SMS and WAV into outputDir/VQM.
+    // Thread safe, meant to be run from QtConcurrent::map.
+    static void process(VqmBatchResult& job, const QString& outputDir, int frameRate, int maxHarmonics);
+
+    // Merge every successful job into vqm.ini with a single rewrite
+    static bool writeIni(const QString& iniPath, const QVector<VqmBatchResult>& jobs);
+
+    // Per-file timing report as CSV
+    static bool writeReport(const QString& reportPath, const QVector<VqmBatchResult>& jobs, qint64 wallMs);
+
+private:
+    static bool readCsvManifest(const QString& path, QVector<VqmBatchEntry>& entries, QString& error);
+    static bool readJsonManifest(const QString& path, QVector<VqmBatchEntry>& entries, QString& error);
+};
+
+#endif // VQMBATCH_H
@@ -0,0 +1,270 @@
+#include "wavreader.h"
+
+#include <QtEndian>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WAVREADER_SSE2
+#endif
+
+namespace {
+    constexpr quint16 WAVE_FORMAT_PCM        = 0x0001;
+    constexpr quint16 WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+    constexpr quint16 WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+    // 16 bit integer PCM to mono float
+    void decodeS16(const char* src, float* out, qint64 frames, int channels)
+    {
+        const float scale = 1.0f / (32768.0f * channels);
+        qint64 i = 0;
+#ifdef WAVREADER_SSE2
+        if (channels == 1) {
+            const __m128 vscale = _mm_set1_ps(scale);
+            for (; i + 8 <= frames; i += 8) {
+                __m128i x = _mm_loadu_si128((const __m128i*)(src + i * 2));
+                // Sign extend the low and high halves to 32 bit
+                __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+                __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+                _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+                _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+            }
+        } else if (channels == 2) {
+            const __m128 vscale = _mm_set1_ps(scale);
+            const __m128i ones = _mm_set1_epi16(1);
+            for (; i + 4 <= frames; i += 4) {
+                // L0 R0 L1 R1 L2 R2 L3 R3 -> L0+R0 .. L3+R3 as 32 bit
+                __m128i x = _mm_loadu_si128((const __m128i*)(src + i * 4));
+                __m128i sum = _mm_madd_epi16(x, ones);
+                _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(sum), vscale));
+            }
+        }
+#endif
+        for (; i < frames; i++) {
+            int32_t sum = 0;
+            for (int ch = 0; ch < channels; ch++) {
+                sum += qFromLittleEndian<qint16>(src + (i * channels + ch) * 2);
+            }
+            out[i] = sum * scale;
+        }
+    }
+
+    void decodeU8(const uchar* src, float* out, qint64 frames, int channels)
+    {
+        const float scale = 1.0f / (128.0f * channels);
+        for (qint64 i = 0; i < frames; i++) {
+            int32_t sum = 0;
+            for (int ch = 0; ch < channels; ch++) {
+                sum += int32_t(src[i * channels + ch]) - 128;
+            }
+            out[i] = sum * scale;
+        }
+    }
+
+    void decodeS24(const uchar* src, float* out, qint64 frames, int channels)
+    {
+        const float scale = 1.0f / (8388608.0f * channels);
+        for (qint64 i = 0; i < frames; i++) {
+            int32_t sum = 0;
+            for (int ch = 0; ch < channels; ch++) {
+                const uchar* p = src + (i * channels + ch) * 3;
+                // Assemble into the top 24 bits and arithmetic shift to sign extend
+                int32_t sample = int32_t((uint32_t(p[2]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[0]) << 8)) >> 8;
+                sum += sample;
+            }
+            out[i] = sum * scale;
+        }
+    }
+
+    void decodeS32(const char* src, float* out, qint64 frames, int channels)
+    {
+        const double scale = 1.0 / (2147483648.0 * channels);
+        for (qint64 i = 0; i < frames; i++) {
+            int64_t sum = 0;
+            for (int ch = 0; ch < channels; ch++) {
+                sum += qFromLittleEndian<qint32>(src + (i * channels + ch) * 4);
+            }
+            out[i] = float(sum * scale);
+        }
+    }
+
+    template <typename T> void decodeFloat(const char* src, float* out, qint64 frames, int channels)
+    {
+        const float scale = 1.0f / channels;
+        for (qint64 i = 0; i < frames; i++) {
+            T sum = 0;
+            for (int ch = 0; ch < channels; ch++) {
+                sum += qFromLittleEndian<T>(src + (i * channels + ch) * sizeof(T));
+            }
+            out[i] = float(sum) * scale;
+        }
+    }
+}
+
+WavReader::WavReader() :
+    mSampleRate(0),
+    mChannels(0),
+    mBitsPerSample(0),
+    mFrameBytes(0),
+    mIsFloat(false),
+    mDataOffset(0),
+    mFrameCount(0),
+    mPosition(0)
+{
+}
+
+bool WavReader::open(const QString& path)
+{
+    close();
+
+    mFile.setFileName(path);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        mError = "Cannot open WAV file";
+        return false;
+    }
+
+    char header[12];
+    if (mFile.read(header, 12) != 12 || strncmp(header, "RIFF", 4) != 0) {
+        mError = "Invalid WAV: missing RIFF";
+        return false;
+    }
+    if (strncmp(header + 8, "WAVE", 4) != 0) {
+        mError = "Invalid WAV: missing WAVE";
+        return false;
+    }
+
+    quint16 audioFormat = 0;
+    qint64 dataSize = 0;
+    bool foundFmt = false;
+
+    // Walk chunks until the data chunk
+    forever {
+        char chunkHeader[8];
+        if (mFile.read(chunkHeader, 8) != 8) {
+            break;
+        }
+        quint32 chunkSize = qFromLittleEndian<quint32>(chunkHeader + 4);
+
+        if (strncmp(chunkHeader, "fmt ", 4) == 0) {
+            QByteArray fmt = mFile.read(chunkSize);
+            if (fmt.size() < 16) {
+                mError = "Invalid WAV: truncated fmt chunk";
+                return false;
+            }
+            const char* p = fmt.constData();
+            audioFormat    = qFromLittleEndian<quint16>(p);
+            mChannels      = qFromLittleEndian<quint16>(p + 2);
+            mSampleRate    = qFromLittleEndian<quint32>(p + 4);
+            mBitsPerSample = qFromLittleEndian<quint16>(p + 14);
+            // WAVE_FORMAT_EXTENSIBLE: actual format is the first WORD of the sub format GUID
+            if (audioFormat == WAVE_FORMAT_EXTENSIBLE && fmt.size() >= 26) {
+                audioFormat = qFromLittleEndian<quint16>(p + 24);
+            }
+            foundFmt = true;
+        } else if (strncmp(chunkHeader, "data", 4) == 0) {
+            mDataOffset = mFile.pos();
+            dataSize = chunkSize;
+            // Some writers leave 0 or garbage in the size of a streamed data chunk
+            if (dataSize == 0 || mDataOffset + dataSize > mFile.size()) {
+                dataSize = mFile.size() - mDataOffset;
+            }
+            break;
+        } else {
+            mFile.seek(mFile.pos() + chunkSize);
+        }
+        // Chunks are WORD aligned
+        if (chunkSize & 1) {
+            mFile.seek(mFile.pos() + 1);
+        }
+    }
+
+    if (!foundFmt || mDataOffset == 0 || mChannels == 0 || mSampleRate == 0) {
+        mError = "Invalid WAV structure";
+        return false;
+    }
+
+    if (audioFormat == WAVE_FORMAT_PCM) {
+        mIsFloat = false;
+        if (mBitsPerSample != 8 && mBitsPerSample != 16 && mBitsPerSample != 24 && mBitsPerSample != 32) {
+            mError = QString("Unsupported PCM bit depth %1").arg(mBitsPerSample);
+            return false;
+        }
+    } else if (audioFormat == WAVE_FORMAT_IEEE_FLOAT) {
+        mIsFloat = true;
+        if (mBitsPerSample != 32 && mBitsPerSample != 64) {
+            mError = QString("Unsupported float bit depth %1").arg(mBitsPerSample);
+            return false;
+        }
+    } else {
+        mError = QString("Unsupported WAV format 0x%1").arg(audioFormat, 4, 16, QChar('0'));
+        return false;
+    }
+
+    mFrameBytes = mChannels * (mBitsPerSample / 8);
+    mFrameCount = dataSize / mFrameBytes;
+    mPosition = 0;
+    mFile.seek(mDataOffset);
+
+    return true;
+}
+
+void WavReader::close()
+{
+    if (mFile.isOpen()) {
+        mFile.close();
+    }
+    mBlock.clear();
+    mSampleRate = mChannels = mBitsPerSample = mFrameBytes = 0;
+    mIsFloat = false;
+    mDataOffset = mFrameCount = mPosition = 0;
+}
+
+bool WavReader::seekFrame(qint64 frame)
+{
+    if (frame < 0 || frame > mFrameCount) {
+        return false;
+    }
+    if (!mFile.seek(mDataOffset + frame * mFrameBytes)) {
+        return false;
+    }
+    mPosition = frame;
+    return true;
+}
+
+qint64 WavReader::readMono(float* out, qint64 maxFrames)
+{
+    qint64 done = 0;
+    while (done < maxFrames && mPosition < mFrameCount) {
+        qint64 frames = qMin(qMin(maxFrames - done, BlockFrames), mFrameCount - mPosition);
+        mBlock.resize(frames * mFrameBytes);
+        qint64 got = mFile.read(mBlock.data(), frames * mFrameBytes);
+        if (got <= 0) {
+            // Truncated file, treat as end of data
+            mFrameCount = mPosition;
+            break;
+        }
+        frames = got / mFrameBytes;
+        decodeBlock(mBlock.constData(), out + done, frames);
+        done += frames;
+        mPosition += frames;
+    }
+    return done;
+}
+
+void WavReader::decodeBlock(const char* src, float* out, qint64 frames) const
+{
+    if (mIsFloat) {
+        if (mBitsPerSample == 32)
+            decodeFloat<float>(src, out, frames, mChannels);
+        else
+            decodeFloat<double>(src, out, frames, mChannels);
+        return;
+    }
+
+    switch (mBitsPerSample) {
+    case 8:  decodeU8((const uchar*)src, out, frames, mChannels); break;
+    case 16: decodeS16(src, out, frames, mChannels); break;
+    case 24: decodeS24((const uchar*)src, out, frames, mChannels); break;
+    case 32: decodeS32(src, out, frames, mChannels); break;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef WAVREADER_H
+#define WAVREADER_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <cstdint>
+
+// Block based RIFF/WAVE reader.
+// Decodes 8/16/24/32-bit integer and 32/64-bit float PCM (including
+// WAVE_FORMAT_EXTENSIBLE) in large blocks and downmixes to mono float,
+// so callers can stream arbitrarily long recordings with bounded memory.
+class WavReader
+{
+public:
+    WavReader();
+
+    bool open(const QString& path);
+    void close();
+
+    int sampleRate() const { return mSampleRate; }
+    int channels() const { return mChannels; }
+    int bitsPerSample() const { return mBitsPerSample; }
+    bool isFloat() const { return mIsFloat; }
+    qint64 frameCount() const { return mFrameCount; }
+    qint64 position() const { return mPosition; }
+    double duration() const { return mSampleRate ? (double)mFrameCount / mSampleRate : 0.0; }
+
+    // Position the reader at a sample frame
+    bool seekFrame(qint64 frame);
+
+    // Read up to maxFrames frames, downmixed to mono in [-1, 1).
+    // Returns the number of frames written to out, 0 at end of data.
+    qint64 readMono(float* out, qint64 maxFrames);
+
+    QString getError() const { return mError; }
+
+    // Frames decoded per file read
+    static constexpr qint64 BlockFrames = 16384;
+
+private:
+    void decodeBlock(const char* src, float* out, qint64 frames) const;
+
+private:
+    QFile mFile;
+    QByteArray mBlock;
+    QString mError;
+
+    int mSampleRate;
+    int mChannels;
+    int mBitsPerSample;
+    int mFrameBytes;
+    bool mIsFloat;
+
+    qint64 mDataOffset;
+    qint64 mFrameCount;
+    qint64 mPosition;
+};
+
+#endif // WAVREADER_H